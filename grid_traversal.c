@@ -1,16 +1,399 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
 #include <time.h>   // for time() used in srand()
+#include <getopt.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include "grid_traversal.h"
 
-// Struct to represent the grid with blocked/unblocked cells
-typedef struct {
+// Multi-resolution count pyramid over a per-cell bit (blocked, visited, ...).
+// Level 0 stores each 8x8 block as one 64-bit word (bit (r % 8) * 8 + c % 8);
+// level k >= 1 stores how many bits are set in each block of (8 << k) cells per
+// side. A block whose count is 0 or equals its area is uniform and can be skipped
+// or handled in one step by whole-grid operations.
+struct BitPyramid {
     int rows, cols;
-    bool **blocked;  // 2D array: true = blocked, false = free
-} Grid;
+    int levels;
+    int *level_rows, *level_cols;  // blocks per column / row at each level
+    uint64_t *leaf;
+    uint32_t **count;              // count[k] for k >= 1; count[0] is unused
+    long total;                    // set bits in the whole grid
+};
 
-// Create a new grid of size rows x cols, marking blocked cells from the list
-Grid *create_grid(int rows, int cols, int blocked_count, const int blocked_list[][2]) {
+// Uniformity of a pyramid block
+enum { BLOCK_EMPTY, BLOCK_FULL, BLOCK_MIXED };
+
+BitPyramid *create_bit_pyramid(int rows, int cols) {
+    BitPyramid *p = (BitPyramid*)calloc(1, sizeof(BitPyramid));
+    if (!p) {
+        fprintf(stderr, "Memory allocation failed for BitPyramid\n");
+        exit(1);
+    }
+    p->rows = rows;
+    p->cols = cols;
+    int br = (rows + 7) >> 3, bc = (cols + 7) >> 3;
+    p->levels = 1;
+    while ((br >> (p->levels - 1)) > 1 || (bc >> (p->levels - 1)) > 1) p->levels++;
+    p->level_rows = (int*)malloc(p->levels * sizeof(int));
+    p->level_cols = (int*)malloc(p->levels * sizeof(int));
+    p->count = (uint32_t**)calloc(p->levels, sizeof(uint32_t*));
+    p->leaf = (uint64_t*)calloc((size_t)br * bc + 1, sizeof(uint64_t));
+    if (!p->level_rows || !p->level_cols || !p->count || !p->leaf) {
+        fprintf(stderr, "Memory allocation failed for BitPyramid levels\n");
+        exit(1);
+    }
+    for (int k = 0; k < p->levels; k++) {
+        p->level_rows[k] = (br + (1 << k) - 1) >> k;
+        p->level_cols[k] = (bc + (1 << k) - 1) >> k;
+        if (k == 0) continue;
+        p->count[k] = (uint32_t*)calloc((size_t)p->level_rows[k] * p->level_cols[k], sizeof(uint32_t));
+        if (!p->count[k]) {
+            fprintf(stderr, "Memory allocation failed for BitPyramid level %d\n", k);
+            exit(1);
+        }
+    }
+    return p;
+}
+
+void free_bit_pyramid(BitPyramid *p) {
+    if (!p) return;
+    for (int k = 1; k < p->levels; k++) free(p->count[k]);
+    free(p->count);
+    free(p->leaf);
+    free(p->level_rows);
+    free(p->level_cols);
+    free(p);
+}
+
+static inline bool bit_pyramid_get(const BitPyramid *p, int r, int c) {
+    return (p->leaf[(size_t)(r >> 3) * p->level_cols[0] + (c >> 3)] >> (((r & 7) << 3) | (c & 7))) & 1;
+}
+
+// Set or clear the bit of (r, c), updating every level in O(levels)
+void bit_pyramid_set(BitPyramid *p, int r, int c, bool value) {
+    uint64_t *w = &p->leaf[(size_t)(r >> 3) * p->level_cols[0] + (c >> 3)];
+    uint64_t bit = (uint64_t)1 << (((r & 7) << 3) | (c & 7));
+    if (((*w & bit) != 0) == value) return;
+    *w ^= bit;
+    int delta = value ? 1 : -1;
+    p->total += delta;
+    for (int k = 1; k < p->levels; k++) {
+        p->count[k][(size_t)(r >> (3 + k)) * p->level_cols[k] + (c >> (3 + k))] += delta;
+    }
+}
+
+// Number of grid cells covered by block (br, bc) of level k
+static inline long pyramid_block_area(const BitPyramid *p, int k, int br, int bc) {
+    long side = 8L << k;
+    long h = p->rows - br * side, w = p->cols - bc * side;
+    return (h < side ? h : side) * (w < side ? w : side);
+}
+
+// Set bits in block (br, bc) of level k
+static inline long pyramid_block_count(const BitPyramid *p, int k, int br, int bc) {
+    if (k == 0) return __builtin_popcountll(p->leaf[(size_t)br * p->level_cols[0] + bc]);
+    return p->count[k][(size_t)br * p->level_cols[k] + bc];
+}
+
+int pyramid_block_state(const BitPyramid *p, int k, int br, int bc) {
+    long n = pyramid_block_count(p, k, br, bc);
+    if (n == 0) return BLOCK_EMPTY;
+    return n == pyramid_block_area(p, k, br, bc) ? BLOCK_FULL : BLOCK_MIXED;
+}
+
+// Bits of the 8x8 leaf block (br, bc) that lie inside the grid
+static inline uint64_t pyramid_leaf_valid(const BitPyramid *p, int br, int bc) {
+    int h = p->rows - br * 8, w = p->cols - bc * 8;
+    if (h > 8) h = 8;
+    if (w > 8) w = 8;
+    uint64_t row = (w == 8) ? 0xFFu : ((1u << w) - 1);
+    uint64_t m = 0;
+    for (int i = 0; i < h; i++) m |= row << (i * 8);
+    return m;
+}
+
+// Set the bits of the blocked cells of a bool array of p's size in an empty pyramid
+static void fill_blocked_pyramid(BitPyramid *p, bool **blocked) {
+    for (int r = 0; r < p->rows; r++) {
+        for (int c = 0; c < p->cols; c++) {
+            if (blocked[r][c]) bit_pyramid_set(p, r, c, true);
+        }
+    }
+}
+
+// Build a pyramid of the blocked cells of a rows x cols bool array
+static BitPyramid *build_blocked_pyramid(bool **blocked, int rows, int cols) {
+    BitPyramid *p = create_bit_pyramid(rows, cols);
+    fill_blocked_pyramid(p, blocked);
+    return p;
+}
+
+// Clear every bit of p, keeping its storage
+static void clear_bit_pyramid(BitPyramid *p) {
+    memset(p->leaf, 0, (size_t)p->level_rows[0] * p->level_cols[0] * sizeof(uint64_t));
+    for (int k = 1; k < p->levels; k++) {
+        memset(p->count[k], 0, (size_t)p->level_rows[k] * p->level_cols[k] * sizeof(uint32_t));
+    }
+    p->total = 0;
+}
+
+// First cell in row-major order whose bit is clear. Fully set 8x8 blocks are
+// skipped with one compare.
+static bool pyramid_first_clear(const BitPyramid *p, int *out_r, int *out_c) {
+    int bc_count = p->level_cols[0];
+    for (int br = 0; br < p->level_rows[0]; br++) {
+        // Per row of the band, the first clear column found so far
+        int best_row = 8, best_col = 0;
+        for (int bc = 0; bc < bc_count; bc++) {
+            uint64_t clear = ~p->leaf[(size_t)br * bc_count + bc] & pyramid_leaf_valid(p, br, bc);
+            if (!clear) continue;
+            int row = __builtin_ctzll(clear) >> 3;  // lowest row with a clear bit in this block
+            if (row < best_row) {
+                best_row = row;
+                best_col = bc * 8 + __builtin_ctzll((clear >> (row * 8)) & 0xFF);
+            }
+            if (best_row == 0) break;  // cannot do better than the band's first row
+        }
+        if (best_row < 8) {
+            *out_r = br * 8 + best_row;
+            *out_c = best_col;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Recursive helper for pyramid_nearest_open: search block (br, bc) of level k
+static void pyramid_nearest_block(const BitPyramid *blocked, const BitPyramid *visited, int k, int br, int bc,
+                                  int r, int c, long *best, int *out_r, int *out_c) {
+    long side = 8L << k;
+    long r0 = br * side, c0 = bc * side, r1 = r0 + side - 1, c1 = c0 + side - 1;
+    long dist = (r < r0 ? r0 - r : r > r1 ? r - r1 : 0) + (c < c0 ? c0 - c : c > c1 ? c - c1 : 0);
+    if (dist >= *best) return;
+    // Visited cells are free, so the block is exhausted when blocked + visited covers it
+    long used = pyramid_block_count(blocked, k, br, bc) + (visited ? pyramid_block_count(visited, k, br, bc) : 0);
+    if (used == pyramid_block_area(blocked, k, br, bc)) return;
+    if (k == 0) {
+        size_t i = (size_t)br * blocked->level_cols[0] + bc;
+        uint64_t open = ~blocked->leaf[i] & pyramid_leaf_valid(blocked, br, bc);
+        if (visited) open &= ~visited->leaf[i];
+        while (open) {
+            int b = __builtin_ctzll(open);
+            open &= open - 1;
+            int cr = (int)r0 + (b >> 3), cc = (int)c0 + (b & 7);
+            long d = labs((long)cr - r) + labs((long)cc - c);
+            if (d < *best) {
+                *best = d;
+                *out_r = cr;
+                *out_c = cc;
+            }
+        }
+        return;
+    }
+    // Visit the children nearest-first so the bound tightens quickly
+    int child_r[4], child_c[4];
+    long child_d[4];
+    int n = 0;
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            int cbr = br * 2 + i, cbc = bc * 2 + j;
+            if (cbr >= blocked->level_rows[k - 1] || cbc >= blocked->level_cols[k - 1]) continue;
+            long cs = side / 2;
+            long a0 = cbr * cs, b0 = cbc * cs;
+            child_d[n] = (r < a0 ? a0 - r : r > a0 + cs - 1 ? r - a0 - cs + 1 : 0) +
+                         (c < b0 ? b0 - c : c > b0 + cs - 1 ? c - b0 - cs + 1 : 0);
+            child_r[n] = cbr;
+            child_c[n] = cbc;
+            n++;
+        }
+    }
+    for (int i = 1; i < n; i++) {
+        for (int j = i; j > 0 && child_d[j] < child_d[j - 1]; j--) {
+            long td = child_d[j]; child_d[j] = child_d[j - 1]; child_d[j - 1] = td;
+            int tr = child_r[j]; child_r[j] = child_r[j - 1]; child_r[j - 1] = tr;
+            int tc = child_c[j]; child_c[j] = child_c[j - 1]; child_c[j - 1] = tc;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        pyramid_nearest_block(blocked, visited, k - 1, child_r[i], child_c[i], r, c, best, out_r, out_c);
+    }
+}
+
+// Frontier search: the free cell not yet visited that is nearest to (r, c) in
+// Manhattan distance (obstacles are not routed around). visited may be NULL.
+// Exhausted or fully blocked blocks are pruned in one check at every level.
+bool pyramid_nearest_open(const BitPyramid *blocked, const BitPyramid *visited, int r, int c,
+                          int *out_r, int *out_c) {
+    long best = (long)blocked->rows + blocked->cols + 1;
+    int top = blocked->levels - 1;
+    for (int br = 0; br < blocked->level_rows[top]; br++) {
+        for (int bc = 0; bc < blocked->level_cols[top]; bc++) {
+            pyramid_nearest_block(blocked, visited, top, br, bc, r, c, &best, out_r, out_c);
+        }
+    }
+    return best <= (long)blocked->rows + blocked->cols;
+}
+
+// Connectivity of the free cells reachable from the start cell; see create_grid_analysis
+struct GridAnalysis {
+    int rows, cols;
+    uint64_t hash;              // content hash of the grid it describes
+    long root;                  // start cell index r * cols + c, -1 if every cell is blocked
+    uint32_t component_size;    // free cells reachable from the start
+    unsigned char *parent_dir;  // per cell: direction towards its DFS parent, PARENT_ROOT or PARENT_NONE
+    uint64_t *articulation;     // bit per cell: removing it disconnects the component
+    uint32_t *component;        // per cell: biconnected component of the edge to its parent
+    uint32_t *branch_size;      // per cell: size of the dead-end branch it roots, else 0
+    long articulation_count, biconnected_count;
+};
+
+void free_grid_analysis(GridAnalysis *a) {
+    if (!a) return;
+    free(a->parent_dir);
+    free(a->articulation);
+    free(a->component);
+    free(a->branch_size);
+    free(a);
+}
+
+// Direction vectors shared by the solvers (up, right, down, left).
+// Bit i of a neighbor mask refers to direction i; the opposite direction is i ^ 2.
+static const int DIR_DR[4] = {-1, 0, 1, 0};
+static const int DIR_DC[4] = {0, 1, 0, -1};
+
+// First direction (in up, right, down, left priority) set in a 4-bit mask, -1 for an empty mask
+static const signed char FIRST_MOVE[16] = {
+    -1, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0
+};
+
+// Bytes per row of a nibble-packed mask array
+static inline int mask_stride(int cols) {
+    return (cols + 1) >> 1;
+}
+
+static inline unsigned nibble_get(const unsigned char *row, int c) {
+    return (row[c >> 1] >> ((c & 1) << 2)) & 0xFu;
+}
+
+static inline void nibble_or(unsigned char *row, int c, unsigned bits) {
+    row[c >> 1] |= (unsigned char)(bits << ((c & 1) << 2));
+}
+
+static inline void nibble_clear(unsigned char *row, int c, unsigned bits) {
+    row[c >> 1] &= (unsigned char)~(bits << ((c & 1) << 2));
+}
+
+// Free-neighbor mask of cell (r, c): bit i is set when the neighbor in direction i
+// is inside the grid and unblocked. The cell's own state does not affect its mask.
+static inline unsigned grid_neighbor_mask(const Grid *g, int r, int c) {
+    return nibble_get(g->nbr_mask[r], c);
+}
+
+// Recompute the neighbor mask of a single cell from the blocked array
+static void update_neighbor_mask(Grid *g, int r, int c) {
+    unsigned m = 0;
+    for (int i = 0; i < 4; i++) {
+        int nr = r + DIR_DR[i];
+        int nc = c + DIR_DC[i];
+        if (nr >= 0 && nr < g->rows && nc >= 0 && nc < g->cols && !g->blocked[nr][nc]) {
+            m |= 1u << i;
+        }
+    }
+    nibble_clear(g->nbr_mask[r], c, 0xFu);
+    nibble_or(g->nbr_mask[r], c, m);
+}
+
+static void rebuild_neighbor_masks(Grid *g) {
+    for (int r = 0; r < g->rows; r++) {
+        for (int c = 0; c < g->cols; c++) update_neighbor_mask(g, r, c);
+    }
+}
+
+// Hash contribution of blocked cell number index (r * cols + c). The grid hash is
+// the XOR over all blocked cells, so toggling a cell updates it in O(1).
+static inline uint64_t cell_hash(uint64_t index) {
+    uint64_t z = index + 0x9E3779B97F4A7C15ull;  // splitmix64 finalizer
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Weight collected by visiting (r, c); blocked cells keep their weight but are never visited
+static inline long grid_cell_weight(const Grid *g, int r, int c) {
+    return g->weight ? g->weight[(size_t)r * g->cols + c] : 1;
+}
+
+static inline uint64_t weight_hash_term(uint64_t index, unsigned weight) {
+    return weight == 1 ? 0 : cell_hash(index ^ ((uint64_t)weight << 48));
+}
+
+// Set the weight of (r, c). The weight array is allocated, with every cell at 1,
+// the first time a weight is set.
+void set_cell_weight(Grid *g, int r, int c, unsigned weight) {
+    if (!g || r < 0 || r >= g->rows || c < 0 || c >= g->cols) return;
+    if (weight > UINT16_MAX) weight = UINT16_MAX;
+    size_t n = (size_t)g->rows * g->cols, i = (size_t)r * g->cols + c;
+    if (!g->weight) {
+        if (weight == 1) return;
+        g->weight = (uint16_t*)malloc(n * sizeof(uint16_t));
+        if (!g->weight) {
+            fprintf(stderr, "Memory allocation failed for cell weights\n");
+            exit(1);
+        }
+        for (size_t k = 0; k < n; k++) g->weight[k] = 1;
+    }
+    g->weight_hash ^= weight_hash_term(i, g->weight[i]) ^ weight_hash_term(i, weight);
+    g->weight[i] = (uint16_t)weight;
+}
+
+// Drop all weights, making the grid unweighted again
+void clear_cell_weights(Grid *g) {
+    free(g->weight);
+    g->weight = NULL;
+    g->weight_hash = 0;
+}
+
+// Recompute all derived data (neighbor masks, blocked pyramid, row intervals,
+// hash), e.g. after writing g->blocked directly
+void refresh_grid(Grid *g) {
+    rebuild_neighbor_masks(g);
+    free_grid_analysis(g->analysis);
+    g->analysis = NULL;
+    if (g->blocked_pyramid) {
+        // A grid refilled in place keeps its dimensions, so the pyramid can be reused
+        clear_bit_pyramid(g->blocked_pyramid);
+        fill_blocked_pyramid(g->blocked_pyramid, g->blocked);
+    } else {
+        g->blocked_pyramid = build_blocked_pyramid(g->blocked, g->rows, g->cols);
+    }
+    free_interval_grid(g->intervals);
+    g->intervals = create_interval_grid(g);
+    g->hash = 0;
+    for (int r = 0; r < g->rows; r++) {
+        for (int c = 0; c < g->cols; c++) {
+            if (g->blocked[r][c]) g->hash ^= cell_hash((uint64_t)r * g->cols + c);
+        }
+    }
+}
+
+// Allocate a rows x cols grid with every cell free and no derived data. Callers
+// write g->blocked and then call refresh_grid once.
+static Grid *allocate_grid(int rows, int cols) {
     Grid *g = (Grid*)malloc(sizeof(Grid));
     if (!g) {
         fprintf(stderr, "Memory allocation failed for Grid\n");
@@ -25,6 +408,20 @@ Grid *create_grid(int rows, int cols, int blocked_count, const int blocked_list[
         free(g);
         exit(1);
     }
+    // Neighbor masks live in one block, indexed through per-row pointers like blocked
+    int stride = mask_stride(cols);
+    g->nbr_mask = (unsigned char**)malloc(rows * sizeof(unsigned char*));
+    unsigned char *mask_block = (unsigned char*)calloc((size_t)rows * stride, 1);
+    if (!g->nbr_mask || !mask_block) {
+        fprintf(stderr, "Memory allocation failed for neighbor masks\n");
+        free(g->nbr_mask);
+        free(mask_block);
+        free(g->blocked);
+        free(g);
+        exit(1);
+    }
+    g->mask_block = mask_block;
+    for (int i = 0; i < rows; i++) g->nbr_mask[i] = mask_block + (size_t)i * stride;
     for (int i = 0; i < rows; i++) {
         g->blocked[i] = (bool*)malloc(cols * sizeof(bool));
         if (!g->blocked[i]) {
@@ -32,6 +429,8 @@ Grid *create_grid(int rows, int cols, int blocked_count, const int blocked_list[
             // free previously allocated rows
             for (int r = 0; r < i; r++) free(g->blocked[r]);
             free(g->blocked);
+            free(mask_block);
+            free(g->nbr_mask);
             free(g);
             exit(1);
         }
@@ -40,6 +439,18 @@ Grid *create_grid(int rows, int cols, int blocked_count, const int blocked_list[
             g->blocked[i][j] = false;
         }
     }
+    g->blocked_pyramid = NULL;
+    g->hash = 0;
+    g->analysis = NULL;
+    g->intervals = NULL;
+    g->weight = NULL;
+    g->weight_hash = 0;
+    return g;
+}
+
+// Create a new grid of size rows x cols, marking blocked cells from the list
+Grid *create_grid(int rows, int cols, int blocked_count, const int blocked_list[][2]) {
+    Grid *g = allocate_grid(rows, cols);
     // Mark blocked cells from the list (assuming 0-based indices)
     for (int i = 0; i < blocked_count; i++) {
         int r = blocked_list[i][0];
@@ -48,9 +459,32 @@ Grid *create_grid(int rows, int cols, int blocked_count, const int blocked_list[
             g->blocked[r][c] = true;
         }
     }
+    refresh_grid(g);
     return g;
 }
 
+// Block or unblock a single cell, keeping the neighbor masks of adjacent cells in sync.
+// All mutations of an existing grid should go through this function.
+void set_blocked(Grid *g, int r, int c, bool blocked) {
+    if (!g || r < 0 || r >= g->rows || c < 0 || c >= g->cols) return;
+    if (g->blocked[r][c] == blocked) return;
+    g->blocked[r][c] = blocked;
+    g->hash ^= cell_hash((uint64_t)r * g->cols + c);
+    free_grid_analysis(g->analysis);
+    g->analysis = NULL;
+    free_interval_grid(g->intervals);
+    g->intervals = NULL;
+    if (g->blocked_pyramid) bit_pyramid_set(g->blocked_pyramid, r, c, blocked);
+    for (int i = 0; i < 4; i++) {
+        int nr = r + DIR_DR[i];
+        int nc = c + DIR_DC[i];
+        if (nr < 0 || nr >= g->rows || nc < 0 || nc >= g->cols) continue;
+        unsigned bit = 1u << (i ^ 2);  // neighbor sees this cell in the opposite direction
+        if (blocked) nibble_clear(g->nbr_mask[nr], nc, bit);
+        else nibble_or(g->nbr_mask[nr], nc, bit);
+    }
+}
+
 // Free memory allocated for the grid
 void free_grid(Grid *g) {
     if (!g) return;
@@ -58,224 +492,7285 @@ void free_grid(Grid *g) {
         free(g->blocked[i]);
     }
     free(g->blocked);
+    free(g->mask_block);
+    free(g->nbr_mask);
+    free_bit_pyramid(g->blocked_pyramid);
+    free_grid_analysis(g->analysis);
+    free_interval_grid(g->intervals);
+    free(g->weight);
     free(g);
 }
 
 // Print grid: '.' free, '#' blocked
 void print_grid(const Grid *g) {
     if (!g) return;
+    if (g->blocked_pyramid) {
+        // Emit each row 8 cells at a time, filling uniform spans in one go
+        const BitPyramid *p = g->blocked_pyramid;
+        char *line = (char*)malloc((size_t)g->cols + 1);
+        if (!line) {
+            fprintf(stderr, "Memory allocation failed for print buffer\n");
+            exit(1);
+        }
+        for (int r = 0; r < g->rows; r++) {
+            for (int bc = 0; bc < p->level_cols[0]; bc++) {
+                int c0 = bc * 8, w = g->cols - c0 < 8 ? g->cols - c0 : 8;
+                unsigned bits = (p->leaf[(size_t)(r >> 3) * p->level_cols[0] + bc] >> ((r & 7) * 8)) & 0xFF;
+                if (bits == 0) memset(line + c0, '.', w);
+                else if (bits == (1u << w) - 1) memset(line + c0, '#', w);
+                else for (int i = 0; i < w; i++) line[c0 + i] = ((bits >> i) & 1) ? '#' : '.';
+            }
+            line[g->cols] = '\n';
+            fwrite(line, 1, (size_t)g->cols + 1, stdout);
+        }
+        free(line);
+        return;
+    }
     for (int r = 0; r < g->rows; r++) {
         for (int c = 0; c < g->cols; c++) putchar(g->blocked[r][c] ? '#' : '.');
         putchar('\n');
     }
 }
 
-// Solve the path planning problem: find a path covering as many unique free cells as possible
-// under the movement limit. Uses a greedy heuristic: always move to an unvisited neighbor if possible,
-// otherwise move to a neighbor that leads towards unvisited cells.
-void solve_path(Grid *g, int movement_points) {
-    int rows = g->rows;
-    int cols = g->cols;
-    // Check for any unblocked start cell
-    int start_r = -1, start_c = -1;
-    for (int i = 0; i < rows && start_r < 0; i++) {
-        for (int j = 0; j < cols; j++) {
-            if (!g->blocked[i][j]) {
-                start_r = i;
-                start_c = j;
-                break;
-            }
-        }
+// Record (r, c) as visited in the visited-neighbor masks of its free neighbors
+static inline void mark_visited(const Grid *g, unsigned char *vis_mask, int stride, int r, int c) {
+    unsigned m = grid_neighbor_mask(g, r, c);
+    while (m) {
+        int d = FIRST_MOVE[m];
+        m &= m - 1;
+        int nc = c + DIR_DC[d];
+        nibble_or(vis_mask + (size_t)(r + DIR_DR[d]) * stride, nc, 1u << (d ^ 2));
     }
-    if (start_r < 0) {
-        // No unblocked cell found
-        printf("Unique squares visited: 0\n");
-        return;
+}
+
+// Make room for a path of up to `length` cells
+static void path_result_reserve(PathResult *res, int length) {
+    if (length <= res->capacity) return;
+    int *pr = (int*)realloc(res->path_r, length * sizeof(int));
+    int *pc = (int*)realloc(res->path_c, length * sizeof(int));
+    if (!pr || !pc) {
+        fprintf(stderr, "Memory allocation failed for path of length %d\n", length);
+        exit(1);
     }
-    // Allocate visited array
-    bool **visited = (bool**)malloc(rows * sizeof(bool*));
-    for (int i = 0; i < rows; i++) {
-        visited[i] = (bool*)malloc(cols * sizeof(bool));
-        for (int j = 0; j < cols; j++) {
-            visited[i][j] = false;
-        }
-    }
-    // Arrays to store the path coordinates
-    int max_path_len = movement_points + 1;
-    int *path_r = (int*)malloc(max_path_len * sizeof(int));
-    int *path_c = (int*)malloc(max_path_len * sizeof(int));
-
-    // Starting position
-    int cr = start_r, cc = start_c;
-    visited[cr][cc] = true;
-    path_r[0] = cr;
-    path_c[0] = cc;
-    int pathLen = 1;
-    int unique_count = 1;
-
-    // Define direction vectors (up, right, down, left)
-    int dr[4] = {-1, 0, 1, 0};
-    int dc[4] = {0, 1, 0, -1};
-
-    // Attempt to move up to movement_points steps
-    for (int step = 0; step < movement_points; step++) {
-        bool moved = false;
-        // First try to find an unvisited neighboring cell
-        for (int i = 0; i < 4; i++) {
-            int nr = cr + dr[i];
-            int nc = cc + dc[i];
-            if (nr >= 0 && nr < rows && nc >= 0 && nc < cols) {
-                if (!g->blocked[nr][nc] && !visited[nr][nc]) {
-                    // Move to this new cell
-                    cr = nr;
-                    cc = nc;
-                    visited[cr][cc] = true;
-                    path_r[pathLen] = cr;
-                    path_c[pathLen] = cc;
-                    pathLen++;
-                    unique_count++;
-                    moved = true;
-                    break;
-                }
-            }
+    res->path_r = pr;
+    res->path_c = pc;
+    res->capacity = length;
+}
+
+void free_path_result(PathResult *res) {
+    if (!res) return;
+    free(res->path_r);
+    free(res->path_c);
+    res->path_r = res->path_c = NULL;
+    res->length = res->capacity = res->unique_count = 0;
+    res->weight = res->upper_bound = 0;
+}
+
+// Print the path and count of unique visited cells
+void fprint_path_result(FILE *out, const PathResult *res) {
+    if (res->length > 0) {
+        fprintf(out, "Path:");
+        for (int i = 0; i < res->length; i++) {
+            fprintf(out, " (%d,%d)", res->path_r[i], res->path_c[i]);
         }
-        if (moved) continue;
-        // No unvisited neighbor found; try a visited neighbor that has an unvisited neighbor
-        for (int i = 0; i < 4 && !moved; i++) {
-            int nr = cr + dr[i];
-            int nc = cc + dc[i];
-            if (nr >= 0 && nr < rows && nc >= 0 && nc < cols) {
-                if (!g->blocked[nr][nc] && visited[nr][nc]) {
-                    // Check neighbors of (nr, nc)
-                    for (int j = 0; j < 4; j++) {
-                        int r2 = nr + dr[j];
-                        int c2 = nc + dc[j];
-                        if (r2 >= 0 && r2 < rows && c2 >= 0 && c2 < cols) {
-                            if (!g->blocked[r2][c2] && !visited[r2][c2]) {
-                                // Move to the visited neighbor (backtrack step)
-                                cr = nr;
-                                cc = nc;
-                                path_r[pathLen] = cr;
-                                path_c[pathLen] = cc;
-                                pathLen++;
-                                moved = true;
-                                break;
-                            }
-                        }
-                    }
-                }
-            }
+        fprintf(out, "\n");
+    }
+    fprintf(out, "Unique squares visited: %d\n", res->unique_count);
+    if (res->upper_bound > 0) {
+        fprintf(out, "Upper bound: %ld (gap %ld)\n", res->upper_bound, res->upper_bound - res->weight);
+    }
+}
+
+void print_path_result(const PathResult *res) {
+    fprint_path_result(stdout, res);
+}
+
+// Search state of solve_path_scheduled, kept on the context for grids of up to
+// `cells` cells. Stamps carry a generation across solves, so they are only
+// cleared when the arrays grow or the generation wraps.
+struct ScheduleSearch {
+    size_t cells;
+    uint32_t *stamp, mark;
+    int *arrival;
+    uint32_t *parent;
+    uint64_t *heap;  // min-heap of (arrival time << 32 | cell)
+    size_t heap_capacity;
+};
+
+static void free_schedule_search(ScheduleSearch *s) {
+    if (!s) return;
+    free(s->stamp);
+    free(s->arrival);
+    free(s->parent);
+    free(s->heap);
+    free(s);
+}
+
+// The context's scheduled search state, sized for n cells
+static ScheduleSearch *context_schedule_search(SolveContext *ctx, size_t n) {
+    ScheduleSearch *s = ctx->schedule_search;
+    if (!s) {
+        s = ctx->schedule_search = (ScheduleSearch*)calloc(1, sizeof(ScheduleSearch));
+        if (s) {
+            s->heap_capacity = 1024;
+            s->heap = (uint64_t*)malloc(s->heap_capacity * sizeof(uint64_t));
         }
-        if (!moved) {
-            // No move possible that increases coverage; stop early
-            break;
+        if (!s || !s->heap) {
+            fprintf(stderr, "Memory allocation failed for scheduled search\n");
+            exit(1);
         }
     }
-
-    // Print the path and count of unique visited cells
-    printf("Path:");
-    for (int i = 0; i < pathLen; i++) {
-        printf(" (%d,%d)", path_r[i], path_c[i]);
+    if (n > s->cells) {
+        free(s->stamp);
+        free(s->arrival);
+        free(s->parent);
+        s->stamp = (uint32_t*)calloc(n, sizeof(uint32_t));
+        s->arrival = (int*)malloc(n * sizeof(int));
+        s->parent = (uint32_t*)malloc(n * sizeof(uint32_t));
+        if (!s->stamp || !s->arrival || !s->parent) {
+            fprintf(stderr, "Memory allocation failed for scheduled search\n");
+            exit(1);
+        }
+        s->cells = n;
+        s->mark = 0;
     }
-    printf("\nUnique squares visited: %d\n", unique_count);
+    return s;
+}
 
-    // Free allocated memory for visited and path arrays
-    for (int i = 0; i < rows; i++) {
-        free(visited[i]);
+SolveContext *create_solve_context(void) {
+    SolveContext *ctx = (SolveContext*)calloc(1, sizeof(SolveContext));
+    if (!ctx) {
+        fprintf(stderr, "Memory allocation failed for SolveContext\n");
+        exit(1);
     }
-    free(visited);
-    free(path_r);
-    free(path_c);
+    return ctx;
 }
 
-// Generate num_blocked unique random blocked cells inside the grid.
-// If num_blocked > number of currently-free cells, it will block all free cells.
-void generate_blocked(Grid *g, int num_blocked) {
-    if (!g || num_blocked <= 0) return;
+void free_solve_context(SolveContext *ctx) {
+    if (!ctx) return;
+    free(ctx->vis_mask);
+    free_bit_pyramid(ctx->visited_pyramid);
+    free_schedule_search(ctx->schedule_search);
+    free(ctx);
+}
 
-    // Count already blocked cells
-    long already_blocked = 0;
-    for (int r = 0; r < g->rows; r++) {
-        for (int c = 0; c < g->cols; c++) {
-            if (g->blocked[r][c]) already_blocked++;
+// Return a zeroed scratch buffer of at least the given size
+static unsigned char *context_scratch(SolveContext *ctx, size_t bytes) {
+    if (bytes > ctx->vis_capacity) {
+        free(ctx->vis_mask);
+        ctx->vis_mask = (unsigned char*)malloc(bytes);
+        if (!ctx->vis_mask) {
+            fprintf(stderr, "Memory allocation failed for visited masks\n");
+            exit(1);
         }
+        ctx->vis_capacity = bytes;
     }
+    memset(ctx->vis_mask, 0, bytes);
+    return ctx->vis_mask;
+}
 
-    long total_cells = (long)g->rows * (long)g->cols;
-    long available = total_cells - already_blocked;
-    if (available <= 0) return;
+// Return a zeroed visited-neighbor mask buffer large enough for grid g
+static unsigned char *context_visited_masks(SolveContext *ctx, const Grid *g) {
+    return context_scratch(ctx, (size_t)g->rows * mask_stride(g->cols));
+}
 
-    if (num_blocked > available) num_blocked = (int)available;
+void bit_pyramid_clear(BitPyramid *p) {
+    memset(p->leaf, 0, (size_t)p->level_rows[0] * p->level_cols[0] * sizeof(uint64_t));
+    for (int k = 1; k < p->levels; k++) {
+        memset(p->count[k], 0, (size_t)p->level_rows[k] * p->level_cols[k] * sizeof(uint32_t));
+    }
+    p->total = 0;
+}
 
-    int placed = 0;
-    // Simple random sampling with rejection; OK unless blocking nearly whole grid.
-    while (placed < num_blocked) {
-        int r = rand() % g->rows;
-        int c = rand() % g->cols;
-        if (g->blocked[r][c]) continue; // already blocked, try again
-        g->blocked[r][c] = true;
-        placed++;
+// Return a cleared visited pyramid for grid g, or NULL when the context does not track one
+static BitPyramid *context_visited_pyramid(SolveContext *ctx, const Grid *g) {
+    if (!ctx->track_visited) return NULL;
+    BitPyramid *p = ctx->visited_pyramid;
+    if (p && p->rows == g->rows && p->cols == g->cols) {
+        bit_pyramid_clear(p);
+        return p;
     }
+    free_bit_pyramid(p);
+    ctx->visited_pyramid = create_bit_pyramid(g->rows, g->cols);
+    return ctx->visited_pyramid;
 }
 
-// Main function with test cases
-int main() {
-    // Test 1: Tiny grid 1x1, no blocked cells
-    {
-        const int N = 1, M = 1;
-        const int (*blocked_cells1)[2] = NULL;  // no blocked cells
-        Grid *g1 = create_grid(N, M, 0, blocked_cells1);
-        printf("Test 1 (%dx%d, no blocks):\n", N, M);
-        solve_path(g1, 1);
-        print_grid(g1);
-        free_grid(g1);
-        printf("\n");
+// First unblocked cell in row-major order; false if every cell is blocked
+static bool find_start_cell(const Grid *g, int *start_r, int *start_c) {
+    if (g->blocked_pyramid) return pyramid_first_clear(g->blocked_pyramid, start_r, start_c);
+    for (int i = 0; i < g->rows; i++) {
+        for (int j = 0; j < g->cols; j++) {
+            if (!g->blocked[i][j]) {
+                *start_r = i;
+                *start_c = j;
+                return true;
+            }
+        }
     }
-    // Test 2: Grid 2x2 where all cells are blocked
-    {
-        const int N = 2, M = 2;
-        const int blocked_cells2[][2] = {{0,0}, {0,1}, {1,0}, {1,1}};
-        Grid *g2 = create_grid(N, M, 4, blocked_cells2);
-        printf("Test 2 (%dx%d, all blocked):\n", N, M);
-        solve_path(g2, 10);
-        print_grid(g2);
-        free_grid(g2);
-        printf("\n");
+    return false;
+}
+
+// In-flight greedy solve, advanced one move at a time so several solves can be
+// interleaved. Each step commits the move decided by the previous step, then
+// decides the next move and prefetches the memory that committing it will touch.
+typedef struct {
+    const Grid *g;
+    unsigned char *vis_mask;  // visited-neighbor masks, matching g->nbr_mask
+    BitPyramid *visited_pyr;  // visited cells, NULL if not tracked
+    int stride;
+    int cr, cc;               // current cell
+    int nr, nc;               // pending move target
+    bool forward;             // pending move enters an unvisited cell
+    bool done;
+    int steps_left;
+    int target;               // stop once this many cells are covered
+    PathResult *res;
+} SolveState;
+
+static inline void prefetch_cell(const SolveState *s, int r, int c) {
+    __builtin_prefetch(&s->g->nbr_mask[r][c >> 1]);
+    for (int rr = r - 1; rr <= r + 1; rr++) {
+        if (rr < 0 || rr >= s->g->rows) continue;
+        __builtin_prefetch(s->vis_mask + (size_t)rr * s->stride + (c >> 1), 1);
     }
-    // Test 3: Grid with a single possible path (3x3 with a blocked center row)
-    {
-        const int N = 3, M = 3;
-        const int blocked_cells3[][2] = {{1,0}, {1,1}, {1,2}};
-        Grid *g3 = create_grid(N, M, 3, blocked_cells3);
-        printf("Test 3 (%dx%d, one path):\n", N, M);
-        solve_path(g3, 5);
-        print_grid(g3);
-        free_grid(g3);
-        printf("\n");
+}
+
+// Decide the next move from (cr, cc): the first unvisited neighbor if there is one,
+// otherwise a visited neighbor that has an unvisited neighbor.
+static inline void solve_state_decide(SolveState *s) {
+    if (s->steps_left <= 0 || s->res->unique_count >= s->target) {
+        s->done = true;
+        return;
     }
-    // Test 4: Larger grid with many free cells (5x5 no blocks)
-    {
-        const int N = 5, M = 5;
-        const int (*blocked_cells4)[2] = NULL;  // no blocked cells
-        Grid *g4 = create_grid(N, M, 0, blocked_cells4);
-        printf("Test 4 (%dx%d, no blocks):\n", N, M);
-        solve_path(g4, 30);
-        print_grid(g4);
-        free_grid(g4);
-        printf("\n");
+    const Grid *g = s->g;
+    int cr = s->cr, cc = s->cc;
+    unsigned avail = grid_neighbor_mask(g, cr, cc) & ~nibble_get(s->vis_mask + (size_t)cr * s->stride, cc);
+    if (avail) {
+        int d = FIRST_MOVE[avail];
+        s->nr = cr + DIR_DR[d];
+        s->nc = cc + DIR_DC[d];
+        s->forward = true;
+        prefetch_cell(s, s->nr, s->nc);
+        return;
     }
-    
-    srand((unsigned) time(NULL)); // Seed RNG once
-    // Test 5: Randomly generated grid (10x10 with 20 random blocked cells)
-    {
-        const int N = 100, M = 10;
-        Grid *g5 = create_grid(N, M, 0, NULL);
-        generate_blocked(g5, 200);
-        printf("Test 5 (%dx%d, random blocks):\n", N, M);
-        solve_path(g5, 50);
-        print_grid(g5);
-        free_grid(g5);
-        printf("\n");
+    unsigned back = grid_neighbor_mask(g, cr, cc);
+    while (back) {
+        int d = FIRST_MOVE[back];
+        back &= back - 1;
+        int nr = cr + DIR_DR[d];
+        int nc = cc + DIR_DC[d];
+        if (grid_neighbor_mask(g, nr, nc) & ~nibble_get(s->vis_mask + (size_t)nr * s->stride, nc)) {
+            s->nr = nr;
+            s->nc = nc;
+            s->forward = false;
+            prefetch_cell(s, nr, nc);
+            return;
+        }
     }
-    return 0;
+    // No move possible that increases coverage; stop early
+    s->done = true;
 }
+
+// Start a solve of g from (sr, sc), or an empty path if sr < 0; res must have room
+// for movement_points + 1 cells
+static void solve_state_init_at(SolveState *s, const Grid *g, int sr, int sc, int movement_points,
+                                unsigned char *vis_mask, BitPyramid *visited_pyr, PathResult *res) {
+    s->g = g;
+    s->vis_mask = vis_mask;
+    s->visited_pyr = visited_pyr;
+    s->stride = mask_stride(g->cols);
+    s->steps_left = movement_points;
+    s->target = INT_MAX;
+    s->res = res;
+    s->done = false;
+    res->length = 0;
+    res->unique_count = 0;
+    res->weight = res->upper_bound = 0;
+    if (sr < 0) {
+        s->done = true;
+        return;
+    }
+    s->cr = sr;
+    s->cc = sc;
+    mark_visited(g, vis_mask, s->stride, s->cr, s->cc);
+    if (visited_pyr) bit_pyramid_set(visited_pyr, s->cr, s->cc, true);
+    res->path_r[0] = s->cr;
+    res->path_c[0] = s->cc;
+    res->length = 1;
+    res->unique_count = 1;
+    solve_state_decide(s);
+}
+
+// Start a solve of g from its first free cell
+static void solve_state_init(SolveState *s, const Grid *g, int movement_points,
+                             unsigned char *vis_mask, BitPyramid *visited_pyr, PathResult *res) {
+    int sr, sc;
+    if (!find_start_cell(g, &sr, &sc)) sr = sc = -1;
+    solve_state_init_at(s, g, sr, sc, movement_points, vis_mask, visited_pyr, res);
+}
+
+// Commit the pending move and decide the following one
+static inline void solve_state_step(SolveState *s) {
+    s->cr = s->nr;
+    s->cc = s->nc;
+    if (s->forward) {
+        mark_visited(s->g, s->vis_mask, s->stride, s->cr, s->cc);
+        if (s->visited_pyr) bit_pyramid_set(s->visited_pyr, s->cr, s->cc, true);
+        s->res->unique_count++;
+    }
+    s->res->path_r[s->res->length] = s->cr;
+    s->res->path_c[s->res->length] = s->cc;
+    s->res->length++;
+    s->steps_left--;
+    solve_state_decide(s);
+}
+
+// ---------------------------------------------------------------------------
+// Fixed-dimension greedy solvers.
+//
+// FIXED_GRID_SOLVER(R, C) stamps out the greedy of solve_path_into for an R x C
+// grid with its dimensions as compile-time constants. Visited cells live in a
+// stack bitset padded by a row on either side, so the row stride is a constant
+// and the four neighbor loads need no bounds tests: the grid's neighbor mask
+// discards the ones that fall outside. solve_path_until dispatches to them when
+// a grid's dimensions match one of FIXED_SOLVERS.
+// ---------------------------------------------------------------------------
+
+#define FIXED_WORDS(R, C) (((R) * (C) + 2 * (C) + 63) / 64)
+#define FIXED_SEEN(i) (seen[((i) + C) >> 6] >> (((i) + C) & 63) & 1)
+
+// The shared body; always inlined into the stamped solvers so R and C fold to constants
+static inline __attribute__((always_inline))
+void solve_fixed(const Grid *g, int sr, int sc, int movement_points, int target, PathResult *res,
+                 const int R, const int C, uint64_t *seen) {
+    if (movement_points < 0) movement_points = 0;
+    path_result_reserve(res, movement_points + 1);
+    res->length = res->unique_count = 0;
+    res->weight = res->upper_bound = 0;
+    if (sr < 0) return;
+    memset(seen, 0, FIXED_WORDS(R, C) * sizeof(uint64_t));
+    // Up, right, down, left, matching FIRST_MOVE
+    const int step[4] = {-C, 1, C, -1};
+    int cur = sr * C + sc;
+    seen[(cur + C) >> 6] |= (uint64_t)1 << ((cur + C) & 63);
+    res->path_r[0] = sr;
+    res->path_c[0] = sc;
+    res->length = res->unique_count = 1;
+    for (int left = movement_points; left > 0 && res->unique_count < target; left--) {
+        unsigned nbr = grid_neighbor_mask(g, cur / C, cur % C);
+        unsigned visited = FIXED_SEEN(cur - C) | FIXED_SEEN(cur + 1) << 1 |
+                           FIXED_SEEN(cur + C) << 2 | FIXED_SEEN(cur - 1) << 3;
+        int next = -1;
+        if (nbr & ~visited) {
+            next = cur + step[FIRST_MOVE[nbr & ~visited]];
+            seen[(next + C) >> 6] |= (uint64_t)1 << ((next + C) & 63);
+            res->unique_count++;
+        } else {
+            for (unsigned m = nbr; m && next < 0; m &= m - 1) {
+                int n = cur + step[FIRST_MOVE[m]];
+                unsigned n_visited = FIXED_SEEN(n - C) | FIXED_SEEN(n + 1) << 1 |
+                                     FIXED_SEEN(n + C) << 2 | FIXED_SEEN(n - 1) << 3;
+                if (grid_neighbor_mask(g, n / C, n % C) & ~n_visited) next = n;
+            }
+            if (next < 0) break;
+        }
+        cur = next;
+        res->path_r[res->length] = cur / C;
+        res->path_c[res->length] = cur % C;
+        res->length++;
+    }
+}
+
+#define FIXED_GRID_SOLVER(R, C) \
+    static void solve_fixed_##R##x##C(const Grid *g, int sr, int sc, int movement_points, int target, \
+                                      PathResult *res) { \
+        uint64_t seen[FIXED_WORDS(R, C)]; \
+        solve_fixed(g, sr, sc, movement_points, target, res, R, C, seen); \
+    }
+
+FIXED_GRID_SOLVER(16, 16)
+FIXED_GRID_SOLVER(32, 32)
+FIXED_GRID_SOLVER(64, 64)
+FIXED_GRID_SOLVER(256, 256)
+
+static const struct {
+    int rows, cols;
+    void (*solve)(const Grid *g, int sr, int sc, int movement_points, int target, PathResult *res);
+} FIXED_SOLVERS[] = {
+    {16, 16, solve_fixed_16x16},
+    {32, 32, solve_fixed_32x32},
+    {64, 64, solve_fixed_64x64},
+    {256, 256, solve_fixed_256x256},
+};
+
+// Greedy solve from (sr, sc) that stops as soon as target cells are covered; an
+// empty path if sr < 0. Grids matching a fixed-dimension solver use it unless the
+// context tracks visited cells.
+typedef void (*FixedSolver)(const Grid *g, int sr, int sc, int movement_points, int target, PathResult *res);
+
+// The fixed-dimension solver for g's dimensions, or NULL
+static FixedSolver fixed_solver(const Grid *g) {
+    for (size_t i = 0; i < sizeof(FIXED_SOLVERS) / sizeof(FIXED_SOLVERS[0]); i++) {
+        if (g->rows == FIXED_SOLVERS[i].rows && g->cols == FIXED_SOLVERS[i].cols) return FIXED_SOLVERS[i].solve;
+    }
+    return NULL;
+}
+
+static void solve_path_until_at(const Grid *g, int sr, int sc, int movement_points, int target,
+                                SolveContext *ctx, PathResult *res) {
+    FixedSolver fixed = ctx->track_visited ? NULL : fixed_solver(g);
+    if (fixed) {
+        fixed(g, sr, sc, movement_points, target, res);
+        return;
+    }
+    if (movement_points < 0) movement_points = 0;
+    path_result_reserve(res, movement_points + 1);
+    SolveState s;
+    solve_state_init_at(&s, g, sr, sc, movement_points, context_visited_masks(ctx, g),
+                        context_visited_pyramid(ctx, g), res);
+    s.target = target;
+    if (res->unique_count >= target) s.done = true;
+    while (!s.done) solve_state_step(&s);
+}
+
+// Greedy solve from the first free cell (see solve_path_until_at)
+static void solve_path_until(const Grid *g, int movement_points, int target, SolveContext *ctx, PathResult *res) {
+    int sr, sc;
+    if (!find_start_cell(g, &sr, &sc)) sr = sc = -1;
+    solve_path_until_at(g, sr, sc, movement_points, target, ctx, res);
+}
+
+// Solve the path planning problem: find a path covering as many unique free cells as possible
+// under the movement limit. Uses a greedy heuristic: always move to an unvisited neighbor if possible,
+// otherwise move to a neighbor that leads towards unvisited cells.
+// The path is stored in res; ctx provides reusable scratch memory.
+void solve_path_into(const Grid *g, int movement_points, SolveContext *ctx, PathResult *res) {
+    solve_path_until(g, movement_points, INT_MAX, ctx, res);
+}
+
+// Greedy solve as solve_path_into, but starting from (start_r, start_c) instead of
+// the first free cell. Returns false, leaving res empty, if the start is outside
+// the grid or blocked.
+bool solve_path_from(const Grid *g, int start_r, int start_c, int movement_points,
+                     SolveContext *ctx, PathResult *res) {
+    if (start_r < 0 || start_r >= g->rows || start_c < 0 || start_c >= g->cols || g->blocked[start_r][start_c]) {
+        res->length = res->unique_count = 0;
+        res->weight = res->upper_bound = 0;
+        return false;
+    }
+    solve_path_until_at(g, start_r, start_c, movement_points, INT_MAX, ctx, res);
+    return true;
+}
+
+// Greedy solve from the free cell (sr, sc) on a zeroed visited-mask buffer of
+// mask_bytes that is left zeroed for the next solve: the marks the path left
+// all sit in the free neighbors of its cells, so clearing them costs O(path)
+// where clearing the buffer costs O(cells). A long path on a small grid is
+// cleared faster by one memset.
+static void solve_path_on_masks(const Grid *g, int sr, int sc, int movement_points, unsigned char *vis_mask,
+                                size_t mask_bytes, PathResult *res) {
+    path_result_reserve(res, movement_points + 1);
+    SolveState s;
+    solve_state_init_at(&s, g, sr, sc, movement_points, vis_mask, NULL, res);
+    while (!s.done) solve_state_step(&s);
+    if ((size_t)res->length * 128 >= mask_bytes) {
+        memset(vis_mask, 0, mask_bytes);
+        return;
+    }
+    // Whole bytes are zeroed, clearing both cells' nibbles
+    for (int k = 0; k < res->length; k++) {
+        int r = res->path_r[k], c = res->path_c[k];
+        for (unsigned m = grid_neighbor_mask(g, r, c); m; m &= m - 1) {
+            int d = FIRST_MOVE[m];
+            vis_mask[(size_t)(r + DIR_DR[d]) * s.stride + ((c + DIR_DC[d]) >> 1)] = 0;
+        }
+    }
+}
+
+// Solve and print the path with the greedy heuristic (see solve_path_into)
+void solve_path(Grid *g, int movement_points) {
+    SolveContext *ctx = create_solve_context();
+    PathResult res = {0};
+    solve_path_into(g, movement_points, ctx, &res);
+    print_path_result(&res);
+    free_path_result(&res);
+    free_solve_context(ctx);
+}
+
+// ---------------------------------------------------------------------------
+// Articulation points, biconnected components and dead-end branches.
+//
+// One DFS from the start cell, run with an explicit stack so it handles grids
+// of hundreds of millions of cells. A child v of u with low[v] >= disc[u] roots
+// a branch that is only reachable through u: a dead end for a walk from the
+// start. The walk strategy STRATEGY_DEAD_ENDS tours such branches when it
+// passes their entrance instead of leaving them to be backtracked into later.
+// ---------------------------------------------------------------------------
+
+#define PARENT_ROOT 4
+#define PARENT_NONE 5  // blocked or unreachable from the start
+
+// Build the analysis of g's start component; NULL if the grid has too many cells
+GridAnalysis *create_grid_analysis(const Grid *g) {
+    size_t n = (size_t)g->rows * g->cols;
+    if (n >= UINT32_MAX) {
+        fprintf(stderr, "Grid too large for analysis (%zu cells)\n", n);
+        return NULL;
+    }
+    GridAnalysis *a = (GridAnalysis*)calloc(1, sizeof(GridAnalysis));
+    uint32_t *disc = (uint32_t*)calloc(n + 1, sizeof(uint32_t));  // preorder number + 1, 0 = unseen
+    uint32_t *low = (uint32_t*)malloc((n + 1) * sizeof(uint32_t));
+    uint32_t *size = (uint32_t*)malloc((n + 1) * sizeof(uint32_t));
+    uint32_t *stack = (uint32_t*)malloc((n + 1) * sizeof(uint32_t));
+    unsigned char *next_dir = (unsigned char*)malloc(n + 1);
+    unsigned char *parent_dir = (unsigned char*)malloc(n + 1);
+    uint64_t *articulation = (uint64_t*)calloc((n >> 6) + 1, sizeof(uint64_t));
+    if (!a || !disc || !low || !size || !stack || !next_dir || !parent_dir || !articulation) {
+        fprintf(stderr, "Memory allocation failed for grid analysis\n");
+        exit(1);
+    }
+    memset(parent_dir, PARENT_NONE, n + 1);
+    a->rows = g->rows;
+    a->cols = g->cols;
+    a->hash = g->hash;
+    a->parent_dir = parent_dir;
+    a->articulation = articulation;
+    a->root = -1;
+
+    int sr, sc;
+    uint32_t time = 0;
+    if (find_start_cell(g, &sr, &sc)) {
+        uint32_t root = (uint32_t)sr * g->cols + sc;
+        a->root = root;
+        int root_children = 0;
+        size_t sp = 0;
+        disc[root] = low[root] = ++time;
+        size[root] = 1;
+        next_dir[root] = 0;
+        parent_dir[root] = PARENT_ROOT;
+        stack[sp++] = root;
+        while (sp > 0) {
+            uint32_t u = stack[sp - 1];
+            int ur = u / g->cols, uc = u % g->cols;
+            unsigned m = grid_neighbor_mask(g, ur, uc);
+            bool descended = false;
+            while (next_dir[u] < 4) {
+                int d = next_dir[u]++;
+                if (!(m >> d & 1)) continue;
+                uint32_t w = (uint32_t)((ur + DIR_DR[d]) * g->cols + uc + DIR_DC[d]);
+                if (disc[w] == 0) {
+                    disc[w] = low[w] = ++time;
+                    size[w] = 1;
+                    next_dir[w] = 0;
+                    parent_dir[w] = (unsigned char)(d ^ 2);
+                    stack[sp++] = w;
+                    descended = true;
+                    break;
+                }
+                if (d != parent_dir[u] && disc[w] < low[u]) low[u] = disc[w];  // back edge
+            }
+            if (descended) continue;
+            sp--;
+            if (u == root) continue;
+            int pd = parent_dir[u];
+            uint32_t p = (uint32_t)((ur + DIR_DR[pd]) * g->cols + uc + DIR_DC[pd]);
+            size[p] += size[u];
+            if (low[u] < low[p]) low[p] = low[u];
+            if (low[u] >= disc[p]) {
+                if (p == root) root_children++;
+                else articulation[p >> 6] |= (uint64_t)1 << (p & 63);
+            }
+        }
+        if (root_children > 1) articulation[root >> 6] |= (uint64_t)1 << (root & 63);
+    }
+    a->component_size = time;
+    free(next_dir);
+
+    // Walk cells in preorder (reusing the stack as the order) so each tree edge
+    // can take its parent's component. low becomes the component id and size the
+    // branch size, each overwritten only after its last read.
+    uint32_t *order = stack;
+    for (size_t i = 0; i < n; i++) {
+        if (disc[i]) order[disc[i] - 1] = (uint32_t)i;
+    }
+    uint32_t *component = low, *branch = size;
+    if (time > 0) {
+        component[order[0]] = UINT32_MAX;
+        branch[order[0]] = 0;
+    }
+    for (uint32_t k = 1; k < time; k++) {
+        uint32_t v = order[k];
+        int pd = parent_dir[v];
+        uint32_t p = (uint32_t)((int)(v / g->cols + DIR_DR[pd]) * g->cols + (int)(v % g->cols) + DIR_DC[pd]);
+        if (low[v] >= disc[p]) {
+            component[v] = (uint32_t)a->biconnected_count++;
+        } else {
+            component[v] = component[p];
+            branch[v] = 0;
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (!disc[i]) {
+            component[i] = UINT32_MAX;
+            branch[i] = 0;
+        }
+    }
+    for (size_t w = 0; w <= (n >> 6); w++) a->articulation_count += __builtin_popcountll(articulation[w]);
+    free(disc);
+    free(stack);
+    a->component = component;
+    a->branch_size = branch;
+    return a;
+}
+
+static inline bool grid_analysis_is_articulation(const GridAnalysis *a, int r, int c) {
+    size_t i = (size_t)r * a->cols + c;
+    return a->articulation[i >> 6] >> (i & 63) & 1;
+}
+
+// The analysis cached on g, built on first use; every mutation drops it. The cache
+// is filled even through a const grid, like the hash, so solvers sharing an
+// unchanging grid may race to build it: one copy is published and the others freed.
+static const GridAnalysis *grid_cached_analysis(const Grid *g) {
+    GridAnalysis **slot = (GridAnalysis**)&g->analysis;
+    GridAnalysis *a = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (a) return a;
+    GridAnalysis *built = create_grid_analysis(g);
+    if (!built) return NULL;
+    if (__atomic_compare_exchange_n(slot, &a, built, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) return built;
+    free_grid_analysis(built);
+    return a;
+}
+
+// The grid's cached analysis, built on first use and dropped when the grid changes
+const GridAnalysis *grid_analysis(Grid *g) {
+    return grid_cached_analysis(g);
+}
+
+// Greedy walk that covers dead-end branches as it passes them. Standing on the
+// entrance of unvisited branches that fit in the remaining budget, it enters the
+// smallest one and walks the DFS tree of the branch back to the entrance, so a
+// tree-shaped branch costs exactly two moves per cell. Elsewhere it moves like
+// solve_path_into.
+static void solve_dead_ends_first(const Grid *g, const GridAnalysis *a, int movement_points, int target,
+                                  SolveContext *ctx, PathResult *res) {
+    if (movement_points < 0) movement_points = 0;
+    path_result_reserve(res, movement_points + 1);
+    res->length = res->unique_count = 0;
+    res->weight = res->upper_bound = 0;
+    if (a->root < 0) return;
+    size_t n = (size_t)g->rows * g->cols;
+    uint64_t *visited = (uint64_t*)context_scratch(ctx, ((n >> 6) + 1) * sizeof(uint64_t));
+#define CELL_VISITED(r, c) (visited[((size_t)(r) * g->cols + (c)) >> 6] >> (((size_t)(r) * g->cols + (c)) & 63) & 1)
+    int cr = (int)(a->root / g->cols), cc = (int)(a->root % g->cols);
+    int entrance_r = -1, entrance_c = -1;  // entrance of the branch being toured
+    visited[a->root >> 6] |= (uint64_t)1 << (a->root & 63);
+    res->path_r[0] = cr;
+    res->path_c[0] = cc;
+    res->length = res->unique_count = 1;
+    long limit = target < (long)a->component_size ? target : (long)a->component_size;
+    for (int steps = movement_points; steps > 0 && res->unique_count < limit; steps--) {
+        unsigned m = grid_neighbor_mask(g, cr, cc);
+        int nr = -1, nc = -1;
+        if (cr == entrance_r && cc == entrance_c) entrance_r = entrance_c = -1;
+        if (entrance_r >= 0) {
+            // Touring: next unvisited tree child, else back to the parent
+            for (unsigned rest = m; rest; rest &= rest - 1) {
+                int d = FIRST_MOVE[rest];
+                int wr = cr + DIR_DR[d], wc = cc + DIR_DC[d];
+                if (a->parent_dir[(size_t)wr * g->cols + wc] == (d ^ 2) && !CELL_VISITED(wr, wc)) {
+                    nr = wr;
+                    nc = wc;
+                    break;
+                }
+            }
+            if (nr < 0) {
+                int pd = a->parent_dir[(size_t)cr * g->cols + cc];
+                nr = cr + DIR_DR[pd];
+                nc = cc + DIR_DC[pd];
+            }
+        } else {
+            uint32_t best_size = UINT32_MAX;
+            unsigned avail = 0;
+            for (unsigned rest = m; rest; rest &= rest - 1) {
+                int d = FIRST_MOVE[rest];
+                int wr = cr + DIR_DR[d], wc = cc + DIR_DC[d];
+                if (CELL_VISITED(wr, wc)) continue;
+                avail |= 1u << d;
+                size_t w = (size_t)wr * g->cols + wc;
+                uint32_t branch = a->branch_size[w];
+                if (branch > 0 && a->parent_dir[w] == (d ^ 2) && 2 * (long)branch <= steps && branch < best_size) {
+                    best_size = branch;
+                    nr = wr;
+                    nc = wc;
+                }
+            }
+            if (nr >= 0) {
+                entrance_r = cr;
+                entrance_c = cc;
+            } else if (avail) {
+                int d = FIRST_MOVE[avail];
+                nr = cr + DIR_DR[d];
+                nc = cc + DIR_DC[d];
+            } else {
+                for (unsigned back = m; back && nr < 0; back &= back - 1) {
+                    int d = FIRST_MOVE[back];
+                    int br = cr + DIR_DR[d], bc = cc + DIR_DC[d];
+                    for (unsigned next = grid_neighbor_mask(g, br, bc); next; next &= next - 1) {
+                        int e = FIRST_MOVE[next];
+                        if (!CELL_VISITED(br + DIR_DR[e], bc + DIR_DC[e])) {
+                            nr = br;
+                            nc = bc;
+                            break;
+                        }
+                    }
+                }
+                if (nr < 0) break;  // no move increases coverage
+            }
+        }
+        cr = nr;
+        cc = nc;
+        if (!CELL_VISITED(cr, cc)) {
+            size_t i = (size_t)cr * g->cols + cc;
+            visited[i >> 6] |= (uint64_t)1 << (i & 63);
+            res->unique_count++;
+        }
+        res->path_r[res->length] = cr;
+        res->path_c[res->length] = cc;
+        res->length++;
+    }
+#undef CELL_VISITED
+}
+
+// ---------------------------------------------------------------------------
+// Upper bounds on achievable coverage.
+//
+// All bounds are about the component of the start cell, explored once with a
+// BFS over the neighbor masks:
+//  - budget: a walk of movement_points moves stands on movement_points + 1 cells;
+//  - parity: the grid is bipartite, so the walk alternates checkerboard colors
+//    and can cover at most half its positions (rounded by the start color) of each;
+//  - dead ends: entering a cell with a single free neighbor, other than the start,
+//    forces a step back onto that neighbor unless the walk ends there.
+// On weighted grids the bounds are on collected weight instead: the component's
+// total, the heaviest movement_points + 1 cells, and the heaviest cells of each
+// color in the counts the parity argument allows.
+// A solver that reaches the bound has an optimal coverage and can stop.
+// ---------------------------------------------------------------------------
+
+// Sum of the heaviest count cells in one weight histogram, or in two together
+static long heaviest_weights(const uint32_t *hist, const uint32_t *other, long count) {
+    long sum = 0;
+    for (long w = UINT16_MAX; w > 0 && count > 0; w--) {
+        long cells = (long)hist[w] + (other ? other[w] : 0);
+        long take = cells < count ? cells : count;
+        sum += take * w;
+        count -= take;
+    }
+    return sum;
+}
+
+// Budget-independent part of the bound: a census of the start component
+typedef struct {
+    uint64_t hash, weight_hash;  // grid contents it was taken from
+    int start_r, start_c;        // -1 if every cell is blocked
+    long cells;                  // free cells reachable from the start
+    long color_count[2], dead_ends, total_weight;
+    uint32_t *hist[2];           // weight histograms per color, weighted grids only
+} ComponentCensus;
+
+static void free_component_census(ComponentCensus *cs) {
+    free(cs->hist[0]);
+    free(cs->hist[1]);
+    memset(cs, 0, sizeof(*cs));
+    cs->start_r = cs->start_c = -1;
+}
+
+static void take_component_census(const Grid *g, ComponentCensus *cs) {
+    free_component_census(cs);
+    cs->hash = g->hash;
+    cs->weight_hash = g->weight_hash;
+    int sr, sc;
+    if (!find_start_cell(g, &sr, &sc)) return;
+    cs->start_r = sr;
+    cs->start_c = sc;
+    size_t cells = (size_t)g->rows * g->cols;
+    uint64_t *seen = (uint64_t*)calloc((cells >> 6) + 1, sizeof(uint64_t));
+    int *queue_r = (int*)malloc(cells * sizeof(int));
+    int *queue_c = (int*)malloc(cells * sizeof(int));
+    if (!seen || !queue_r || !queue_c) {
+        fprintf(stderr, "Memory allocation failed for coverage bound\n");
+        exit(1);
+    }
+    if (g->weight) {
+        cs->hist[0] = (uint32_t*)calloc((size_t)UINT16_MAX + 1, sizeof(uint32_t));
+        cs->hist[1] = (uint32_t*)calloc((size_t)UINT16_MAX + 1, sizeof(uint32_t));
+        if (!cs->hist[0] || !cs->hist[1]) {
+            fprintf(stderr, "Memory allocation failed for coverage bound\n");
+            exit(1);
+        }
+    }
+    size_t head = 0, tail = 0;
+    size_t start = (size_t)sr * g->cols + sc;
+    seen[start >> 6] |= (uint64_t)1 << (start & 63);
+    queue_r[tail] = sr;
+    queue_c[tail++] = sc;
+    while (head < tail) {
+        int r = queue_r[head], c = queue_c[head++];
+        unsigned m = grid_neighbor_mask(g, r, c);
+        cs->color_count[(r + c) & 1]++;
+        if (g->weight) {
+            unsigned w = g->weight[(size_t)r * g->cols + c];
+            cs->hist[(r + c) & 1][w]++;
+            cs->total_weight += w;
+        }
+        if (__builtin_popcount(m) == 1 && !(r == sr && c == sc)) cs->dead_ends++;
+        for (; m; m &= m - 1) {
+            int d = FIRST_MOVE[m];
+            int nr = r + DIR_DR[d], nc = c + DIR_DC[d];
+            size_t i = (size_t)nr * g->cols + nc;
+            if (seen[i >> 6] >> (i & 63) & 1) continue;
+            seen[i >> 6] |= (uint64_t)1 << (i & 63);
+            queue_r[tail] = nr;
+            queue_c[tail++] = nc;
+        }
+    }
+    free(seen);
+    free(queue_r);
+    free(queue_c);
+    cs->cells = (long)tail;
+}
+
+static CoverageBound census_bound(const ComponentCensus *cs, int movement_points) {
+    CoverageBound b = {0, 0, 0, 0, 0};
+    if (cs->start_r < 0) return b;
+    long moves = movement_points < 0 ? 0 : movement_points;
+    b.component = cs->cells;
+    b.budget = moves + 1;
+    // Positions 0, 2, 4, ... share the start color
+    int start_color = (cs->start_r + cs->start_c) & 1;
+    long same = moves / 2 + 1, other = (moves + 1) / 2;
+    long own = cs->color_count[start_color], opposite = cs->color_count[start_color ^ 1];
+    b.parity = (own < same ? own : same) + (opposite < other ? opposite : other);
+    if (cs->hist[0]) {
+        b.component = b.dead_end = cs->total_weight;
+        b.budget = heaviest_weights(cs->hist[0], cs->hist[1], b.budget);
+        b.parity = heaviest_weights(cs->hist[start_color], NULL, same) +
+                   heaviest_weights(cs->hist[start_color ^ 1], NULL, other);
+        b.best = b.component;
+        if (b.budget < b.best) b.best = b.budget;
+        if (b.parity < b.best) b.best = b.parity;
+        return b;
+    }
+    // Covering k dead ends wastes k - 1 positions: best k balances (component - D + k)
+    // against (budget - k + 1)
+    long core = b.component - cs->dead_ends;
+    long best_dead = core < b.budget ? core : b.budget;  // k = 0
+    long k = (b.budget + 1 - core) / 2;
+    for (long kk = k; kk <= k + 1; kk++) {
+        long kc = kk < 1 ? 1 : kk > cs->dead_ends ? cs->dead_ends : kk;
+        if (kc < 1) continue;
+        long a = core + kc, z = b.budget - kc + 1;
+        long v = a < z ? a : z;
+        if (v > best_dead) best_dead = v;
+    }
+    b.dead_end = best_dead;
+    b.best = b.component;
+    if (b.budget < b.best) b.best = b.budget;
+    if (b.parity < b.best) b.best = b.parity;
+    if (b.dead_end < b.best) b.best = b.dead_end;
+    return b;
+}
+
+CoverageBound coverage_upper_bound(const Grid *g, int movement_points) {
+    ComponentCensus cs = {0};
+    take_component_census(g, &cs);
+    CoverageBound b = census_bound(&cs, movement_points);
+    free_component_census(&cs);
+    return b;
+}
+
+// ---------------------------------------------------------------------------
+// Tile tour planning.
+//
+// The grid is cut into TOUR_TILE x TOUR_TILE tiles. Tiles holding cells of the
+// start component are ordered by a nearest-neighbor tour over their centroids,
+// improved with windowed 2-opt and Or-opt passes, so planning work stays linear
+// in the number of tiles. The walk then covers each tile with local greedy moves
+// and short BFS hops, and reaches the next tile by a BFS transit.
+// ---------------------------------------------------------------------------
+
+#define TOUR_TILE 16
+#define TOUR_WINDOW 32  // tour positions examined by each 2-opt / Or-opt move
+#define TOUR_PASSES 4
+
+typedef struct {
+    int r, c;      // centroid of the tile's reachable free cells
+    int tr, tc;    // tile coordinates
+} TourTile;
+
+static inline int tour_dist(const TourTile *t, int a, int b) {
+    return abs(t[a].r - t[b].r) + abs(t[a].c - t[b].c);
+}
+
+// Nearest unvisited tile to tile cur, searching rings of the tile grid outwards.
+// index maps tile coordinates to tile numbers (-1 for tiles without cells).
+static int tour_nearest(const TourTile *tiles, const int *index, const bool *used,
+                        int tile_rows, int tile_cols, int cur) {
+    int best = -1, best_dist = INT_MAX;
+    int max_ring = tile_rows > tile_cols ? tile_rows : tile_cols;
+    for (int ring = 1; ring <= max_ring; ring++) {
+        if (best >= 0 && (long)(ring - 1) * TOUR_TILE > best_dist) break;
+        for (int dr = -ring; dr <= ring; dr++) {
+            int tr = tiles[cur].tr + dr;
+            if (tr < 0 || tr >= tile_rows) continue;
+            int step = (dr == -ring || dr == ring) ? 1 : 2 * ring;
+            for (int dc = -ring; dc <= ring; dc += step) {
+                int tc = tiles[cur].tc + dc;
+                if (tc < 0 || tc >= tile_cols) continue;
+                int t = index[(size_t)tr * tile_cols + tc];
+                if (t < 0 || used[t]) continue;
+                int d = tour_dist(tiles, cur, t);
+                if (d < best_dist) {
+                    best_dist = d;
+                    best = t;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+// Length change of the open tour when order[i+1..j] is reversed
+static long two_opt_delta(const TourTile *tiles, const int *order, int count, int i, int j) {
+    int a = order[i], b = order[i + 1], c = order[j];
+    long delta = tour_dist(tiles, a, c) - tour_dist(tiles, a, b);
+    if (j + 1 < count) delta += tour_dist(tiles, b, order[j + 1]) - tour_dist(tiles, c, order[j + 1]);
+    return delta;
+}
+
+static void reverse_ints(int *a, int i, int j) {
+    for (; i < j; i++, j--) {
+        int t = a[i];
+        a[i] = a[j];
+        a[j] = t;
+    }
+}
+
+// Improve an open tour that starts at order[0] with windowed 2-opt and Or-opt moves
+static void improve_tour(const TourTile *tiles, int *order, int count) {
+    for (int pass = 0; pass < TOUR_PASSES; pass++) {
+        bool improved = false;
+        for (int i = 0; i + 2 < count; i++) {
+            int end = i + TOUR_WINDOW < count - 1 ? i + TOUR_WINDOW : count - 1;
+            for (int j = i + 2; j <= end; j++) {
+                if (two_opt_delta(tiles, order, count, i, j) < 0) {
+                    reverse_ints(order, i + 1, j);
+                    improved = true;
+                }
+            }
+        }
+        // Or-opt: move a segment of 1 to 3 tiles to a better spot nearby
+        for (int len = 1; len <= 3; len++) {
+            for (int i = 1; i + len <= count; i++) {
+                int s0 = order[i], s1 = order[i + len - 1], p = order[i - 1];
+                bool has_next = i + len < count;
+                int n = has_next ? order[i + len] : -1;
+                long removed = tour_dist(tiles, p, s0) +
+                               (has_next ? tour_dist(tiles, s1, n) - tour_dist(tiles, p, n) : 0);
+                int best_j = -1;
+                long best_gain = 0;
+                int lo = i - TOUR_WINDOW < 0 ? 0 : i - TOUR_WINDOW;
+                int hi = i + len + TOUR_WINDOW < count ? i + len + TOUR_WINDOW : count - 1;
+                // Insert between order[j] and order[j + 1] (or at the end), outside the segment
+                for (int j = lo; j <= hi; j++) {
+                    if (j >= i - 1 && j < i + len) continue;
+                    int a = order[j];
+                    long added = tour_dist(tiles, a, s0);
+                    if (j + 1 < count) added += tour_dist(tiles, s1, order[j + 1]) - tour_dist(tiles, a, order[j + 1]);
+                    if (removed - added > best_gain) {
+                        best_gain = removed - added;
+                        best_j = j;
+                    }
+                }
+                if (best_j < 0) continue;
+                int segment[3];
+                memcpy(segment, order + i, len * sizeof(int));
+                if (best_j > i) {
+                    memmove(order + i, order + i + len, (best_j - i - len + 1) * sizeof(int));
+                    memcpy(order + best_j - len + 1, segment, len * sizeof(int));
+                } else {
+                    memmove(order + best_j + 1 + len, order + best_j + 1, (i - best_j - 1) * sizeof(int));
+                    memcpy(order + best_j + 1, segment, len * sizeof(int));
+                }
+                improved = true;
+            }
+        }
+        if (!improved) break;
+    }
+}
+
+// Walk state of a tile tour solve
+typedef struct {
+    const Grid *g;
+    uint64_t *visited;
+    uint32_t *stamp;         // BFS generation that reached each cell
+    uint32_t generation;
+    unsigned char *from;     // direction a BFS reached each cell from
+    uint32_t *queue;
+    int cr, cc;
+    int steps_left, target;
+    PathResult *res;
+} TourWalk;
+
+static inline bool tour_visited(const TourWalk *w, int r, int c) {
+    size_t i = (size_t)r * w->g->cols + c;
+    return w->visited[i >> 6] >> (i & 63) & 1;
+}
+
+// Make one move; false once the budget or the target is used up
+static bool tour_move(TourWalk *w, int r, int c) {
+    if (w->steps_left <= 0 || w->res->unique_count >= w->target) return false;
+    w->cr = r;
+    w->cc = c;
+    size_t i = (size_t)r * w->g->cols + c;
+    if (!(w->visited[i >> 6] >> (i & 63) & 1)) {
+        w->visited[i >> 6] |= (uint64_t)1 << (i & 63);
+        w->res->unique_count++;
+    }
+    w->res->path_r[w->res->length] = r;
+    w->res->path_c[w->res->length] = c;
+    w->res->length++;
+    w->steps_left--;
+    return true;
+}
+
+// BFS from the current cell, inside rows [r0, r1) and columns [c0, c1), to the
+// nearest unvisited cell of the tile rectangle [tr0, tr1) x [tc0, tc1), then walk there.
+// Returns false if no such cell is reachable inside the window or the budget ran out.
+static bool tour_transit(TourWalk *w, int r0, int r1, int c0, int c1, int tr0, int tr1, int tc0, int tc1) {
+    const Grid *g = w->g;
+    if (++w->generation == 0) {
+        memset(w->stamp, 0, (size_t)g->rows * g->cols * sizeof(uint32_t));
+        w->generation = 1;
+    }
+    size_t head = 0, tail = 0;
+    size_t start = (size_t)w->cr * g->cols + w->cc;
+    w->stamp[start] = w->generation;
+    w->queue[tail++] = (uint32_t)start;
+    long found = -1;
+    while (head < tail && found < 0) {
+        uint32_t u = w->queue[head++];
+        int ur = u / g->cols, uc = u % g->cols;
+        for (unsigned m = grid_neighbor_mask(g, ur, uc); m; m &= m - 1) {
+            int d = FIRST_MOVE[m];
+            int vr = ur + DIR_DR[d], vc = uc + DIR_DC[d];
+            if (vr < r0 || vr >= r1 || vc < c0 || vc >= c1) continue;
+            size_t v = (size_t)vr * g->cols + vc;
+            if (w->stamp[v] == w->generation) continue;
+            w->stamp[v] = w->generation;
+            w->from[v] = (unsigned char)d;
+            if (vr >= tr0 && vr < tr1 && vc >= tc0 && vc < tc1 && !tour_visited(w, vr, vc)) {
+                found = (long)v;
+                break;
+            }
+            w->queue[tail++] = (uint32_t)v;
+        }
+    }
+    if (found < 0) return false;
+    // Trace back into the queue buffer (free again now), then replay forwards
+    size_t len = 0;
+    for (size_t v = (size_t)found; v != start;) {
+        w->queue[len++] = (uint32_t)v;
+        int d = w->from[v];
+        v = (size_t)((long)v - DIR_DR[d] * (long)g->cols - DIR_DC[d]);
+    }
+    while (len > 0) {
+        uint32_t v = w->queue[--len];
+        if (!tour_move(w, v / g->cols, v % g->cols)) return false;
+    }
+    return true;
+}
+
+// Cover the unvisited cells of tile rectangle [tr0, tr1) x [tc0, tc1)
+static void tour_cover_tile(TourWalk *w, int tr0, int tr1, int tc0, int tc1) {
+    const Grid *g = w->g;
+    int r0 = tr0 - TOUR_TILE < 0 ? 0 : tr0 - TOUR_TILE, r1 = tr1 + TOUR_TILE > g->rows ? g->rows : tr1 + TOUR_TILE;
+    int c0 = tc0 - TOUR_TILE < 0 ? 0 : tc0 - TOUR_TILE, c1 = tc1 + TOUR_TILE > g->cols ? g->cols : tc1 + TOUR_TILE;
+    for (;;) {
+        unsigned avail = 0;
+        for (unsigned m = grid_neighbor_mask(g, w->cr, w->cc); m; m &= m - 1) {
+            int d = FIRST_MOVE[m];
+            int r = w->cr + DIR_DR[d], c = w->cc + DIR_DC[d];
+            if (r >= tr0 && r < tr1 && c >= tc0 && c < tc1 && !tour_visited(w, r, c)) avail |= 1u << d;
+        }
+        if (avail) {
+            int d = FIRST_MOVE[avail];
+            if (!tour_move(w, w->cr + DIR_DR[d], w->cc + DIR_DC[d])) return;
+        } else if (!tour_transit(w, r0, r1, c0, c1, tr0, tr1, tc0, tc1)) {
+            return;
+        }
+    }
+}
+
+// Start a walk at the start cell of g; false if every cell is blocked
+static bool tour_walk_init(TourWalk *w, const Grid *g, int movement_points, int target,
+                           SolveContext *ctx, PathResult *res) {
+    if (movement_points < 0) movement_points = 0;
+    path_result_reserve(res, movement_points + 1);
+    res->length = res->unique_count = 0;
+    res->weight = res->upper_bound = 0;
+    int sr, sc;
+    if (!find_start_cell(g, &sr, &sc)) return false;
+    size_t n = (size_t)g->rows * g->cols;
+    TourWalk init = {g, NULL, NULL, 0, NULL, NULL, sr, sc, movement_points, target, res};
+    *w = init;
+    w->visited = (uint64_t*)context_scratch(ctx, ((n >> 6) + 1) * sizeof(uint64_t));
+    w->stamp = (uint32_t*)calloc(n, sizeof(uint32_t));
+    w->from = (unsigned char*)malloc(n);
+    w->queue = (uint32_t*)malloc(n * sizeof(uint32_t));
+    if (!w->stamp || !w->from || !w->queue) {
+        fprintf(stderr, "Memory allocation failed for tour walk\n");
+        exit(1);
+    }
+    size_t start = (size_t)sr * g->cols + sc;
+    w->visited[start >> 6] |= (uint64_t)1 << (start & 63);
+    res->path_r[0] = sr;
+    res->path_c[0] = sc;
+    res->length = res->unique_count = 1;
+    return true;
+}
+
+static void tour_walk_free(TourWalk *w) {
+    free(w->stamp);
+    free(w->from);
+    free(w->queue);
+}
+
+// List the start component in w->queue (BFS generation 1); returns its size.
+// The list is overwritten by the next tour_transit.
+static size_t tour_flood(TourWalk *w) {
+    const Grid *g = w->g;
+    w->generation = 1;
+    size_t head = 0, tail = 0, start = (size_t)w->cr * g->cols + w->cc;
+    w->stamp[start] = 1;
+    w->queue[tail++] = (uint32_t)start;
+    while (head < tail) {
+        uint32_t u = w->queue[head++];
+        int ur = u / g->cols, uc = u % g->cols;
+        for (unsigned m = grid_neighbor_mask(g, ur, uc); m; m &= m - 1) {
+            int d = FIRST_MOVE[m];
+            size_t v = (size_t)(ur + DIR_DR[d]) * g->cols + uc + DIR_DC[d];
+            if (w->stamp[v]) continue;
+            w->stamp[v] = 1;
+            w->queue[tail++] = (uint32_t)v;
+        }
+    }
+    return tail;
+}
+
+// Walk to cell (r, c) by the shortest path inside a margin around the current cell
+// and the target, falling back to the whole grid
+static bool tour_reach(TourWalk *w, int r, int c, int margin) {
+    const Grid *g = w->g;
+    int r0 = (w->cr < r ? w->cr : r) - margin, r1 = (w->cr > r ? w->cr : r) + 1 + margin;
+    int c0 = (w->cc < c ? w->cc : c) - margin, c1 = (w->cc > c ? w->cc : c) + 1 + margin;
+    return tour_transit(w, r0 < 0 ? 0 : r0, r1 > g->rows ? g->rows : r1, c0 < 0 ? 0 : c0,
+                        c1 > g->cols ? g->cols : c1, r, r + 1, c, c + 1) ||
+           tour_transit(w, 0, g->rows, 0, g->cols, r, r + 1, c, c + 1);
+}
+
+// Two-level coverage: order the tiles of the start component, then cover them in turn
+static void solve_tile_tour(const Grid *g, int movement_points, int target, SolveContext *ctx, PathResult *res) {
+    TourWalk w;
+    if (!tour_walk_init(&w, g, movement_points, target, ctx, res)) return;
+    int sr = w.cr, sc = w.cc;
+    int tile_rows = (g->rows + TOUR_TILE - 1) / TOUR_TILE, tile_cols = (g->cols + TOUR_TILE - 1) / TOUR_TILE;
+    size_t tile_cells = (size_t)tile_rows * tile_cols;
+    long *sum_r = (long*)calloc(tile_cells, sizeof(long));
+    long *sum_c = (long*)calloc(tile_cells, sizeof(long));
+    int *free_count = (int*)calloc(tile_cells, sizeof(int));
+    int *index = (int*)malloc(tile_cells * sizeof(int));
+    if (!sum_r || !sum_c || !free_count || !index) {
+        fprintf(stderr, "Memory allocation failed for tile tour\n");
+        exit(1);
+    }
+
+    // Gather the centroids of the start component's cells per tile
+    size_t component = tour_flood(&w);
+    for (size_t k = 0; k < component; k++) {
+        int ur = w.queue[k] / g->cols, uc = w.queue[k] % g->cols;
+        size_t t = (size_t)(ur / TOUR_TILE) * tile_cols + uc / TOUR_TILE;
+        sum_r[t] += ur;
+        sum_c[t] += uc;
+        free_count[t]++;
+    }
+    int count = 0;
+    for (size_t t = 0; t < tile_cells; t++) index[t] = free_count[t] > 0 ? count++ : -1;
+    TourTile *tiles = (TourTile*)malloc((count + 1) * sizeof(TourTile));
+    int *order = (int*)malloc((count + 1) * sizeof(int));
+    bool *used = (bool*)calloc(count + 1, sizeof(bool));
+    if (!tiles || !order || !used) {
+        fprintf(stderr, "Memory allocation failed for tile tour\n");
+        exit(1);
+    }
+    for (size_t t = 0; t < tile_cells; t++) {
+        if (index[t] < 0) continue;
+        TourTile *tile = &tiles[index[t]];
+        tile->r = (int)(sum_r[t] / free_count[t]);
+        tile->c = (int)(sum_c[t] / free_count[t]);
+        tile->tr = (int)(t / tile_cols);
+        tile->tc = (int)(t % tile_cols);
+    }
+    free(sum_r);
+    free(sum_c);
+    free(free_count);
+
+    order[0] = index[(size_t)(sr / TOUR_TILE) * tile_cols + sc / TOUR_TILE];
+    used[order[0]] = true;
+    for (int k = 1; k < count; k++) {
+        order[k] = tour_nearest(tiles, index, used, tile_rows, tile_cols, order[k - 1]);
+        used[order[k]] = true;
+    }
+    improve_tour(tiles, order, count);
+
+    for (int k = 0; k < count && w.steps_left > 0 && res->unique_count < target; k++) {
+        const TourTile *tile = &tiles[order[k]];
+        int tr0 = tile->tr * TOUR_TILE, tc0 = tile->tc * TOUR_TILE;
+        int tr1 = tr0 + TOUR_TILE > g->rows ? g->rows : tr0 + TOUR_TILE;
+        int tc1 = tc0 + TOUR_TILE > g->cols ? g->cols : tc0 + TOUR_TILE;
+        // Reach the tile through a window spanning both tiles, else through the whole grid
+        if (w.cr < tr0 || w.cr >= tr1 || w.cc < tc0 || w.cc >= tc1) {
+            int r0 = (w.cr < tr0 ? w.cr : tr0) - TOUR_TILE, r1 = (w.cr >= tr1 ? w.cr + 1 : tr1) + TOUR_TILE;
+            int c0 = (w.cc < tc0 ? w.cc : tc0) - TOUR_TILE, c1 = (w.cc >= tc1 ? w.cc + 1 : tc1) + TOUR_TILE;
+            if (!tour_transit(&w, r0 < 0 ? 0 : r0, r1 > g->rows ? g->rows : r1, c0 < 0 ? 0 : c0,
+                              c1 > g->cols ? g->cols : c1, tr0, tr1, tc0, tc1) &&
+                !tour_transit(&w, 0, g->rows, 0, g->cols, tr0, tr1, tc0, tc1)) {
+                continue;
+            }
+        }
+        tour_cover_tile(&w, tr0, tr1, tc0, tc1);
+    }
+    free(tiles);
+    free(order);
+    free(used);
+    free(index);
+    tour_walk_free(&w);
+}
+
+// ---------------------------------------------------------------------------
+// Hilbert-curve sweep.
+//
+// The free cells of the start component are visited in the order of a Hilbert
+// curve laid over the grid; cells that are not adjacent in that order are joined
+// by short BFS detours around the obstacles between them. Consecutive targets
+// are close in both dimensions, so the path (and the memory it touches) stays
+// local. Curve indices are computed HILBERT_LANES cells at a time.
+// ---------------------------------------------------------------------------
+
+// Kernels written with vector extensions are compiled for AVX-512, AVX2 and the
+// baseline ISA, and the copy the CPU supports is picked when the program loads
+// (GNU ifunc), so the default build uses the wide units where they exist. The
+// helpers such a kernel calls are always inlined so they get its ISA too, and
+// take vectors by pointer: 64-byte vector arguments would change the calling
+// convention from one copy to the next.
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SIMD_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define SIMD_CLONES
+#endif
+
+// One AVX-512 register of lanes; AVX2 and the baseline run them in two and four
+#define HILBERT_LANES 8
+#define HILBERT_DETOUR_MARGIN 8
+
+typedef uint64_t hilbertvec __attribute__((vector_size(8 * HILBERT_LANES)));
+
+// Hilbert index of (x, y) on a 2^bits square, for HILBERT_LANES points at once
+static inline __attribute__((always_inline)) void hilbert_index_vec(int bits, const hilbertvec *px,
+                                                                    const hilbertvec *py, hilbertvec *out) {
+    hilbertvec x = *px, y = *py, d = {0}, zero = {0};
+    hilbertvec full = x - x + (((uint64_t)1 << bits) - 1);
+    for (int k = bits - 1; k >= 0; k--) {
+        uint64_t s = (uint64_t)1 << k;
+        hilbertvec rx = (hilbertvec)((x & s) != zero) & 1, ry = (hilbertvec)((y & s) != zero) & 1;
+        d += (s * s) * ((3 * rx) ^ ry);
+        // Rotate the quadrant so the curve continues in the same orientation
+        hilbertvec flip = (hilbertvec)((ry == 0) & (rx == 1));
+        x = (x & ~flip) | ((full - x) & flip);
+        y = (y & ~flip) | ((full - y) & flip);
+        hilbertvec swap = (hilbertvec)(ry == 0);
+        hilbertvec t = (x & ~swap) | (y & swap);
+        y = (y & ~swap) | (x & swap);
+        x = t;
+    }
+    *out = d;
+}
+
+// Hilbert indices of cells (cell / cols, cell % cols), with x = column and y = row
+SIMD_CLONES static void hilbert_indices(int bits, int cols, const uint32_t *cells, size_t count, uint64_t *out) {
+    for (size_t i = 0; i < count; i += HILBERT_LANES) {
+        hilbertvec x = {0}, y = {0};
+        size_t lanes = count - i < HILBERT_LANES ? count - i : HILBERT_LANES;
+        for (size_t l = 0; l < lanes; l++) {
+            x[l] = cells[i + l] % cols;
+            y[l] = cells[i + l] / cols;
+        }
+        hilbertvec d;
+        hilbert_index_vec(bits, &x, &y, &d);
+        for (size_t l = 0; l < lanes; l++) out[i + l] = d[l];
+    }
+}
+
+// Sort cells by key with an LSD radix sort over the key bytes in use
+static void radix_sort_cells(uint64_t *keys, uint32_t *cells, size_t count, int key_bits) {
+    uint64_t *tmp_keys = (uint64_t*)malloc((count + 1) * sizeof(uint64_t));
+    uint32_t *tmp_cells = (uint32_t*)malloc((count + 1) * sizeof(uint32_t));
+    if (!tmp_keys || !tmp_cells) {
+        fprintf(stderr, "Memory allocation failed for radix sort\n");
+        exit(1);
+    }
+    for (int shift = 0; shift < key_bits; shift += 8) {
+        size_t bucket[257] = {0};
+        for (size_t i = 0; i < count; i++) bucket[((keys[i] >> shift) & 255) + 1]++;
+        for (int b = 0; b < 256; b++) bucket[b + 1] += bucket[b];
+        for (size_t i = 0; i < count; i++) {
+            size_t at = bucket[(keys[i] >> shift) & 255]++;
+            tmp_keys[at] = keys[i];
+            tmp_cells[at] = cells[i];
+        }
+        memcpy(keys, tmp_keys, count * sizeof(uint64_t));
+        memcpy(cells, tmp_cells, count * sizeof(uint32_t));
+    }
+    free(tmp_keys);
+    free(tmp_cells);
+}
+
+// Visit the start component in Hilbert-curve order, detouring around obstacles
+static void solve_hilbert_sweep(const Grid *g, int movement_points, int target, SolveContext *ctx, PathResult *res) {
+    TourWalk w;
+    if (!tour_walk_init(&w, g, movement_points, target, ctx, res)) return;
+    size_t count = tour_flood(&w);
+    uint32_t *cells = (uint32_t*)malloc((count + 1) * sizeof(uint32_t));
+    uint64_t *keys = (uint64_t*)malloc((count + 1) * sizeof(uint64_t));
+    if (!cells || !keys) {
+        fprintf(stderr, "Memory allocation failed for Hilbert sweep\n");
+        exit(1);
+    }
+    memcpy(cells, w.queue, count * sizeof(uint32_t));
+    int bits = 0;
+    while ((1L << bits) < g->rows || (1L << bits) < g->cols) bits++;
+    hilbert_indices(bits, g->cols, cells, count, keys);
+    radix_sort_cells(keys, cells, count, 2 * bits);
+    free(keys);
+
+    for (size_t k = 0; k < count && w.steps_left > 0 && res->unique_count < target; k++) {
+        int r = cells[k] / g->cols, c = cells[k] % g->cols;
+        if (tour_visited(&w, r, c)) continue;
+        if (abs(r - w.cr) + abs(c - w.cc) == 1) tour_move(&w, r, c);
+        else tour_reach(&w, r, c, HILBERT_DETOUR_MARGIN);
+    }
+    free(cells);
+    tour_walk_free(&w);
+}
+
+// ---------------------------------------------------------------------------
+// Run-length interval representation.
+//
+// Each row's free cells are stored as sorted, disjoint column ranges. Corridor
+// and hall maps have only a handful of ranges per row, so sweeps that work on
+// ranges cost O(number of obstacle edges) instead of O(cells). Every grid keeps
+// its intervals: refresh_grid builds them with the blocked pyramid, a mutation
+// drops them and grid_intervals rebuilds them on next use.
+// ---------------------------------------------------------------------------
+
+struct IntervalGrid {
+    int rows, cols;
+    int *row_start;    // intervals of row r are indices [row_start[r], row_start[r + 1])
+    int *start, *end;  // free columns [start[i], end[i]) of interval i
+    int count;
+};
+
+// First column >= c of row r whose bit equals value, or p->cols. Aligned blocks
+// of any level that hold only the other value are skipped in one step, so a
+// uniform span costs O(levels) rather than one check per cell.
+static int pyramid_row_find(const BitPyramid *p, int r, int c, bool value) {
+    int skip_state = value ? BLOCK_EMPTY : BLOCK_FULL;
+    while (c < p->cols) {
+        int k = 0;
+        while (k + 1 < p->levels && (c & ((8 << (k + 1)) - 1)) == 0 &&
+               pyramid_block_state(p, k + 1, r >> (4 + k), c >> (4 + k)) == skip_state) {
+            k++;
+        }
+        if (k > 0) {
+            c += 8 << k;
+            continue;
+        }
+        unsigned row = (unsigned)(p->leaf[(size_t)(r >> 3) * p->level_cols[0] + (c >> 3)] >> ((r & 7) << 3)) & 0xFFu;
+        unsigned hits = (value ? row : ~row & 0xFFu) >> (c & 7) << (c & 7);
+        if (hits) {
+            c = (c & ~7) + __builtin_ctz(hits);
+            break;
+        }
+        c = (c & ~7) + 8;
+    }
+    return c < p->cols ? c : p->cols;
+}
+
+// First column >= c of row r of g whose blocked state equals value, or g->cols
+static int grid_row_find(const Grid *g, int r, int c, bool value) {
+    if (g->blocked_pyramid) return pyramid_row_find(g->blocked_pyramid, r, c, value);
+    const bool *row = g->blocked[r];
+    while (c < g->cols && row[c] != value) c++;
+    return c;
+}
+
+// Build the free intervals of g in one pass over the rows, jumping from one
+// obstacle edge to the next through the blocked pyramid when g has one
+IntervalGrid *create_interval_grid(const Grid *g) {
+    IntervalGrid *ig = (IntervalGrid*)calloc(1, sizeof(IntervalGrid));
+    int capacity = g->rows + 16;
+    if (ig) {
+        ig->row_start = (int*)malloc((g->rows + 1) * sizeof(int));
+        ig->start = (int*)malloc(capacity * sizeof(int));
+        ig->end = (int*)malloc(capacity * sizeof(int));
+    }
+    if (!ig || !ig->row_start || !ig->start || !ig->end) {
+        fprintf(stderr, "Memory allocation failed for IntervalGrid\n");
+        exit(1);
+    }
+    ig->rows = g->rows;
+    ig->cols = g->cols;
+    for (int r = 0; r < g->rows; r++) {
+        ig->row_start[r] = ig->count;
+        int c = 0;
+        while ((c = grid_row_find(g, r, c, false)) < g->cols) {
+            int s = c;
+            c = grid_row_find(g, r, c, true);
+            if (ig->count == capacity) {
+                capacity *= 2;
+                ig->start = (int*)realloc(ig->start, capacity * sizeof(int));
+                ig->end = (int*)realloc(ig->end, capacity * sizeof(int));
+                if (!ig->start || !ig->end) {
+                    fprintf(stderr, "Memory allocation failed for %d intervals\n", capacity);
+                    exit(1);
+                }
+            }
+            ig->start[ig->count] = s;
+            ig->end[ig->count] = c;
+            ig->count++;
+        }
+    }
+    ig->row_start[g->rows] = ig->count;
+    return ig;
+}
+
+void free_interval_grid(IntervalGrid *ig) {
+    if (!ig) return;
+    free(ig->row_start);
+    free(ig->start);
+    free(ig->end);
+    free(ig);
+}
+
+// The intervals cached on g, rebuilt on first use after a mutation dropped them.
+// Filled through a const grid like the analysis cache (see grid_cached_analysis).
+static const IntervalGrid *grid_cached_intervals(const Grid *g) {
+    IntervalGrid **slot = (IntervalGrid**)&g->intervals;
+    IntervalGrid *ig = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (ig) return ig;
+    IntervalGrid *built = create_interval_grid(g);
+    if (__atomic_compare_exchange_n(slot, &ig, built, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) return built;
+    free_interval_grid(built);
+    return ig;
+}
+
+// The grid's row intervals, kept by refresh_grid and rebuilt after mutations
+const IntervalGrid *grid_intervals(Grid *g) {
+    return grid_cached_intervals(g);
+}
+
+long interval_free_count(const IntervalGrid *ig) {
+    long n = 0;
+    for (int i = 0; i < ig->count; i++) n += ig->end[i] - ig->start[i];
+    return n;
+}
+
+// Interval of row r containing column c, or -1 if (r, c) is blocked
+int interval_at(const IntervalGrid *ig, int r, int c) {
+    int lo = ig->row_start[r], hi = ig->row_start[r + 1] - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (c < ig->start[mid]) hi = mid - 1;
+        else if (c >= ig->end[mid]) lo = mid + 1;
+        else return mid;
+    }
+    return -1;
+}
+
+static int union_find_root(int *parent, int x) {
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+// Run the statements for every pair of 4-connected intervals a (row r) and b (row r + 1),
+// merging the two sorted rows in linear time
+#define FOR_EACH_OVERLAP(ig, r, a, b, ...) do { \
+    int a = (ig)->row_start[r], b = (ig)->row_start[(r) + 1]; \
+    int a_end_ = (ig)->row_start[(r) + 1], b_end_ = (ig)->row_start[(r) + 2]; \
+    while (a < a_end_ && b < b_end_) { \
+        if ((ig)->start[a] < (ig)->end[b] && (ig)->start[b] < (ig)->end[a]) { __VA_ARGS__ } \
+        if ((ig)->end[a] < (ig)->end[b]) a++; else b++; \
+    } \
+} while (0)
+
+// Label the 4-connected components of the free cells. labels[i] receives the
+// component (0 .. count-1, numbered in row-major order of first appearance) of
+// interval i; sizes, if not NULL, must hold ig->count entries and receives the
+// cell count of each component. Returns the number of components.
+int interval_label_components(const IntervalGrid *ig, int *labels, long *sizes) {
+    int *parent = (int*)malloc((ig->count + 1) * sizeof(int));
+    if (!parent) {
+        fprintf(stderr, "Memory allocation failed for component labelling\n");
+        exit(1);
+    }
+    for (int i = 0; i < ig->count; i++) parent[i] = i;
+    for (int r = 0; r + 1 < ig->rows; r++) {
+        FOR_EACH_OVERLAP(ig, r, a, b, {
+            int ra = union_find_root(parent, a), rb = union_find_root(parent, b);
+            if (ra != rb) parent[ra > rb ? ra : rb] = ra < rb ? ra : rb;
+        });
+    }
+    // Roots are the lowest interval of each component, so this numbers them in row-major order
+    int components = 0;
+    for (int i = 0; i < ig->count; i++) {
+        int root = union_find_root(parent, i);
+        if (root == i) {
+            labels[i] = components;
+            if (sizes) sizes[components] = 0;
+            components++;
+        } else {
+            labels[i] = labels[root];
+        }
+        if (sizes) sizes[labels[i]] += ig->end[i] - ig->start[i];
+    }
+    free(parent);
+    return components;
+}
+
+// Boustrophedon decomposition: group intervals into sweep cells, each a stack of
+// intervals on consecutive rows where every interval overlaps exactly one interval
+// on the next row and vice versa. A sweep cell can be covered by a single
+// back-and-forth sweep; splits and merges around obstacles start new cells.
+// cell_of[i] receives the sweep cell of interval i. Returns the number of cells.
+int interval_sweep_cells(const IntervalGrid *ig, int *cell_of) {
+    int *down = (int*)malloc((ig->count + 1) * sizeof(int));   // overlaps on the next row
+    int *up = (int*)calloc(ig->count + 1, sizeof(int));        // overlaps on the previous row
+    int *below = (int*)malloc((ig->count + 1) * sizeof(int));  // last overlapping interval below
+    if (!down || !up || !below) {
+        fprintf(stderr, "Memory allocation failed for sweep decomposition\n");
+        exit(1);
+    }
+    for (int i = 0; i < ig->count; i++) down[i] = 0;
+    for (int r = 0; r + 1 < ig->rows; r++) {
+        FOR_EACH_OVERLAP(ig, r, a, b, {
+            down[a]++;
+            up[b]++;
+            below[a] = b;
+        });
+    }
+    int cells = 0;
+    for (int i = 0; i < ig->count; i++) cell_of[i] = -1;
+    for (int i = 0; i < ig->count; i++) {
+        if (cell_of[i] < 0) cell_of[i] = cells++;
+        // Continue the cell downwards through one-to-one overlaps
+        if (down[i] == 1 && up[below[i]] == 1) cell_of[below[i]] = cell_of[i];
+    }
+    free(down);
+    free(up);
+    free(below);
+    return cells;
+}
+
+#define SWEEP_DETOUR_MARGIN 8
+
+// Row of interval i
+static int interval_row(const IntervalGrid *ig, int i) {
+    int lo = 0, hi = ig->rows - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (ig->row_start[mid] <= i) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+// Boustrophedon coverage planned on intervals: the sweep cells of the start
+// component are ordered by a depth-first walk over their adjacency (cells whose
+// intervals overlap across a row boundary), and each cell is swept back and forth
+// row by row from the end nearer the walker. Planning costs O(intervals), not
+// O(cells); targets that are not adjacent to the walker (the next row of a cell,
+// the next cell) are joined by BFS detours as in the Hilbert sweep.
+static void solve_interval_sweep(const Grid *g, int movement_points, int target, SolveContext *ctx, PathResult *res) {
+    TourWalk w;
+    if (!tour_walk_init(&w, g, movement_points, target, ctx, res)) return;
+    const IntervalGrid *ig = grid_cached_intervals(g);
+    int n = ig->count;
+    int *cell_of = (int*)malloc((n + 1) * sizeof(int));
+    int *members = (int*)malloc((n + 1) * sizeof(int));
+    if (!cell_of || !members) {
+        fprintf(stderr, "Memory allocation failed for interval sweep\n");
+        exit(1);
+    }
+    int cells = interval_sweep_cells(ig, cell_of);
+    // Intervals of each sweep cell in row order, and the cell adjacency, in CSR form
+    int *cell_start = (int*)calloc(cells + 2, sizeof(int));
+    int *adj_start = (int*)calloc(cells + 2, sizeof(int));
+    int *order = (int*)malloc((cells + 1) * sizeof(int));
+    int *stack = (int*)malloc((cells + 1) * sizeof(int));
+    int *next_edge = (int*)malloc((cells + 1) * sizeof(int));
+    bool *seen = (bool*)calloc(cells + 1, sizeof(bool));
+    if (!cell_start || !adj_start || !order || !stack || !next_edge || !seen) {
+        fprintf(stderr, "Memory allocation failed for interval sweep\n");
+        exit(1);
+    }
+    for (int i = 0; i < n; i++) cell_start[cell_of[i] + 2]++;
+    for (int k = 0; k < cells; k++) cell_start[k + 2] += cell_start[k + 1];
+    for (int i = 0; i < n; i++) members[cell_start[cell_of[i] + 1]++] = i;
+    for (int r = 0; r + 1 < ig->rows; r++) {
+        FOR_EACH_OVERLAP(ig, r, a, b, {
+            if (cell_of[a] != cell_of[b]) {
+                adj_start[cell_of[a] + 2]++;
+                adj_start[cell_of[b] + 2]++;
+            }
+        });
+    }
+    for (int k = 0; k < cells; k++) adj_start[k + 2] += adj_start[k + 1];
+    int *adj = (int*)malloc((adj_start[cells + 1] + 1) * sizeof(int));
+    if (!adj) {
+        fprintf(stderr, "Memory allocation failed for interval sweep\n");
+        exit(1);
+    }
+    for (int r = 0; r + 1 < ig->rows; r++) {
+        FOR_EACH_OVERLAP(ig, r, a, b, {
+            if (cell_of[a] != cell_of[b]) {
+                adj[adj_start[cell_of[a] + 1]++] = cell_of[b];
+                adj[adj_start[cell_of[b] + 1]++] = cell_of[a];
+            }
+        });
+    }
+
+    // Depth-first order of the cells reachable from the start's cell
+    int count = 0, top = 0;
+    stack[0] = cell_of[interval_at(ig, w.cr, w.cc)];
+    next_edge[0] = adj_start[stack[0]];
+    seen[stack[0]] = true;
+    order[count++] = stack[0];
+    while (top >= 0) {
+        int u = stack[top];
+        if (next_edge[top] == adj_start[u + 1]) {
+            top--;
+            continue;
+        }
+        int v = adj[next_edge[top]++];
+        if (seen[v]) continue;
+        seen[v] = true;
+        order[count++] = v;
+        stack[++top] = v;
+        next_edge[top] = adj_start[v];
+    }
+
+    for (int k = 0; k < count && w.steps_left > 0 && res->unique_count < target; k++) {
+        const int *iv = members + cell_start[order[k]];
+        int height = cell_start[order[k] + 1] - cell_start[order[k]];
+        int top_row = interval_row(ig, iv[0]);
+        // Enter at the nearer of the top and bottom rows, at the nearer end of that row
+        int first = iv[0], last = iv[height - 1];
+        int d_top = abs(top_row - w.cr) + (abs(ig->start[first] - w.cc) < abs(ig->end[first] - 1 - w.cc)
+                                               ? abs(ig->start[first] - w.cc) : abs(ig->end[first] - 1 - w.cc));
+        int d_bottom = abs(top_row + height - 1 - w.cr) + (abs(ig->start[last] - w.cc) < abs(ig->end[last] - 1 - w.cc)
+                                                              ? abs(ig->start[last] - w.cc) : abs(ig->end[last] - 1 - w.cc));
+        bool downwards = d_top <= d_bottom;
+        int entry = downwards ? first : last;
+        bool rightwards = abs(ig->start[entry] - w.cc) <= abs(ig->end[entry] - 1 - w.cc);
+        for (int j = 0; j < height && w.steps_left > 0 && res->unique_count < target; j++) {
+            int row_index = downwards ? j : height - 1 - j;
+            int i = iv[row_index], r = top_row + row_index;
+            int c0 = ig->start[i], c1 = ig->end[i] - 1;
+            for (int c = rightwards ? c0 : c1; c >= c0 && c <= c1; c += rightwards ? 1 : -1) {
+                if (tour_visited(&w, r, c)) continue;
+                if (w.steps_left <= 0 || res->unique_count >= target) break;
+                if (abs(r - w.cr) + abs(c - w.cc) == 1) tour_move(&w, r, c);
+                else tour_reach(&w, r, c, SWEEP_DETOUR_MARGIN);
+            }
+            rightwards = !rightwards;
+        }
+    }
+    free(cell_of);
+    free(members);
+    free(cell_start);
+    free(adj_start);
+    free(adj);
+    free(order);
+    free(stack);
+    free(next_edge);
+    free(seen);
+    tour_walk_free(&w);
+}
+
+// ---------------------------------------------------------------------------
+// Local-search refinement with parallel restarts.
+//
+// Each restart owns a copy of the path and a per-cell visit count, so a move is
+// scored by updating the counts of the cells it adds or removes: O(segment
+// length), independent of the path length. The path is a flat array, so applying
+// an accepted move shifts the tail with one memmove and a new best is copied
+// whole: accepted moves cost O(path), rejected ones (most of them) only their
+// scoring. Moves:
+//  - loop removal: drop p[i+1..j] when p[j] == p[i] and every dropped cell is
+//    visited elsewhere, freeing j - i moves;
+//  - detour insertion: p[i] -> u -> p[i] for an unvisited neighbor u, paid for
+//    by the last two moves when the budget is spent, if no weight is lost;
+//  - segment reversal: reverse p[i..j] where the ends still connect, a neutral
+//    move that opens new loops;
+//  - tail extension: spend free moves on a BFS walk to the nearest unvisited cell.
+// Restarts run in threads with their own xorshift generators; restart 0 refines
+// the seed as given, the others first cut its tail at a random point.
+// ---------------------------------------------------------------------------
+
+#define REFINE_WINDOW 64     // positions scanned for the partner of a loop or reversal
+#define REFINE_THREADS 4     // restarts when RefineOptions.threads is 0
+#define REFINE_ITERATIONS 200000  // moves per restart for STRATEGY_REFINE
+
+typedef struct {
+    const Grid *g;
+    int movement_points;
+    long iterations;
+    uint64_t rng;
+    long target;
+    _Atomic long *best_shared;     // best weight over all restarts, for early stop
+    const uint32_t *seed_path;
+    int seed_length;
+    bool perturb;
+    // Working state
+    uint32_t *path;                // cells r * cols + c
+    int length;
+    uint32_t *count;               // visits per cell
+    int unique;
+    long collected;                // weight of the visited cells
+    uint32_t *stamp, generation;   // depth-limited BFS of tail extensions
+    uint32_t *queue;
+    unsigned char *from;
+    // Best path seen
+    uint32_t *best_path;
+    int best_length, best_unique;
+    long best_collected;
+} RefineWorker;
+
+static inline uint64_t xorshift64(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+static inline long refine_weight(const RefineWorker *w, uint32_t cell) {
+    return w->g->weight ? w->g->weight[cell] : 1;
+}
+
+static inline void refine_add(RefineWorker *w, uint32_t cell) {
+    if (w->count[cell]++ == 0) {
+        w->unique++;
+        w->collected += refine_weight(w, cell);
+    }
+}
+
+static inline void refine_remove(RefineWorker *w, uint32_t cell) {
+    if (--w->count[cell] == 0) {
+        w->unique--;
+        w->collected -= refine_weight(w, cell);
+    }
+}
+
+static inline bool refine_adjacent(const RefineWorker *w, uint32_t a, uint32_t b) {
+    int cols = w->g->cols;
+    int ar = a / cols, ac = a % cols, br = b / cols, bc = b % cols;
+    return abs(ar - br) + abs(ac - bc) == 1;
+}
+
+static void refine_keep_best(RefineWorker *w) {
+    if (w->collected < w->best_collected || (w->collected == w->best_collected && w->length >= w->best_length)) return;
+    memcpy(w->best_path, w->path, w->length * sizeof(uint32_t));
+    w->best_length = w->length;
+    w->best_unique = w->unique;
+    w->best_collected = w->collected;
+    long shared = atomic_load(w->best_shared);
+    while (w->collected > shared && !atomic_compare_exchange_weak(w->best_shared, &shared, w->collected)) {}
+}
+
+// Spend free moves walking from the path's end to the nearest unvisited cells of positive weight.
+// Neighbor order is randomized so restarts explore different extensions.
+static void refine_extend(RefineWorker *w) {
+    const Grid *g = w->g;
+    while (w->length < w->movement_points + 1) {
+        int spare = w->movement_points + 1 - w->length;
+        uint32_t start = w->path[w->length - 1];
+        if (++w->generation == 0) {
+            memset(w->stamp, 0, (size_t)g->rows * g->cols * sizeof(uint32_t));
+            w->generation = 1;
+        }
+        size_t head = 0, tail = 0, level_end = 1;
+        int depth = 0;
+        long found = -1;
+        w->stamp[start] = w->generation;
+        w->queue[tail++] = start;
+        unsigned rot = (unsigned)(xorshift64(&w->rng) & 3);
+        while (head < tail && found < 0 && depth < spare) {
+            uint32_t u = w->queue[head++];
+            int ur = u / g->cols, uc = u % g->cols;
+            unsigned m = grid_neighbor_mask(g, ur, uc);
+            for (int k = 0; k < 4 && found < 0; k++) {
+                int d = (k + rot) & 3;
+                if (!(m >> d & 1)) continue;
+                uint32_t v = (uint32_t)((ur + DIR_DR[d]) * g->cols + uc + DIR_DC[d]);
+                if (w->stamp[v] == w->generation) continue;
+                w->stamp[v] = w->generation;
+                w->from[v] = (unsigned char)d;
+                if (w->count[v] == 0 && refine_weight(w, v) > 0) found = v;
+                else w->queue[tail++] = v;
+            }
+            if (head == level_end) {
+                level_end = tail;
+                depth++;
+            }
+        }
+        if (found < 0) return;
+        size_t len = 0;
+        for (uint32_t v = (uint32_t)found; v != start;) {
+            w->queue[len++] = v;
+            int d = w->from[v];
+            v = (uint32_t)((long)v - DIR_DR[d] * (long)g->cols - DIR_DC[d]);
+        }
+        if ((int)len > spare) return;
+        while (len > 0) {
+            uint32_t v = w->queue[--len];
+            w->path[w->length++] = v;
+            refine_add(w, v);
+        }
+    }
+}
+
+// Drop p[i+1..j] for the first j in the window with p[j] == p[i], if no weight is lost
+static bool refine_remove_loop(RefineWorker *w, int i) {
+    int end = i + REFINE_WINDOW < w->length ? i + REFINE_WINDOW : w->length;
+    int j = i + 1;
+    while (j < end && w->path[j] != w->path[i]) j++;
+    if (j >= end) return false;
+    long before = w->collected;
+    for (int k = i + 1; k <= j; k++) refine_remove(w, w->path[k]);
+    if (w->collected < before) {
+        for (int k = i + 1; k <= j; k++) refine_add(w, w->path[k]);
+        return false;
+    }
+    memmove(w->path + i + 1, w->path + j + 1, (w->length - j - 1) * sizeof(uint32_t));
+    w->length -= j - i;
+    return true;
+}
+
+// Insert p[i] -> u -> p[i] for the heaviest unvisited neighbor u of p[i].
+// refine_extend keeps the budget spent, so the detour usually has to give up the
+// path's last moves; it is kept if that loses no weight.
+static bool refine_insert_detour(RefineWorker *w, int i) {
+    const Grid *g = w->g;
+    uint32_t p = w->path[i], best = p;
+    long best_weight = 0;
+    int r = p / g->cols, c = p % g->cols;
+    for (unsigned m = grid_neighbor_mask(g, r, c); m; m &= m - 1) {
+        int d = FIRST_MOVE[m];
+        uint32_t u = (uint32_t)((r + DIR_DR[d]) * g->cols + c + DIR_DC[d]);
+        if (w->count[u] == 0 && refine_weight(w, u) > best_weight) {
+            best = u;
+            best_weight = refine_weight(w, u);
+        }
+    }
+    if (best_weight == 0) return false;
+    int drop = w->length + 2 - (w->movement_points + 1);
+    if (drop < 0) drop = 0;
+    if (i >= w->length - drop) return false;  // p[i] itself would be given up
+    long before = w->collected;
+    for (int k = w->length - drop; k < w->length; k++) refine_remove(w, w->path[k]);
+    refine_add(w, best);
+    if (w->collected < before) {
+        refine_remove(w, best);
+        for (int k = w->length - drop; k < w->length; k++) refine_add(w, w->path[k]);
+        return false;
+    }
+    w->length -= drop;
+    memmove(w->path + i + 3, w->path + i + 1, (w->length - i - 1) * sizeof(uint32_t));
+    w->path[i + 1] = best;
+    w->path[i + 2] = p;
+    w->length += 2;
+    refine_add(w, p);
+    return true;
+}
+
+// Reverse p[i..j] for a j in the window whose ends reconnect
+static bool refine_reverse(RefineWorker *w, int i) {
+    if (i < 1) return false;
+    int end = i + REFINE_WINDOW < w->length ? i + REFINE_WINDOW : w->length;
+    for (int j = i + 2; j < end; j++) {
+        if (!refine_adjacent(w, w->path[i - 1], w->path[j])) continue;
+        if (j + 1 < w->length && !refine_adjacent(w, w->path[i], w->path[j + 1])) continue;
+        for (int a = i, b = j; a < b; a++, b--) {
+            uint32_t t = w->path[a];
+            w->path[a] = w->path[b];
+            w->path[b] = t;
+        }
+        return true;
+    }
+    return false;
+}
+
+static void *refine_worker_main(void *arg) {
+    RefineWorker *w = (RefineWorker*)arg;
+    w->length = w->seed_length;
+    if (w->perturb && w->seed_length > 2) {
+        w->length = w->seed_length / 2 + (int)(xorshift64(&w->rng) % (uint64_t)(w->seed_length / 2 + 1));
+    }
+    memcpy(w->path, w->seed_path, w->length * sizeof(uint32_t));
+    for (int k = 0; k < w->length; k++) refine_add(w, w->path[k]);
+    refine_extend(w);
+    refine_keep_best(w);
+    for (long it = 0; it < w->iterations && atomic_load(w->best_shared) < w->target; it++) {
+        int i = (int)(xorshift64(&w->rng) % (uint64_t)w->length);
+        bool changed;
+        switch (xorshift64(&w->rng) % 3) {
+        case 0:
+            changed = refine_remove_loop(w, i);
+            break;
+        case 1:
+            changed = refine_insert_detour(w, i);
+            break;
+        default:
+            changed = refine_reverse(w, i);
+            break;
+        }
+        if (!changed) continue;
+        refine_extend(w);
+        refine_keep_best(w);
+    }
+    return NULL;
+}
+
+// Improve the path in res (a walk from the start cell of g) by local search,
+// maximizing collected weight. res is replaced by the best path found by any
+// restart; stops early once target weight is collected.
+void refine_path(const Grid *g, int movement_points, long target, const RefineOptions *opt, PathResult *res) {
+    if (res->length == 0) return;
+    if (movement_points < 0) movement_points = 0;
+    // Workers hold movement_points + 1 cells, so a seed over the budget is cut to it
+    int seed_length = res->length < movement_points + 1 ? res->length : movement_points + 1;
+    int threads = opt && opt->threads > 0 ? opt->threads : REFINE_THREADS;
+    long iterations = opt ? opt->iterations : 0;
+    uint64_t seed = opt ? opt->seed : 0;
+    size_t n = (size_t)g->rows * g->cols;
+    uint32_t *seed_path = (uint32_t*)malloc(seed_length * sizeof(uint32_t));
+    RefineWorker *workers = (RefineWorker*)calloc(threads, sizeof(RefineWorker));
+    pthread_t *tids = (pthread_t*)malloc(threads * sizeof(pthread_t));
+    if (!seed_path || !workers || !tids) {
+        fprintf(stderr, "Memory allocation failed for path refinement\n");
+        exit(1);
+    }
+    for (int k = 0; k < seed_length; k++) seed_path[k] = (uint32_t)(res->path_r[k] * g->cols + res->path_c[k]);
+    unsigned char *seen = (unsigned char*)calloc(n, 1);
+    if (!seen) {
+        fprintf(stderr, "Memory allocation failed for path refinement\n");
+        exit(1);
+    }
+    long seed_collected = 0;
+    for (int k = 0; k < seed_length; k++) {
+        if (seen[seed_path[k]]) continue;
+        seen[seed_path[k]] = 1;
+        seed_collected += g->weight ? g->weight[seed_path[k]] : 1;
+    }
+    free(seen);
+    _Atomic long best_shared = seed_collected;
+    for (int t = 0; t < threads; t++) {
+        RefineWorker *w = &workers[t];
+        w->g = g;
+        w->movement_points = movement_points;
+        w->iterations = iterations;
+        w->rng = cell_hash(seed + (uint64_t)t) | 1;
+        w->target = target;
+        w->best_shared = &best_shared;
+        w->seed_path = seed_path;
+        w->seed_length = seed_length;
+        w->perturb = t > 0;
+        w->path = (uint32_t*)malloc(((size_t)movement_points + 1) * sizeof(uint32_t));
+        w->best_path = (uint32_t*)malloc(((size_t)movement_points + 1) * sizeof(uint32_t));
+        w->count = (uint32_t*)calloc(n, sizeof(uint32_t));
+        w->stamp = (uint32_t*)calloc(n, sizeof(uint32_t));
+        w->queue = (uint32_t*)malloc(n * sizeof(uint32_t));
+        w->from = (unsigned char*)malloc(n);
+        if (!w->path || !w->best_path || !w->count || !w->stamp || !w->queue || !w->from) {
+            fprintf(stderr, "Memory allocation failed for refinement restart %d\n", t);
+            exit(1);
+        }
+        w->best_collected = -1;
+        if (threads == 1 || pthread_create(&tids[t], NULL, refine_worker_main, w) != 0) {
+            refine_worker_main(w);
+            tids[t] = pthread_self();
+        }
+    }
+    RefineWorker *best = NULL;
+    for (int t = 0; t < threads; t++) {
+        RefineWorker *w = &workers[t];
+        if (!pthread_equal(tids[t], pthread_self())) pthread_join(tids[t], NULL);
+        if (!best || w->best_collected > best->best_collected ||
+            (w->best_collected == best->best_collected && w->best_length < best->best_length)) best = w;
+    }
+    // Restart 0 starts from the whole seed, so the best is never worse than it
+    if (best->best_collected > seed_collected || best->best_length < res->length) {
+        path_result_reserve(res, best->best_length);
+        for (int k = 0; k < best->best_length; k++) {
+            res->path_r[k] = best->best_path[k] / g->cols;
+            res->path_c[k] = best->best_path[k] % g->cols;
+        }
+        res->length = best->best_length;
+        res->unique_count = best->best_unique;
+    }
+    for (int t = 0; t < threads; t++) {
+        RefineWorker *w = &workers[t];
+        free(w->path);
+        free(w->best_path);
+        free(w->count);
+        free(w->stamp);
+        free(w->queue);
+        free(w->from);
+    }
+    free(workers);
+    free(tids);
+    free(seed_path);
+}
+
+// ---------------------------------------------------------------------------
+// Beam search over greedy decisions.
+//
+// The beam keeps the BEAM_WIDTH best partial walks and advances all of them one
+// move per step. A candidate move is ranked by the coverage it reaches, then by
+// its distance to the nearest unvisited cell, then by how few unvisited
+// neighbors it leaves behind, which favors finishing narrow spots before they
+// turn into dead ends.
+//
+// The distance comes from one BFS per member per step, cut off at
+// BEAM_LOOKAHEAD moves, so it costs O(BEAM_LOOKAHEAD^2) cells. A member with
+// nothing unvisited that close runs one full BFS, O(cells), and keeps the
+// shortest route it found; it follows that route (shared with its copies) until
+// the route ends, its target gets covered or the member steps off it. A step
+// therefore costs O(width * BEAM_LOOKAHEAD^2) plus full searches amortized over
+// routes of at least BEAM_LOOKAHEAD moves.
+//
+// Members share their visited sets copy-on-write: a set is a table of pages,
+// each page a table of 512-cell tiles, all reference counted. Copying a member
+// copies only its page table, and a move clones at most one page and one tile.
+// Paths are shared the same way, as reference-counted parent-linked moves.
+// ---------------------------------------------------------------------------
+
+#define BEAM_WIDTH 8
+#define BEAM_LOOKAHEAD 24  // radius of the per-step search for unvisited cells
+#define BEAM_TILE_CELLS 512
+#define BEAM_PAGE_TILES 64
+
+typedef struct {
+    int refs;
+    uint64_t bits[BEAM_TILE_CELLS / 64];
+} BeamTile;
+
+typedef struct {
+    int refs;
+    BeamTile *tiles[BEAM_PAGE_TILES];  // NULL tiles are all unvisited
+} BeamPage;
+
+typedef struct BeamMove {
+    uint32_t cell;
+    int refs;
+    struct BeamMove *parent;
+} BeamMove;
+
+// Shortest route from a member's cell to a distant unvisited cell
+typedef struct {
+    int refs;
+    int length;
+    uint32_t cells[];  // the cells after the start, ending at the target
+} BeamRoute;
+
+typedef struct {
+    BeamPage **pages;  // page_count entries, NULL pages are all unvisited
+    BeamMove *last;
+    BeamRoute *route;  // route being followed, NULL if none
+    int route_pos;     // index in route->cells of the next cell
+    uint32_t cell;
+    int unique;
+    long collected;    // weight of the visited cells
+    uint64_t hash;     // XOR of cell_hash over visited cells, for merging equal states
+} BeamMember;
+
+typedef struct {
+    int member;
+    int dir;
+    long collected;    // weight after the move, the primary rank
+    int heuristic;     // lookahead score, the secondary rank
+    uint64_t hash;
+} BeamCandidate;
+
+static inline bool beam_visited(const BeamMember *m, uint32_t cell) {
+    const BeamPage *page = m->pages[cell / (BEAM_TILE_CELLS * BEAM_PAGE_TILES)];
+    if (!page) return false;
+    const BeamTile *tile = page->tiles[(cell / BEAM_TILE_CELLS) % BEAM_PAGE_TILES];
+    return tile && (tile->bits[(cell % BEAM_TILE_CELLS) >> 6] >> (cell & 63) & 1);
+}
+
+static void beam_page_release(BeamPage *page) {
+    if (!page || --page->refs > 0) return;
+    for (int t = 0; t < BEAM_PAGE_TILES; t++) {
+        if (page->tiles[t] && --page->tiles[t]->refs == 0) free(page->tiles[t]);
+    }
+    free(page);
+}
+
+static void beam_move_release(BeamMove *move) {
+    while (move && --move->refs == 0) {
+        BeamMove *parent = move->parent;
+        free(move);
+        move = parent;
+    }
+}
+
+static void beam_route_release(BeamRoute *route) {
+    if (route && --route->refs == 0) free(route);
+}
+
+static void beam_member_release(BeamMember *m, size_t page_count) {
+    for (size_t p = 0; p < page_count; p++) beam_page_release(m->pages[p]);
+    free(m->pages);
+    beam_move_release(m->last);
+    beam_route_release(m->route);
+}
+
+// Mark cell visited in m, cloning the page and tile if they are shared
+static void beam_visit(BeamMember *m, uint32_t cell) {
+    size_t p = cell / (BEAM_TILE_CELLS * BEAM_PAGE_TILES);
+    int t = (cell / BEAM_TILE_CELLS) % BEAM_PAGE_TILES;
+    BeamPage *page = m->pages[p];
+    if (!page || page->refs > 1) {
+        BeamPage *copy = (BeamPage*)calloc(1, sizeof(BeamPage));
+        if (!copy) {
+            fprintf(stderr, "Memory allocation failed for beam page\n");
+            exit(1);
+        }
+        copy->refs = 1;
+        if (page) {
+            memcpy(copy->tiles, page->tiles, sizeof(copy->tiles));
+            for (int k = 0; k < BEAM_PAGE_TILES; k++) {
+                if (copy->tiles[k]) copy->tiles[k]->refs++;
+            }
+            beam_page_release(page);
+        }
+        m->pages[p] = page = copy;
+    }
+    BeamTile *tile = page->tiles[t];
+    if (!tile || tile->refs > 1) {
+        BeamTile *copy = (BeamTile*)calloc(1, sizeof(BeamTile));
+        if (!copy) {
+            fprintf(stderr, "Memory allocation failed for beam tile\n");
+            exit(1);
+        }
+        copy->refs = 1;
+        if (tile) {
+            memcpy(copy->bits, tile->bits, sizeof(copy->bits));
+            tile->refs--;
+        }
+        page->tiles[t] = tile = copy;
+    }
+    tile->bits[(cell % BEAM_TILE_CELLS) >> 6] |= (uint64_t)1 << (cell & 63);
+}
+
+// Member sharing src's visited set and path
+static BeamMember beam_member_share(const BeamMember *src, size_t page_count) {
+    BeamMember m = *src;
+    m.pages = (BeamPage**)malloc((page_count + 1) * sizeof(BeamPage*));
+    if (!m.pages) {
+        fprintf(stderr, "Memory allocation failed for beam member\n");
+        exit(1);
+    }
+    memcpy(m.pages, src->pages, page_count * sizeof(BeamPage*));
+    for (size_t p = 0; p < page_count; p++) {
+        if (m.pages[p]) m.pages[p]->refs++;
+    }
+    if (m.last) m.last->refs++;
+    if (m.route) m.route->refs++;
+    return m;
+}
+
+static void beam_member_move(BeamMember *m, const Grid *g, uint32_t cell) {
+    BeamMove *move = (BeamMove*)malloc(sizeof(BeamMove));
+    if (!move) {
+        fprintf(stderr, "Memory allocation failed for beam move\n");
+        exit(1);
+    }
+    move->cell = cell;
+    move->refs = 1;
+    move->parent = m->last;  // the member's reference passes to the new move
+    m->last = move;
+    m->cell = cell;
+    if (m->route) {
+        // Stay on the route only while stepping along it
+        if (m->route->cells[m->route_pos] == cell && m->route_pos + 1 < m->route->length) {
+            m->route_pos++;
+        } else {
+            beam_route_release(m->route);
+            m->route = NULL;
+        }
+    }
+    if (!beam_visited(m, cell)) {
+        beam_visit(m, cell);
+        m->unique++;
+        m->collected += grid_cell_weight(g, cell / g->cols, cell % g->cols);
+        m->hash ^= cell_hash(cell);
+    }
+}
+
+// BFS from m's cell to its nearest unvisited cell of positive weight within
+// radius moves (INT_MAX for no limit): the distance (-1 if there is none) and the
+// direction of the first step. first[v] holds the direction into v of the
+// search tree, so the route to the cell found can be traced back from it.
+static int beam_lookahead(const Grid *g, const BeamMember *m, int radius, uint32_t *stamp, uint32_t generation,
+                          uint32_t *queue, unsigned char *first, int *first_dir, uint32_t *found) {
+    size_t head = 0, tail = 0;
+    stamp[m->cell] = generation;
+    queue[tail++] = m->cell;
+    int dist = 0;
+    size_t level_end = 1;
+    while (head < tail && dist < radius) {
+        uint32_t u = queue[head++];
+        int ur = u / g->cols, uc = u % g->cols;
+        for (unsigned mask = grid_neighbor_mask(g, ur, uc); mask; mask &= mask - 1) {
+            int d = FIRST_MOVE[mask];
+            uint32_t v = (uint32_t)((ur + DIR_DR[d]) * g->cols + uc + DIR_DC[d]);
+            if (stamp[v] == generation) continue;
+            stamp[v] = generation;
+            first[v] = (unsigned char)d;
+            if (!beam_visited(m, v) && grid_cell_weight(g, v / g->cols, v % g->cols) > 0) {
+                *found = v;
+                // Walk back to the cell after the start to find the first step
+                uint32_t x = v;
+                for (;;) {
+                    uint32_t prev = (uint32_t)((long)x - DIR_DR[first[x]] * (long)g->cols - DIR_DC[first[x]]);
+                    if (prev == m->cell) break;
+                    x = prev;
+                }
+                *first_dir = first[x];
+                return dist + 1;
+            }
+            queue[tail++] = v;
+        }
+        if (head == level_end) {
+            level_end = tail;
+            dist++;
+        }
+    }
+    return -1;
+}
+
+// Route of dist moves to target, traced back through the search tree of beam_lookahead
+static BeamRoute *beam_route(const Grid *g, uint32_t target, int dist, const unsigned char *first) {
+    BeamRoute *route = (BeamRoute*)malloc(sizeof(BeamRoute) + (size_t)dist * sizeof(uint32_t));
+    if (!route) {
+        fprintf(stderr, "Memory allocation failed for beam route\n");
+        exit(1);
+    }
+    route->refs = 1;
+    route->length = dist;
+    uint32_t x = target;
+    for (int k = dist - 1; k >= 0; k--) {
+        route->cells[k] = x;
+        x = (uint32_t)((long)x - DIR_DR[first[x]] * (long)g->cols - DIR_DC[first[x]]);
+    }
+    return route;
+}
+
+// Distance and first step from m toward the nearest unvisited cell: a bounded
+// search, else the member's route, else a full search that starts a new route
+static int beam_distance(const Grid *g, BeamMember *m, uint32_t *stamp, uint32_t *generation,
+                         uint32_t *queue, unsigned char *first, int *first_dir) {
+    size_t n = (size_t)g->rows * g->cols;
+    uint32_t found;
+    if (++*generation == 0) {
+        memset(stamp, 0, n * sizeof(uint32_t));
+        *generation = 1;
+    }
+    int dist = beam_lookahead(g, m, BEAM_LOOKAHEAD, stamp, *generation, queue, first, first_dir, &found);
+    if (dist >= 0) return dist;
+    BeamRoute *route = m->route;
+    if (route && !beam_visited(m, route->cells[route->length - 1])) {
+        uint32_t next = route->cells[m->route_pos];
+        int dr = (int)(next / g->cols) - (int)(m->cell / g->cols);
+        *first_dir = dr < 0 ? 0 : dr > 0 ? 2 : next > m->cell ? 1 : 3;
+        return route->length - m->route_pos;
+    }
+    beam_route_release(route);
+    m->route = NULL;
+    if (++*generation == 0) {
+        memset(stamp, 0, n * sizeof(uint32_t));
+        *generation = 1;
+    }
+    dist = beam_lookahead(g, m, INT_MAX, stamp, *generation, queue, first, first_dir, &found);
+    if (dist < 0) return -1;
+    m->route = beam_route(g, found, dist, first);
+    m->route_pos = 0;
+    return dist;
+}
+
+static int compare_beam_candidates(const void *a, const void *b) {
+    const BeamCandidate *x = (const BeamCandidate*)a, *y = (const BeamCandidate*)b;
+    if (x->collected != y->collected) return x->collected > y->collected ? -1 : 1;
+    if (x->heuristic != y->heuristic) return x->heuristic > y->heuristic ? -1 : 1;
+    if (x->member != y->member) return x->member - y->member;
+    return x->dir - y->dir;
+}
+
+// Beam search of the given width maximizing collected weight; stops early once
+// target weight is collected
+static void solve_beam(const Grid *g, int movement_points, int width, long target, SolveContext *ctx, PathResult *res) {
+    if (movement_points < 0) movement_points = 0;
+    if (width < 1) width = 1;
+    path_result_reserve(res, movement_points + 1);
+    res->length = res->unique_count = 0;
+    res->weight = res->upper_bound = 0;
+    int sr, sc;
+    if (!find_start_cell(g, &sr, &sc)) return;
+    (void)ctx;
+    size_t n = (size_t)g->rows * g->cols;
+    size_t page_count = (n + BEAM_TILE_CELLS * BEAM_PAGE_TILES - 1) / (BEAM_TILE_CELLS * BEAM_PAGE_TILES);
+    uint32_t *stamp = (uint32_t*)calloc(n, sizeof(uint32_t));
+    uint32_t *queue = (uint32_t*)malloc(n * sizeof(uint32_t));
+    unsigned char *first = (unsigned char*)malloc(n);
+    BeamMember *beam = (BeamMember*)malloc(width * sizeof(BeamMember));
+    BeamMember *next = (BeamMember*)malloc(width * sizeof(BeamMember));
+    BeamCandidate *cands = (BeamCandidate*)malloc(4 * width * sizeof(BeamCandidate));
+    if (!stamp || !queue || !first || !beam || !next || !cands) {
+        fprintf(stderr, "Memory allocation failed for beam search\n");
+        exit(1);
+    }
+    BeamMember root = {(BeamPage**)calloc(page_count + 1, sizeof(BeamPage*)), NULL, NULL, 0, 0, 0, 0, 0};
+    if (!root.pages) {
+        fprintf(stderr, "Memory allocation failed for beam member\n");
+        exit(1);
+    }
+    beam_member_move(&root, g, (uint32_t)((size_t)sr * g->cols + sc));
+    beam[0] = root;
+    int size = 1;
+    uint32_t generation = 0;
+    for (int step = 0; step < movement_points && beam[0].collected < target; step++) {
+        int count = 0;
+        for (int i = 0; i < size; i++) {
+            BeamMember *m = &beam[i];
+            int toward = -1;
+            int dist = beam_distance(g, m, stamp, &generation, queue, first, &toward);
+            if (dist < 0) continue;  // nothing left to cover from here
+            int r = m->cell / g->cols, c = m->cell % g->cols;
+            for (unsigned mask = grid_neighbor_mask(g, r, c); mask; mask &= mask - 1) {
+                int d = FIRST_MOVE[mask];
+                int vr = r + DIR_DR[d], vc = c + DIR_DC[d];
+                uint32_t v = (uint32_t)(vr * g->cols + vc);
+                bool fresh = !beam_visited(m, v);
+                int open = 0;
+                for (unsigned around = grid_neighbor_mask(g, vr, vc); around; around &= around - 1) {
+                    int e = FIRST_MOVE[around];
+                    uint32_t w = (uint32_t)((vr + DIR_DR[e]) * g->cols + vc + DIR_DC[e]);
+                    open += w != m->cell && !beam_visited(m, w);
+                }
+                long gain = fresh ? grid_cell_weight(g, vr, vc) : 0;
+                int remaining = gain > 0 ? 0 : d == toward ? dist - 1 : dist + 1;
+                BeamCandidate cand = {i, d, m->collected + gain, -(remaining << 3) - open,
+                                      m->hash ^ (fresh ? cell_hash(v) : 0)};
+                cands[count++] = cand;
+            }
+        }
+        if (count == 0) break;
+        qsort(cands, count, sizeof(BeamCandidate), compare_beam_candidates);
+        int kept = 0;
+        for (int k = 0; k < count && kept < width; k++) {
+            const BeamCandidate *cand = &cands[k];
+            const BeamMember *parent = &beam[cand->member];
+            int r = parent->cell / g->cols, c = parent->cell % g->cols;
+            uint32_t v = (uint32_t)((r + DIR_DR[cand->dir]) * g->cols + c + DIR_DC[cand->dir]);
+            // Walks that reach the same cell having covered the same set are interchangeable
+            bool duplicate = false;
+            for (int j = 0; j < kept && !duplicate; j++) duplicate = next[j].cell == v && next[j].hash == cand->hash;
+            if (duplicate) continue;
+            next[kept] = beam_member_share(parent, page_count);
+            beam_member_move(&next[kept], g, v);
+            kept++;
+        }
+        for (int i = 0; i < size; i++) beam_member_release(&beam[i], page_count);
+        BeamMember *swap = beam;
+        beam = next;
+        next = swap;
+        size = kept;
+    }
+
+    // The best member is first; replay its moves into res
+    int length = 0;
+    for (BeamMove *move = beam[0].last; move; move = move->parent) length++;
+    int k = length;
+    for (BeamMove *move = beam[0].last; move; move = move->parent) {
+        k--;
+        res->path_r[k] = move->cell / g->cols;
+        res->path_c[k] = move->cell % g->cols;
+    }
+    res->length = length;
+    res->unique_count = beam[0].unique;
+    for (int i = 0; i < size; i++) beam_member_release(&beam[i], page_count);
+    free(beam);
+    free(next);
+    free(cands);
+    free(stamp);
+    free(queue);
+    free(first);
+}
+
+// Total weight of the distinct cells on res's path; unique_count on unweighted grids
+long path_weight(const Grid *g, const PathResult *res, SolveContext *ctx) {
+    if (!g->weight) return res->unique_count;
+    uint64_t *seen = (uint64_t*)context_scratch(ctx, ((((size_t)g->rows * g->cols) >> 6) + 1) * sizeof(uint64_t));
+    long total = 0;
+    for (int k = 0; k < res->length; k++) {
+        size_t i = (size_t)res->path_r[k] * g->cols + res->path_c[k];
+        if (seen[i >> 6] >> (i & 63) & 1) continue;
+        seen[i >> 6] |= (uint64_t)1 << (i & 63);
+        total += g->weight[i];
+    }
+    return total;
+}
+
+const char *const STRATEGY_NAMES[STRATEGY_COUNT] = {
+    "greedy", "dead-ends", "tile-tour", "hilbert", "refine", "beam", "sweep"
+};
+
+// Solve with the given strategy, stopping once weight_target (LONG_MAX for none)
+// is collected. Beam and refine maximize weight and stop at a weight bound; the
+// others maximize unique cells and can only stop early on unweighted grids.
+static void solve_path_strategy_to(const Grid *g, int movement_points, Strategy strategy, long weight_target,
+                                   SolveContext *ctx, PathResult *res) {
+    int target = g->weight || weight_target > INT_MAX ? INT_MAX : (int)weight_target;
+    switch (strategy) {
+    case STRATEGY_DEAD_ENDS: {
+        // Built once per grid content and kept on the grid for later solves
+        const GridAnalysis *a = grid_cached_analysis(g);
+        if (a) {
+            solve_dead_ends_first(g, a, movement_points, target, ctx, res);
+            break;
+        }
+        solve_path_until(g, movement_points, target, ctx, res);
+        break;
+    }
+    case STRATEGY_TILE_TOUR:
+        solve_tile_tour(g, movement_points, target, ctx, res);
+        break;
+    case STRATEGY_HILBERT:
+        solve_hilbert_sweep(g, movement_points, target, ctx, res);
+        break;
+    case STRATEGY_SWEEP:
+        solve_interval_sweep(g, movement_points, target, ctx, res);
+        break;
+    case STRATEGY_BEAM:
+        solve_beam(g, movement_points, BEAM_WIDTH, weight_target, ctx, res);
+        break;
+    case STRATEGY_REFINE: {
+        // The tile tour ignores weights, so weighted grids start from the beam
+        if (g->weight) solve_beam(g, movement_points, BEAM_WIDTH, weight_target, ctx, res);
+        else solve_tile_tour(g, movement_points, target, ctx, res);
+        RefineOptions opt = {ctx->threads, REFINE_ITERATIONS, 1};
+        if (path_weight(g, res, ctx) < weight_target) refine_path(g, movement_points, weight_target, &opt, res);
+        break;
+    }
+    case STRATEGY_GREEDY:
+    default:
+        solve_path_until(g, movement_points, target, ctx, res);
+        break;
+    }
+    res->weight = path_weight(g, res, ctx);
+    res->upper_bound = ctx->compute_bound ? weight_target : 0;
+}
+
+// Solve with the given strategy; see the individual strategies for details.
+// With ctx->compute_bound the coverage bound is computed first, solvers stop as soon
+// as they reach it, and it is reported in res->upper_bound.
+void solve_path_strategy(const Grid *g, int movement_points, Strategy strategy,
+                         SolveContext *ctx, PathResult *res) {
+    long weight_target = LONG_MAX;
+    if (ctx->compute_bound) weight_target = coverage_upper_bound(g, movement_points).best;
+    solve_path_strategy_to(g, movement_points, strategy, weight_target, ctx, res);
+}
+
+// Print the grid with the cells of a visited pyramid: '#' blocked, 'o' visited, '.' free.
+// Rows are rendered 8 cells at a time so uniform spans cost one check.
+void print_coverage(const Grid *g, const BitPyramid *visited) {
+    if (!g || !g->blocked_pyramid || !visited) return;
+    const BitPyramid *b = g->blocked_pyramid;
+    char *line = (char*)malloc((size_t)g->cols + 1);
+    if (!line) {
+        fprintf(stderr, "Memory allocation failed for print buffer\n");
+        exit(1);
+    }
+    for (int r = 0; r < g->rows; r++) {
+        for (int bc = 0; bc < b->level_cols[0]; bc++) {
+            int c0 = bc * 8, w = g->cols - c0 < 8 ? g->cols - c0 : 8;
+            size_t i = (size_t)(r >> 3) * b->level_cols[0] + bc;
+            unsigned full = (1u << w) - 1;
+            unsigned blk = (b->leaf[i] >> ((r & 7) * 8)) & full;
+            unsigned vis = (visited->leaf[i] >> ((r & 7) * 8)) & full;
+            if (blk == 0 && vis == 0) memset(line + c0, '.', w);
+            else if (blk == full) memset(line + c0, '#', w);
+            else if (vis == full) memset(line + c0, 'o', w);
+            else for (int k = 0; k < w; k++) line[c0 + k] = ((blk >> k) & 1) ? '#' : ((vis >> k) & 1) ? 'o' : '.';
+        }
+        line[g->cols] = '\n';
+        fwrite(line, 1, (size_t)g->cols + 1, stdout);
+    }
+    free(line);
+}
+
+// Number of solves kept in flight by solve_path_batch
+#define INTERLEAVE_WIDTH 16
+
+// Solve many independent queries on one thread, interleaving up to INTERLEAVE_WIDTH
+// of them. Each solve advances one move per turn and prefetches the cells its next
+// move touches, so the cache misses of one solve overlap with work on the others.
+// results[i] receives the path for grids[i] with movement_points[i].
+void solve_path_batch(const Grid *const grids[], const int movement_points[], int count,
+                      PathResult results[]) {
+    SolveState slots[INTERLEAVE_WIDTH];
+    SolveContext ctxs[INTERLEAVE_WIDTH];
+    memset(ctxs, 0, sizeof(ctxs));
+    int slot_count = count < INTERLEAVE_WIDTH ? count : INTERLEAVE_WIDTH;
+    int next = 0;
+    int active = 0;
+
+    // Start the first solves; ones that finish immediately free their slot again
+    for (int i = 0; i < slot_count; i++) slots[i].done = true;
+    for (int i = 0; i < slot_count; i++) {
+        while (slots[i].done && next < count) {
+            int mp = movement_points[next] < 0 ? 0 : movement_points[next];
+            path_result_reserve(&results[next], mp + 1);
+            solve_state_init(&slots[i], grids[next], mp,
+                             context_visited_masks(&ctxs[i], grids[next]), NULL, &results[next]);
+            next++;
+        }
+        if (!slots[i].done) active++;
+    }
+
+    // Round-robin over the slots, refilling each as its solve finishes
+    while (active > 0) {
+        for (int i = 0; i < slot_count; i++) {
+            if (slots[i].done) continue;
+            solve_state_step(&slots[i]);
+            while (slots[i].done && next < count) {
+                int mp = movement_points[next] < 0 ? 0 : movement_points[next];
+                path_result_reserve(&results[next], mp + 1);
+                solve_state_init(&slots[i], grids[next], mp,
+                                 context_visited_masks(&ctxs[i], grids[next]), NULL, &results[next]);
+                next++;
+            }
+            if (slots[i].done) active--;
+        }
+    }
+
+    for (int i = 0; i < slot_count; i++) free(ctxs[i].vis_mask);
+}
+
+// Lock-step solver for batches of small grids (up to SMALL_GRID_MAX x SMALL_GRID_MAX).
+// Each SIMD lane holds one grid as free/unvisited bitboards plus its current position,
+// and all lanes run the greedy rules of solve_path together with masked moves. A lane
+// that finishes is refilled with the next grid of the batch.
+// The kernel runs 8 lanes, one AVX-512 register or two AVX2 ones, in the copy the
+// CPU supports (SIMD_CLONES). On CPUs with neither the batch runs the scalar solver.
+#define SMALL_GRID_MAX 16
+#define BOARD_LANES 8
+
+// Cell (r, c) lives at bit BOARD_PAD + r * SMALL_GRID_MAX + c. The zero padding rows above
+// and below the grid let neighborhood windows run off the edges without bounds checks.
+#define BOARD_PAD (2 * SMALL_GRID_MAX)
+#define BOARD_WORDS ((SMALL_GRID_MAX * SMALL_GRID_MAX + 2 * BOARD_PAD + 63) / 64)
+
+typedef uint64_t lanevec __attribute__((vector_size(8 * BOARD_LANES)));
+
+// All-ones in lanes where cond (0 or 1 per lane) is 1
+#define LANE_MASK(cond) (-(cond))
+
+// Bits [base, base + 64) of each lane's bitboard; bits past the board read as 0
+static inline __attribute__((always_inline)) void board_window(const lanevec board[BOARD_WORDS],
+                                                               const lanevec *base, lanevec *out) {
+    lanevec word = *base >> 6, shift = *base & 63, lo = {0}, hi = {0};
+    for (int k = 0; k < BOARD_WORDS; k++) {
+        lo |= board[k] & (lanevec)(word == (uint64_t)k);
+        hi |= board[k] & (lanevec)(word + 1 == (uint64_t)k);
+    }
+    *out = (lo >> shift) | ((hi << 1) << (63 - shift));
+}
+
+// Clear bit p in the lanes selected by mask
+static inline __attribute__((always_inline)) void board_clear(lanevec board[BOARD_WORDS], const lanevec *p,
+                                                              const lanevec *mask) {
+    lanevec word = *p >> 6, one = {0};
+    one += 1;
+    for (int k = 0; k < BOARD_WORDS; k++) board[k] &= ~((one << (*p & 63)) & (lanevec)(word == (uint64_t)k) & *mask);
+}
+
+typedef struct {
+    lanevec free_b[BOARD_WORDS];
+    lanevec unvisited_b[BOARD_WORDS];  // free cells not visited yet
+    lanevec pos;                       // bit index of the current cell
+    lanevec row, col, cols;
+    lanevec steps_left;
+    lanevec active;                    // all-ones while the lane's solve is running
+    PathResult *res[BOARD_LANES];
+} LaneBatch;
+
+// Load grid g into lane l and record its start cell
+static void lane_load(LaneBatch *b, int l, const Grid *g, int movement_points, PathResult *res) {
+    uint64_t words[BOARD_WORDS] = {0};
+    int start = -1;
+    for (int r = 0; r < g->rows; r++) {
+        uint64_t row_bits = 0;
+        for (int c = 0; c < g->cols; c++) row_bits |= (uint64_t)!g->blocked[r][c] << c;
+        if (row_bits == 0) continue;
+        int p = BOARD_PAD + r * SMALL_GRID_MAX;
+        words[p >> 6] |= row_bits << (p & 63);  // rows never straddle a word
+        if (start < 0) start = p + __builtin_ctzll(row_bits);
+    }
+    for (int k = 0; k < BOARD_WORDS; k++) {
+        b->free_b[k][l] = words[k];
+        b->unvisited_b[k][l] = words[k];
+    }
+    b->res[l] = res;
+    res->length = 0;
+    res->unique_count = 0;
+    res->weight = res->upper_bound = 0;
+    b->active[l] = 0;
+    if (start < 0) return;
+    int r = (start - BOARD_PAD) / SMALL_GRID_MAX, c = (start - BOARD_PAD) % SMALL_GRID_MAX;
+    b->unvisited_b[start >> 6][l] &= ~((uint64_t)1 << (start & 63));
+    b->pos[l] = (uint64_t)start;
+    b->row[l] = (uint64_t)r;
+    b->col[l] = (uint64_t)c;
+    b->cols[l] = (uint64_t)g->cols;
+    b->steps_left[l] = (uint64_t)movement_points;
+    res->path_r[0] = r;
+    res->path_c[0] = c;
+    res->length = 1;
+    res->unique_count = 1;
+    b->active[l] = movement_points > 0 ? ~(uint64_t)0 : 0;
+}
+
+// Advance every active lane by one greedy move
+static inline __attribute__((always_inline)) void lane_step(LaneBatch *b) {
+    const int S = SMALL_GRID_MAX;
+    lanevec zero = {0};
+    lanevec c_ge1 = (lanevec)(b->col >= 1), c_ge2 = (lanevec)(b->col >= 2);
+    lanevec c_lt1 = (lanevec)(b->col + 1 < b->cols), c_lt2 = (lanevec)(b->col + 2 < b->cols);
+    // Neighbors in (up, right, down, left) order: position offset and column validity
+    const int off[4] = {-S, 1, S, -1};
+    lanevec valid[4] = {~zero, c_lt1, ~zero, c_ge1};
+    lanevec dr[4] = {zero - 1, zero, zero + 1, zero};
+    lanevec dc[4] = {zero, zero + 1, zero, zero - 1};
+
+    // Forward move: first free, unvisited neighbor. Window bit S + o is offset o.
+    lanevec base = b->pos - S, near_u;
+    board_window(b->unvisited_b, &base, &near_u);
+    lanevec taken = zero, target = zero, move_r = zero, move_c = zero;
+    for (int d = 0; d < 4; d++) {
+        lanevec m = LANE_MASK((near_u >> (S + off[d])) & 1) & valid[d] & ~taken;
+        target |= (b->pos + off[d]) & m;
+        move_r |= dr[d] & m;
+        move_c |= dc[d] & m;
+        taken |= m;
+    }
+    lanevec forward = taken;
+
+    // Backtrack move for lanes without one: first free neighbor that has an unvisited
+    // neighbor. Offsets -2S..2S-1 come from a window at pos - 2S, offset 2S from near_u.
+    lanevec need_back = b->active & ~forward;
+    bool any_back = false;
+    for (int l = 0; l < BOARD_LANES; l++) any_back |= need_back[l] != 0;
+    if (any_back) {
+        lanevec far_base = b->pos - 2 * S, near_f, far_u;
+        board_window(b->free_b, &base, &near_f);
+        board_window(b->unvisited_b, &far_base, &far_u);
+#define FAR_U(o) ((far_u >> (2 * S + (o))) & 1)
+        lanevec frontier[4] = {
+            FAR_U(-2 * S) | (FAR_U(-S - 1) & c_ge1) | (FAR_U(-S + 1) & c_lt1),
+            FAR_U(-S + 1) | (FAR_U(2) & c_lt2) | FAR_U(S + 1),
+            (FAR_U(S - 1) & c_ge1) | (FAR_U(S + 1) & c_lt1) | ((near_u >> (3 * S)) & 1),
+            FAR_U(-S - 1) | (FAR_U(-2) & c_ge2) | FAR_U(S - 1),
+        };
+#undef FAR_U
+        for (int d = 0; d < 4; d++) {
+            lanevec m = LANE_MASK((near_f >> (S + off[d])) & frontier[d] & 1) & valid[d] & ~taken;
+            target |= (b->pos + off[d]) & m;
+            move_r |= dr[d] & m;
+            move_c |= dc[d] & m;
+            taken |= m;
+        }
+    }
+
+    lanevec moved = taken & b->active;
+    lanevec cleared = forward & moved;
+    board_clear(b->unvisited_b, &target, &cleared);
+    b->pos = (target & moved) | (b->pos & ~moved);
+    b->row += move_r & moved;
+    b->col += move_c & moved;
+    b->steps_left -= moved & 1;
+    b->active = moved & (lanevec)(b->steps_left > 0);
+
+    for (int l = 0; l < BOARD_LANES; l++) {
+        if (!moved[l]) continue;
+        PathResult *res = b->res[l];
+        res->path_r[res->length] = (int)b->row[l];
+        res->path_c[res->length] = (int)b->col[l];
+        res->length++;
+        res->unique_count += (int)(forward[l] & 1);
+    }
+}
+
+// Lanes the batch kernel runs on this CPU, 1 when it falls back to the scalar solver
+static int board_simd_lanes(void) {
+#if defined(__x86_64__) && defined(__GNUC__)
+    if (__builtin_cpu_supports("avx512f") || __builtin_cpu_supports("avx2")) return BOARD_LANES;
+#endif
+    return 1;
+}
+
+// Run the batch in lanes; grids too big for a lane are solved with ctx
+SIMD_CLONES static void solve_board_lanes(const Grid *const grids[], const int movement_points[], int count,
+                                          PathResult results[], SolveContext *ctx) {
+    LaneBatch b;
+    memset(&b, 0, sizeof(b));
+    int next = 0;
+    for (;;) {
+        // Refill idle lanes; grids that are too big or finish at once never occupy a lane
+        for (int l = 0; l < BOARD_LANES; l++) {
+            while (!b.active[l] && next < count) {
+                const Grid *g = grids[next];
+                int mp = movement_points[next] < 0 ? 0 : movement_points[next];
+                PathResult *res = &results[next++];
+                path_result_reserve(res, mp + 1);
+                if (g->rows > SMALL_GRID_MAX || g->cols > SMALL_GRID_MAX) {
+                    solve_path_into(g, mp, ctx, res);
+                    continue;
+                }
+                lane_load(&b, l, g, mp, res);
+            }
+        }
+        bool any_active = false;
+        for (int l = 0; l < BOARD_LANES; l++) any_active |= b.active[l] != 0;
+        if (!any_active) break;
+        lane_step(&b);
+    }
+}
+
+// Solve a batch of grids; grids no larger than SMALL_GRID_MAX x SMALL_GRID_MAX run in
+// SIMD lanes, larger ones fall back to solve_path_into. Paths match solve_path exactly.
+void solve_path_small_batch(const Grid *const grids[], const int movement_points[], int count,
+                            PathResult results[]) {
+    SolveContext *ctx = create_solve_context();
+    if (board_simd_lanes() > 1) {
+        solve_board_lanes(grids, movement_points, count, results, ctx);
+    } else {
+        for (int i = 0; i < count; i++) solve_path_into(grids[i], movement_points[i], ctx, &results[i]);
+    }
+    free_solve_context(ctx);
+}
+
+// ---------------------------------------------------------------------------
+// Grid views over caller-owned occupancy buffers.
+//
+// A GridView describes an occupancy map that already lives in memory (bytes or
+// a bitmap, with an arbitrary row stride) and the rule that makes a cell
+// blocked. The view solver reads the buffer in place; grid_from_view makes a
+// packed Grid in one vectorized pass when the full Grid machinery is wanted.
+// ---------------------------------------------------------------------------
+
+GridView make_grid_view(const void *data, int rows, int cols, size_t stride,
+                        OccupancyType type, int threshold, bool unknown_blocked) {
+    GridView v = {(const unsigned char*)data, rows, cols, stride, type, threshold, unknown_blocked};
+    return v;
+}
+
+static inline bool view_blocked(const GridView *v, int r, int c) {
+    const unsigned char *row = v->data + (size_t)r * v->stride;
+    switch (v->type) {
+    case OCCUPANCY_U8:
+        return row[c] >= v->threshold;
+    case OCCUPANCY_I8: {
+        int value = (signed char)row[c];
+        return value < 0 ? v->unknown_blocked : value >= v->threshold;
+    }
+    default:
+        return (row[c >> 3] >> (c & 7)) & 1;
+    }
+}
+
+// Free-neighbor mask of (r, c), in the same bit order as grid_neighbor_mask
+static inline unsigned view_neighbor_mask(const GridView *v, int r, int c) {
+    unsigned m = 0;
+    if (r > 0 && !view_blocked(v, r - 1, c)) m |= 1;
+    if (c + 1 < v->cols && !view_blocked(v, r, c + 1)) m |= 2;
+    if (r + 1 < v->rows && !view_blocked(v, r + 1, c)) m |= 4;
+    if (c > 0 && !view_blocked(v, r, c - 1)) m |= 8;
+    return m;
+}
+
+static inline bool view_visited(const unsigned char *visited, const GridView *v, int r, int c) {
+    size_t i = (size_t)r * v->cols + c;
+    return (visited[i >> 3] >> (i & 7)) & 1;
+}
+
+// Free neighbors of (r, c) that are not visited yet
+static inline unsigned view_unvisited_mask(const GridView *v, const unsigned char *visited, int r, int c) {
+    unsigned m = view_neighbor_mask(v, r, c), avail = 0;
+    for (unsigned rest = m; rest; rest &= rest - 1) {
+        int d = FIRST_MOVE[rest];
+        if (!view_visited(visited, v, r + DIR_DR[d], c + DIR_DC[d])) avail |= 1u << d;
+    }
+    return avail;
+}
+
+// The greedy solver of solve_path_into, reading the view's buffer directly.
+// Gives the same path as solving grid_from_view(v).
+void solve_path_view(const GridView *v, int movement_points, SolveContext *ctx, PathResult *res) {
+    if (movement_points < 0) movement_points = 0;
+    path_result_reserve(res, movement_points + 1);
+    res->length = 0;
+    res->unique_count = 0;
+    res->weight = res->upper_bound = 0;
+    int cr = -1, cc = -1;
+    for (int r = 0; r < v->rows && cr < 0; r++) {
+        for (int c = 0; c < v->cols; c++) {
+            if (!view_blocked(v, r, c)) {
+                cr = r;
+                cc = c;
+                break;
+            }
+        }
+    }
+    if (cr < 0) return;
+    unsigned char *visited = context_scratch(ctx, ((size_t)v->rows * v->cols + 7) >> 3);
+    size_t i = (size_t)cr * v->cols + cc;
+    visited[i >> 3] |= 1u << (i & 7);
+    res->path_r[0] = cr;
+    res->path_c[0] = cc;
+    res->length = res->unique_count = 1;
+    for (int steps = movement_points; steps > 0; steps--) {
+        unsigned avail = view_unvisited_mask(v, visited, cr, cc);
+        bool forward = avail != 0;
+        int nr = -1, nc = -1;
+        if (forward) {
+            int d = FIRST_MOVE[avail];
+            nr = cr + DIR_DR[d];
+            nc = cc + DIR_DC[d];
+        } else {
+            for (unsigned back = view_neighbor_mask(v, cr, cc); back; back &= back - 1) {
+                int d = FIRST_MOVE[back];
+                if (view_unvisited_mask(v, visited, cr + DIR_DR[d], cc + DIR_DC[d])) {
+                    nr = cr + DIR_DR[d];
+                    nc = cc + DIR_DC[d];
+                    break;
+                }
+            }
+            if (nr < 0) break;  // no move increases coverage
+        }
+        cr = nr;
+        cc = nc;
+        if (forward) {
+            i = (size_t)cr * v->cols + cc;
+            visited[i >> 3] |= 1u << (i & 7);
+            res->unique_count++;
+        }
+        res->path_r[res->length] = cr;
+        res->path_c[res->length] = cc;
+        res->length++;
+    }
+}
+
+typedef unsigned char bytevec __attribute__((vector_size(16)));
+typedef signed char sbytevec __attribute__((vector_size(16)));
+
+// Convert one row of the view into bools, 16 cells per vector compare
+static void view_convert_row(const GridView *v, int r, bool *out) {
+    const unsigned char *row = v->data + (size_t)r * v->stride;
+    int c = 0;
+    if (v->type == OCCUPANCY_BITMAP) {
+        for (; c < v->cols; c++) out[c] = (row[c >> 3] >> (c & 7)) & 1;
+        return;
+    }
+    // Thresholds outside the element range make every cell free or every cell blocked
+    int lo = v->type == OCCUPANCY_U8 ? 0 : -128, hi = v->type == OCCUPANCY_U8 ? 255 : 127;
+    int threshold = v->threshold < lo ? lo : v->threshold > hi + 1 ? hi + 1 : v->threshold;
+    bool known_blocks = threshold <= hi;
+    if (!known_blocks && (v->type == OCCUPANCY_U8 || !v->unknown_blocked)) {
+        memset(out, 0, v->cols * sizeof(bool));
+        return;
+    }
+    bytevec one;
+    memset(&one, 1, sizeof(one));
+    for (; c + 16 <= v->cols; c += 16) {
+        bytevec blocked;
+        if (v->type == OCCUPANCY_U8) {
+            bytevec x, t;
+            memcpy(&x, row + c, 16);
+            memset(&t, threshold, sizeof(t));
+            blocked = (bytevec)(x >= t);
+        } else {
+            sbytevec x, t, zero = {0};
+            memcpy(&x, row + c, 16);
+            for (int k = 0; k < 16; k++) t[k] = (signed char)threshold;
+            sbytevec known = (sbytevec)(x >= zero);
+            sbytevec hit = known_blocks ? (sbytevec)(x >= t) & known : zero;
+            if (v->unknown_blocked) hit |= ~known;
+            blocked = (bytevec)hit;
+        }
+        blocked &= one;
+        memcpy(out + c, &blocked, 16);
+    }
+    for (; c < v->cols; c++) out[c] = view_blocked(v, r, c);
+}
+
+// Copy the view into a new packed Grid with its neighbor masks, pyramid and hash
+Grid *grid_from_view(const GridView *v) {
+    Grid *g = allocate_grid(v->rows, v->cols);
+    for (int r = 0; r < v->rows; r++) view_convert_row(v, r, g->blocked[r]);
+    refresh_grid(g);
+    return g;
+}
+
+// ---------------------------------------------------------------------------
+// Time-scheduled obstacles.
+//
+// Doors and vehicles block cells during known time intervals. Time is the
+// number of movement points spent: the start cell is occupied at time 0 and the
+// k-th path entry at time k. Intervals are kept in CSR form for the scheduled
+// cells only, with one bit per grid cell so unscheduled cells cost a single
+// load. A solve with no schedule runs the static greedy unchanged.
+// ---------------------------------------------------------------------------
+
+struct ObstacleSchedule {
+    int rows, cols;
+    uint64_t *scheduled;     // bit per cell: set if the cell has an interval
+    uint32_t *cells;         // scheduled cells in ascending order
+    int *cell_start;         // intervals of cells[i] are [cell_start[i], cell_start[i + 1])
+    int *start, *end;        // disjoint intervals, sorted by start within each cell
+    int cell_count, count;
+    int horizon;             // no cell is blocked by the schedule from this time on
+};
+
+static int compare_scheduled_blocks(const void *a, const void *b) {
+    const ScheduledBlock *x = (const ScheduledBlock*)a, *y = (const ScheduledBlock*)b;
+    if (x->r != y->r) return x->r < y->r ? -1 : 1;
+    if (x->c != y->c) return x->c < y->c ? -1 : 1;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+// Build the schedule of a rows x cols grid. Blocks outside the grid or with
+// empty intervals are ignored; overlapping intervals of a cell are merged.
+ObstacleSchedule *create_obstacle_schedule(int rows, int cols, const ScheduledBlock *blocks, int count) {
+    size_t n = (size_t)rows * cols;
+    ObstacleSchedule *s = (ObstacleSchedule*)calloc(1, sizeof(ObstacleSchedule));
+    ScheduledBlock *sorted = (ScheduledBlock*)malloc((count + 1) * sizeof(ScheduledBlock));
+    if (s) {
+        s->scheduled = (uint64_t*)calloc((n >> 6) + 1, sizeof(uint64_t));
+        s->cells = (uint32_t*)malloc((count + 1) * sizeof(uint32_t));
+        s->cell_start = (int*)malloc((count + 2) * sizeof(int));
+        s->start = (int*)malloc((count + 1) * sizeof(int));
+        s->end = (int*)malloc((count + 1) * sizeof(int));
+    }
+    if (!s || !sorted || !s->scheduled || !s->cells || !s->cell_start || !s->start || !s->end) {
+        fprintf(stderr, "Memory allocation failed for ObstacleSchedule\n");
+        exit(1);
+    }
+    s->rows = rows;
+    s->cols = cols;
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        const ScheduledBlock *b = &blocks[i];
+        if (b->r < 0 || b->r >= rows || b->c < 0 || b->c >= cols || b->end <= b->start) continue;
+        sorted[kept++] = *b;
+    }
+    qsort(sorted, kept, sizeof(ScheduledBlock), compare_scheduled_blocks);
+    for (int i = 0; i < kept; i++) {
+        const ScheduledBlock *b = &sorted[i];
+        uint32_t cell = (uint32_t)((size_t)b->r * cols + b->c);
+        if (s->cell_count == 0 || s->cells[s->cell_count - 1] != cell) {
+            s->cell_start[s->cell_count] = s->count;
+            s->cells[s->cell_count++] = cell;
+            s->scheduled[cell >> 6] |= (uint64_t)1 << (cell & 63);
+        } else if (b->start <= s->end[s->count - 1]) {
+            if (b->end > s->end[s->count - 1]) s->end[s->count - 1] = b->end;
+            continue;
+        }
+        s->start[s->count] = b->start;
+        s->end[s->count] = b->end;
+        s->count++;
+    }
+    s->cell_start[s->cell_count] = s->count;
+    for (int i = 0; i < s->count; i++) {
+        if (s->end[i] > s->horizon) s->horizon = s->end[i];
+    }
+    free(sorted);
+    return s;
+}
+
+void free_obstacle_schedule(ObstacleSchedule *s) {
+    if (!s) return;
+    free(s->scheduled);
+    free(s->cells);
+    free(s->cell_start);
+    free(s->start);
+    free(s->end);
+    free(s);
+}
+
+// Index of the first interval of grid cell `cell` that ends after time t, or -1
+static inline int schedule_next_interval(const ObstacleSchedule *s, uint32_t cell, int t) {
+    if (!(s->scheduled[cell >> 6] >> (cell & 63) & 1) || t >= s->horizon) return -1;
+    int lo = 0, hi = s->cell_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (s->cells[mid] < cell) lo = mid + 1;
+        else hi = mid;
+    }
+    // Intervals are disjoint and sorted, so their ends are sorted too
+    int a = s->cell_start[lo], b = s->cell_start[lo + 1];
+    while (a < b) {
+        int mid = (a + b) / 2;
+        if (s->end[mid] <= t) a = mid + 1;
+        else b = mid;
+    }
+    return a < s->cell_start[lo + 1] ? a : -1;
+}
+
+// Whether the schedule blocks grid cell index `cell` at time t
+static inline bool schedule_blocked_at(const ObstacleSchedule *s, uint32_t cell, int t) {
+    int i = schedule_next_interval(s, cell, t);
+    return i >= 0 && s->start[i] <= t;
+}
+
+bool cell_blocked_at(const ObstacleSchedule *s, int r, int c, int t) {
+    return schedule_blocked_at(s, (uint32_t)((size_t)r * s->cols + c), t);
+}
+
+// Earliest time to enter v from u when u was entered at time `at`: step at
+// once if v is free at at + 1, otherwise wait on u until v's interval ends.
+// Returns -1 if u is itself blocked before then. Merged intervals leave v free
+// at the end of the one it is in.
+static int schedule_earliest_step(const ObstacleSchedule *s, uint32_t u, uint32_t v, int at) {
+    int arrive = at + 1;
+    int i = schedule_next_interval(s, v, arrive);
+    if (i >= 0 && s->start[i] <= arrive) arrive = s->end[i];
+    if (arrive > at + 1) {
+        int j = schedule_next_interval(s, u, at + 1);
+        if (j >= 0 && s->start[j] < arrive) return -1;
+    }
+    return arrive;
+}
+
+// Greedy coverage under a schedule: walk to the unvisited cell with the
+// earliest safe arrival time, waiting in place when the next cell is blocked.
+// A wait repeats the current cell on the path and costs one movement point.
+// Each search is a Dijkstra over cells keyed by the earliest arrival time, so
+// it keeps one time per cell rather than one node per cell and time step:
+// memory is O(cells) whatever the budget and the schedule's horizon. Keeping
+// only the earliest arrival can miss a walk that waits somewhere reached later
+// and is safe longer; the search is a heuristic and accepts that. The search
+// state lives on the context. Returns false, leaving the result empty, if the
+// schedule was built for other dimensions or blocks the start cell at time 0.
+bool solve_path_scheduled(const Grid *g, const ObstacleSchedule *sched, int movement_points,
+                          SolveContext *ctx, PathResult *res) {
+    if (!sched || sched->count == 0) {
+        solve_path_until(g, movement_points, INT_MAX, ctx, res);
+        return true;
+    }
+    if (movement_points < 0) movement_points = 0;
+    path_result_reserve(res, movement_points + 1);
+    res->length = res->unique_count = 0;
+    res->weight = res->upper_bound = 0;
+    if (sched->rows != g->rows || sched->cols != g->cols) return false;
+    int sr, sc;
+    if (!find_start_cell(g, &sr, &sc)) return true;
+    if (cell_blocked_at(sched, sr, sc, 0)) return false;
+    size_t n = (size_t)g->rows * g->cols;
+    unsigned char *visited = context_scratch(ctx, n);
+    ScheduleSearch *search = context_schedule_search(ctx, n);
+    uint32_t *stamp = search->stamp, *parent = search->parent;
+    int *arrival = search->arrival;
+    uint32_t cur = (uint32_t)((size_t)sr * g->cols + sc);
+    visited[cur] = 1;
+    res->path_r[0] = sr;
+    res->path_c[0] = sc;
+    res->length = res->unique_count = 1;
+    int t = 0;
+    while (t < movement_points) {
+        if (search->mark == UINT32_MAX) {
+            memset(stamp, 0, search->cells * sizeof(uint32_t));
+            search->mark = 0;
+        }
+        uint32_t mark = ++search->mark;
+        uint64_t *heap = search->heap;
+        stamp[cur] = mark;
+        arrival[cur] = t;
+        heap[0] = (uint64_t)t << 32 | cur;
+        size_t heap_size = 1;
+        long found = -1;
+        while (heap_size > 0) {
+            uint64_t top = heap[0];
+            uint64_t last = heap[--heap_size];
+            size_t i = 0;
+            for (;;) {
+                size_t child = 2 * i + 1;
+                if (child >= heap_size) break;
+                if (child + 1 < heap_size && heap[child + 1] < heap[child]) child++;
+                if (heap[child] >= last) break;
+                heap[i] = heap[child];
+                i = child;
+            }
+            if (heap_size > 0) heap[i] = last;
+            uint32_t u = (uint32_t)top;
+            int at = (int)(top >> 32);
+            if (at != arrival[u]) continue;
+            if (!visited[u]) {
+                found = (long)u;
+                break;
+            }
+            int r = (int)(u / g->cols), c = (int)(u % g->cols);
+            for (unsigned moves = grid_neighbor_mask(g, r, c); moves; moves &= moves - 1) {
+                int d = FIRST_MOVE[moves & 15];
+                uint32_t v = (uint32_t)((r + DIR_DR[d]) * g->cols + c + DIR_DC[d]);
+                int when = schedule_earliest_step(sched, u, v, at);
+                if (when < 0 || when > movement_points) continue;
+                if (stamp[v] == mark && arrival[v] <= when) continue;
+                stamp[v] = mark;
+                arrival[v] = when;
+                parent[v] = u;
+                if (heap_size == search->heap_capacity) {
+                    search->heap_capacity *= 2;
+                    heap = search->heap = (uint64_t*)realloc(heap, search->heap_capacity * sizeof(uint64_t));
+                    if (!heap) {
+                        fprintf(stderr, "Memory allocation failed for %zu search entries\n", search->heap_capacity);
+                        exit(1);
+                    }
+                }
+                uint64_t key = (uint64_t)when << 32 | v;
+                size_t k = heap_size++;
+                while (k > 0 && heap[(k - 1) / 2] > key) {
+                    heap[k] = heap[(k - 1) / 2];
+                    k = (k - 1) / 2;
+                }
+                heap[k] = key;
+            }
+        }
+        if (found < 0) break;
+        // Lay the walk down back to front, repeating a cell for each wait on it
+        uint32_t v = (uint32_t)found;
+        int k = res->length + (arrival[v] - t) - 1;
+        while (v != cur) {
+            uint32_t u = parent[v];
+            for (int time = arrival[v]; time > arrival[u]; time--, k--) {
+                uint32_t cell = time == arrival[v] ? v : u;
+                res->path_r[k] = (int)(cell / g->cols);
+                res->path_c[k] = (int)(cell % g->cols);
+            }
+            v = u;
+        }
+        res->length += arrival[found] - t;
+        t = arrival[found];
+        cur = (uint32_t)found;
+        visited[cur] = 1;
+        res->unique_count++;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Prepared grids.
+//
+// Many queries against one map share its precomputation: the start cell, free
+// count, connected components, component census for the coverage bound,
+// articulation analysis, distance-to-wall field and row intervals. A
+// PreparedGrid builds each artifact lazily on first use and records the grid
+// hash it was built for, so a stale artifact is rebuilt on its next use even if
+// the grid was changed behind the prepared grid's back. Mutations made through
+// prepared_set_blocked patch the cheap artifacts in place and drop only the ones
+// the change can affect. The neighbor masks and blocked pyramid are kept up to
+// date by the grid itself.
+// ---------------------------------------------------------------------------
+
+struct PreparedGrid {
+    Grid *g;
+    uint64_t start_hash;
+    int start_r, start_c;        // -1 if every cell is blocked
+    uint64_t free_hash;
+    long free_count;
+    uint64_t labels_hash;
+    int *labels;                 // per cell: connected component, -1 if blocked
+    long *component_size;        // cells per component
+    int component_count, component_capacity;
+    ComponentCensus census;
+    bool has_census;
+    uint64_t wall_hash;
+    uint16_t *wall_distance;     // per cell: moves to the nearest blocked or outside cell, saturating
+};
+
+// Wrap g; the prepared grid does not own it and must be freed before it
+PreparedGrid *create_prepared_grid(Grid *g) {
+    PreparedGrid *pg = (PreparedGrid*)calloc(1, sizeof(PreparedGrid));
+    if (!pg) {
+        fprintf(stderr, "Memory allocation failed for PreparedGrid\n");
+        exit(1);
+    }
+    pg->g = g;
+    // Hashes start out one off the grid's so every artifact is stale
+    pg->start_hash = pg->free_hash = pg->labels_hash = pg->wall_hash = g->hash ^ 1;
+    pg->start_r = pg->start_c = -1;
+    pg->census.start_r = pg->census.start_c = -1;
+    return pg;
+}
+
+static void prepared_drop_labels(PreparedGrid *pg) {
+    free(pg->labels);
+    free(pg->component_size);
+    pg->labels = NULL;
+    pg->component_size = NULL;
+    pg->component_count = pg->component_capacity = 0;
+}
+
+void free_prepared_grid(PreparedGrid *pg) {
+    if (!pg) return;
+    prepared_drop_labels(pg);
+    free_component_census(&pg->census);
+    free(pg->wall_distance);
+    free(pg);
+}
+
+bool prepared_start_cell(PreparedGrid *pg, int *start_r, int *start_c) {
+    if (pg->start_hash != pg->g->hash) {
+        if (!find_start_cell(pg->g, &pg->start_r, &pg->start_c)) pg->start_r = pg->start_c = -1;
+        pg->start_hash = pg->g->hash;
+    }
+    *start_r = pg->start_r;
+    *start_c = pg->start_c;
+    return pg->start_r >= 0;
+}
+
+long prepared_free_count(PreparedGrid *pg) {
+    if (pg->free_hash != pg->g->hash) {
+        const Grid *g = pg->g;
+        long blocked = 0;
+        for (int r = 0; r < g->rows; r++) {
+            for (int c = 0; c < g->cols; c++) blocked += g->blocked[r][c];
+        }
+        pg->free_count = (long)g->rows * g->cols - blocked;
+        pg->free_hash = g->hash;
+    }
+    return pg->free_count;
+}
+
+static int prepared_new_component(PreparedGrid *pg) {
+    if (pg->component_count == pg->component_capacity) {
+        pg->component_capacity = pg->component_capacity ? pg->component_capacity * 2 : 64;
+        pg->component_size = (long*)realloc(pg->component_size, pg->component_capacity * sizeof(long));
+        if (!pg->component_size) {
+            fprintf(stderr, "Memory allocation failed for %d components\n", pg->component_capacity);
+            exit(1);
+        }
+    }
+    pg->component_size[pg->component_count] = 0;
+    return pg->component_count++;
+}
+
+// Connected component of every cell, labelled in row-major order of first cell;
+// component_count and component_sizes (may be NULL) describe them
+const int *prepared_components(PreparedGrid *pg, int *component_count, const long **component_sizes) {
+    const Grid *g = pg->g;
+    if (pg->labels_hash != g->hash || !pg->labels) {
+        prepared_drop_labels(pg);
+        size_t n = (size_t)g->rows * g->cols;
+        pg->labels = (int*)malloc(n * sizeof(int));
+        uint32_t *queue = (uint32_t*)malloc(n * sizeof(uint32_t));
+        if (!pg->labels || !queue) {
+            fprintf(stderr, "Memory allocation failed for component labels\n");
+            exit(1);
+        }
+        for (size_t i = 0; i < n; i++) pg->labels[i] = -1;
+        for (size_t s = 0; s < n; s++) {
+            if (pg->labels[s] >= 0 || g->blocked[s / g->cols][s % g->cols]) continue;
+            int label = prepared_new_component(pg);
+            size_t head = 0, tail = 0;
+            pg->labels[s] = label;
+            queue[tail++] = (uint32_t)s;
+            while (head < tail) {
+                uint32_t u = queue[head++];
+                int r = (int)(u / g->cols), c = (int)(u % g->cols);
+                for (unsigned m = grid_neighbor_mask(g, r, c); m; m &= m - 1) {
+                    int d = FIRST_MOVE[m];
+                    uint32_t v = (uint32_t)((r + DIR_DR[d]) * g->cols + c + DIR_DC[d]);
+                    if (pg->labels[v] >= 0) continue;
+                    pg->labels[v] = label;
+                    queue[tail++] = v;
+                }
+            }
+            pg->component_size[label] = (long)tail;
+        }
+        free(queue);
+        pg->labels_hash = g->hash;
+    }
+    if (component_count) *component_count = pg->component_count;
+    if (component_sizes) *component_sizes = pg->component_size;
+    return pg->labels;
+}
+
+// Articulation analysis, cached on the grid itself (see grid_analysis)
+const GridAnalysis *prepared_analysis(PreparedGrid *pg) {
+    return grid_analysis(pg->g);
+}
+
+static const ComponentCensus *prepared_census(PreparedGrid *pg) {
+    const Grid *g = pg->g;
+    if (!pg->has_census || pg->census.hash != g->hash || pg->census.weight_hash != g->weight_hash) {
+        take_component_census(g, &pg->census);
+        pg->has_census = true;
+    }
+    return &pg->census;
+}
+
+CoverageBound prepared_coverage_bound(PreparedGrid *pg, int movement_points) {
+    return census_bound(prepared_census(pg), movement_points);
+}
+
+// Moves from each cell to the nearest blocked cell or off the grid; 0 on blocked cells
+const uint16_t *prepared_wall_distance(PreparedGrid *pg) {
+    const Grid *g = pg->g;
+    if (pg->wall_hash == g->hash && pg->wall_distance) return pg->wall_distance;
+    size_t n = (size_t)g->rows * g->cols;
+    uint16_t *dist = pg->wall_distance ? pg->wall_distance : (uint16_t*)malloc(n * sizeof(uint16_t));
+    uint32_t *queue = (uint32_t*)malloc(n * sizeof(uint32_t));
+    if (!dist || !queue) {
+        fprintf(stderr, "Memory allocation failed for wall distances\n");
+        exit(1);
+    }
+    // Blocked cells are at 0; free cells missing a neighbor, inside or off the grid, at 1
+    size_t head = 0, tail = 0;
+    for (int r = 0; r < g->rows; r++) {
+        for (int c = 0; c < g->cols; c++) {
+            size_t i = (size_t)r * g->cols + c;
+            if (g->blocked[r][c]) {
+                dist[i] = 0;
+            } else if (grid_neighbor_mask(g, r, c) != 15) {
+                dist[i] = 1;
+                queue[tail++] = (uint32_t)i;
+            } else {
+                dist[i] = UINT16_MAX;
+            }
+        }
+    }
+    while (head < tail) {
+        uint32_t u = queue[head++];
+        int r = (int)(u / g->cols), c = (int)(u % g->cols);
+        uint16_t next = dist[u] == UINT16_MAX ? UINT16_MAX : dist[u] + 1;
+        for (unsigned m = grid_neighbor_mask(g, r, c); m; m &= m - 1) {
+            int d = FIRST_MOVE[m];
+            uint32_t v = (uint32_t)((r + DIR_DR[d]) * g->cols + c + DIR_DC[d]);
+            if (dist[v] <= next) continue;
+            dist[v] = next;
+            queue[tail++] = v;
+        }
+    }
+    free(queue);
+    pg->wall_distance = dist;
+    pg->wall_hash = g->hash;
+    return dist;
+}
+
+const IntervalGrid *prepared_intervals(PreparedGrid *pg) {
+    return grid_intervals(pg->g);
+}
+
+// Block or unblock (r, c) through the grid, patching the artifacts the change
+// leaves cheap to update: the free count, the start cell unless it moves past
+// the old one, and the labels when a cell joins at most one component or a
+// blocked cell was a leaf of its component. The rest is rebuilt on next use.
+void prepared_set_blocked(PreparedGrid *pg, int r, int c, bool blocked) {
+    Grid *g = pg->g;
+    if (r < 0 || r >= g->rows || c < 0 || c >= g->cols || g->blocked[r][c] == blocked) return;
+    uint64_t old_hash = g->hash;
+    unsigned nbrs = grid_neighbor_mask(g, r, c);
+    size_t cell = (size_t)r * g->cols + c;
+    set_blocked(g, r, c, blocked);
+    if (pg->free_hash == old_hash) {
+        pg->free_count += blocked ? -1 : 1;
+        pg->free_hash = g->hash;
+    }
+    if (pg->start_hash == old_hash) {
+        long start = pg->start_r < 0 ? -1 : (long)pg->start_r * g->cols + pg->start_c;
+        if (!blocked && (start < 0 || (long)cell < start)) {
+            pg->start_r = r;
+            pg->start_c = c;
+            pg->start_hash = g->hash;
+        } else if (!blocked || (long)cell != start) {
+            pg->start_hash = g->hash;
+        }
+    }
+    if (pg->labels_hash == old_hash && pg->labels) {
+        int joined = -1;
+        bool merges = false;
+        for (unsigned m = nbrs; m; m &= m - 1) {
+            int d = FIRST_MOVE[m];
+            int label = pg->labels[(size_t)(r + DIR_DR[d]) * g->cols + c + DIR_DC[d]];
+            if (joined >= 0 && label != joined) merges = true;
+            joined = label;
+        }
+        if (!blocked && !merges) {
+            if (joined < 0) joined = prepared_new_component(pg);
+            pg->labels[cell] = joined;
+            pg->component_size[joined]++;
+            pg->labels_hash = g->hash;
+        } else if (blocked && __builtin_popcount(nbrs) <= 1) {
+            // A leaf leaves the rest of its component connected; an isolated
+            // cell leaves an empty component behind
+            pg->component_size[pg->labels[cell]]--;
+            pg->labels[cell] = -1;
+            pg->labels_hash = g->hash;
+        }
+    }
+}
+
+// Solve a query against the prepared grid. Same as solve_path_strategy, but
+// the coverage bound comes from the cached component census.
+void prepared_solve(PreparedGrid *pg, int movement_points, Strategy strategy, SolveContext *ctx, PathResult *res) {
+    long weight_target = LONG_MAX;
+    if (ctx->compute_bound) weight_target = prepared_coverage_bound(pg, movement_points).best;
+    if (strategy == STRATEGY_DEAD_ENDS) prepared_analysis(pg);
+    solve_path_strategy_to(pg->g, movement_points, strategy, weight_target, ctx, res);
+}
+
+// ---------------------------------------------------------------------------
+// Result cache for repeated queries.
+//
+// Solve results are cached in-process under (grid hash, dimensions, start cell,
+// budget, strategy). Entries are evicted least recently used first once their
+// paths exceed the configured byte budget. The cache is safe to share between
+// threads.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    uint64_t grid_hash;
+    uint64_t weight_hash;
+    int rows, cols;
+    int start_r, start_c;
+    int movement_points;
+    int strategy;
+    int bounded;  // solved with SolveContext.compute_bound, which can shorten the path
+} ResultKey;
+
+typedef struct CacheEntry {
+    ResultKey key;
+    int *path;                 // length row/column pairs
+    int length, unique_count;
+    long weight, upper_bound;
+    size_t bytes;
+    struct CacheEntry *bucket_next;
+    struct CacheEntry *lru_prev, *lru_next;  // head = most recently used
+} CacheEntry;
+
+struct ResultCache {
+    pthread_mutex_t lock;
+    CacheEntry **buckets;
+    size_t bucket_count;       // power of two
+    size_t entries;
+    size_t bytes, max_bytes;
+    CacheEntry *lru_head, *lru_tail;
+    long hits, misses, evictions;
+};
+
+ResultCache *create_result_cache(size_t max_bytes) {
+    ResultCache *cache = (ResultCache*)calloc(1, sizeof(ResultCache));
+    if (cache) {
+        cache->bucket_count = 1024;
+        cache->buckets = (CacheEntry**)calloc(cache->bucket_count, sizeof(CacheEntry*));
+    }
+    if (!cache || !cache->buckets) {
+        fprintf(stderr, "Memory allocation failed for ResultCache\n");
+        exit(1);
+    }
+    cache->max_bytes = max_bytes;
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+void free_result_cache(ResultCache *cache) {
+    if (!cache) return;
+    for (CacheEntry *e = cache->lru_head; e;) {
+        CacheEntry *next = e->lru_next;
+        free(e->path);
+        free(e);
+        e = next;
+    }
+    free(cache->buckets);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+// Counters of the cache, read together under its lock; any output may be NULL
+void result_cache_stats(ResultCache *cache, long *hits, long *misses, long *evictions, size_t *bytes) {
+    pthread_mutex_lock(&cache->lock);
+    if (hits) *hits = cache->hits;
+    if (misses) *misses = cache->misses;
+    if (evictions) *evictions = cache->evictions;
+    if (bytes) *bytes = cache->bytes;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+static uint64_t result_key_hash(const ResultKey *k) {
+    uint64_t h = k->grid_hash ^ k->weight_hash;
+    h = cell_hash(h ^ ((uint64_t)(uint32_t)k->rows << 32 | (uint32_t)k->cols));
+    h = cell_hash(h ^ ((uint64_t)(uint32_t)k->start_r << 32 | (uint32_t)k->start_c));
+    return cell_hash(h ^ ((uint64_t)(uint32_t)k->movement_points << 32 | (uint32_t)k->strategy << 1 | (uint32_t)k->bounded));
+}
+
+static bool result_key_equal(const ResultKey *a, const ResultKey *b) {
+    return a->grid_hash == b->grid_hash && a->weight_hash == b->weight_hash &&
+           a->rows == b->rows && a->cols == b->cols &&
+           a->start_r == b->start_r && a->start_c == b->start_c &&
+           a->movement_points == b->movement_points && a->strategy == b->strategy &&
+           a->bounded == b->bounded;
+}
+
+static void cache_lru_unlink(ResultCache *cache, CacheEntry *e) {
+    if (e->lru_prev) e->lru_prev->lru_next = e->lru_next;
+    else cache->lru_head = e->lru_next;
+    if (e->lru_next) e->lru_next->lru_prev = e->lru_prev;
+    else cache->lru_tail = e->lru_prev;
+}
+
+static void cache_lru_push_front(ResultCache *cache, CacheEntry *e) {
+    e->lru_prev = NULL;
+    e->lru_next = cache->lru_head;
+    if (cache->lru_head) cache->lru_head->lru_prev = e;
+    cache->lru_head = e;
+    if (!cache->lru_tail) cache->lru_tail = e;
+}
+
+static void cache_remove(ResultCache *cache, CacheEntry *e) {
+    CacheEntry **link = &cache->buckets[result_key_hash(&e->key) & (cache->bucket_count - 1)];
+    while (*link != e) link = &(*link)->bucket_next;
+    *link = e->bucket_next;
+    cache_lru_unlink(cache, e);
+    cache->bytes -= e->bytes;
+    cache->entries--;
+    free(e->path);
+    free(e);
+}
+
+static void cache_grow(ResultCache *cache) {
+    size_t n = cache->bucket_count * 2;
+    CacheEntry **buckets = (CacheEntry**)calloc(n, sizeof(CacheEntry*));
+    if (!buckets) return;  // keep the longer chains
+    for (size_t i = 0; i < cache->bucket_count; i++) {
+        for (CacheEntry *e = cache->buckets[i]; e;) {
+            CacheEntry *next = e->bucket_next;
+            CacheEntry **b = &buckets[result_key_hash(&e->key) & (n - 1)];
+            e->bucket_next = *b;
+            *b = e;
+            e = next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucket_count = n;
+}
+
+// Copy a cached path into res; the cache lock must be held
+static CacheEntry *cache_find(ResultCache *cache, const ResultKey *key) {
+    for (CacheEntry *e = cache->buckets[result_key_hash(key) & (cache->bucket_count - 1)]; e; e = e->bucket_next) {
+        if (result_key_equal(&e->key, key)) return e;
+    }
+    return NULL;
+}
+
+static bool cache_lookup(ResultCache *cache, const ResultKey *key, PathResult *res) {
+    CacheEntry *e = cache_find(cache, key);
+    if (!e) return false;
+    path_result_reserve(res, e->length > 0 ? e->length : 1);
+    for (int i = 0; i < e->length; i++) {
+        res->path_r[i] = e->path[2 * i];
+        res->path_c[i] = e->path[2 * i + 1];
+    }
+    res->length = e->length;
+    res->unique_count = e->unique_count;
+    res->weight = e->weight;
+    res->upper_bound = e->upper_bound;
+    if (cache->lru_head != e) {
+        cache_lru_unlink(cache, e);
+        cache_lru_push_front(cache, e);
+    }
+    return true;
+}
+
+// Store a copy of res under key, evicting old entries to stay within max_bytes.
+// Concurrent misses on the same query both get here; the first copy is kept.
+static void cache_insert(ResultCache *cache, const ResultKey *key, const PathResult *res) {
+    CacheEntry *existing = cache_find(cache, key);
+    if (existing) {
+        if (cache->lru_head != existing) {
+            cache_lru_unlink(cache, existing);
+            cache_lru_push_front(cache, existing);
+        }
+        return;
+    }
+    size_t bytes = sizeof(CacheEntry) + (size_t)res->length * 2 * sizeof(int);
+    if (bytes > cache->max_bytes) return;
+    CacheEntry *e = (CacheEntry*)malloc(sizeof(CacheEntry));
+    int *path = (int*)malloc(((size_t)res->length * 2 + 1) * sizeof(int));
+    if (!e || !path) {
+        free(e);
+        free(path);
+        return;  // caching is best effort
+    }
+    for (int i = 0; i < res->length; i++) {
+        path[2 * i] = res->path_r[i];
+        path[2 * i + 1] = res->path_c[i];
+    }
+    e->key = *key;
+    e->path = path;
+    e->length = res->length;
+    e->unique_count = res->unique_count;
+    e->weight = res->weight;
+    e->upper_bound = res->upper_bound;
+    e->bytes = bytes;
+    while (cache->lru_tail && cache->bytes + bytes > cache->max_bytes) {
+        cache_remove(cache, cache->lru_tail);
+        cache->evictions++;
+    }
+    if (cache->entries >= cache->bucket_count) cache_grow(cache);
+    CacheEntry **b = &cache->buckets[result_key_hash(key) & (cache->bucket_count - 1)];
+    e->bucket_next = *b;
+    *b = e;
+    cache_lru_push_front(cache, e);
+    cache->bytes += bytes;
+    cache->entries++;
+}
+
+// solve_path_strategy through the cache: a repeated query for the same map content,
+// start cell, budget and strategy is answered by copying the stored path.
+void solve_path_cached(ResultCache *cache, const Grid *g, int movement_points, Strategy strategy,
+                       SolveContext *ctx, PathResult *res) {
+    ResultKey key;
+    memset(&key, 0, sizeof(key));
+    key.grid_hash = g->hash;
+    key.weight_hash = g->weight_hash;
+    key.rows = g->rows;
+    key.cols = g->cols;
+    if (!find_start_cell(g, &key.start_r, &key.start_c)) key.start_r = key.start_c = -1;
+    key.movement_points = movement_points < 0 ? 0 : movement_points;
+    key.strategy = strategy;
+    key.bounded = ctx->compute_bound;
+
+    pthread_mutex_lock(&cache->lock);
+    bool hit = cache_lookup(cache, &key, res);
+    if (hit) cache->hits++;
+    else cache->misses++;
+    pthread_mutex_unlock(&cache->lock);
+    if (hit) return;
+
+    solve_path_strategy(g, movement_points, strategy, ctx, res);
+    pthread_mutex_lock(&cache->lock);
+    cache_insert(cache, &key, res);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// ---------------------------------------------------------------------------
+// Canonical room-shape plan cache.
+//
+// Small grids (up to SMALL_GRID_MAX per side) are reduced to a canonical form
+// under the 8 symmetries of the square: the rotation/reflection with the smallest
+// (rows, cols, bit pattern) wins. The key is the shape alone: the plan stored
+// for a class is solved on the canonical form itself, from its own start cell,
+// and mapped back through the query's symmetry on lookup, so every rotation and
+// mirror image of a room reuses it. Such a plan therefore begins at the image of
+// the canonical start, which need not be the query grid's own start cell. The
+// cache can be saved to and loaded from disk.
+// ---------------------------------------------------------------------------
+
+#define SHAPE_WORDS (SMALL_GRID_MAX * SMALL_GRID_MAX / 64)
+#define SHAPE_CACHE_MAGIC "GTSHAPE3"
+
+typedef struct {
+    int rows, cols;
+    int movement_points;
+    int start_r, start_c;        // first free cell of the canonical grid, -1 if none; follows from bits
+    uint64_t bits[SHAPE_WORDS];  // blocked cells, bit r * cols + c of the canonical grid
+} ShapeKey;
+
+typedef struct {
+    ShapeKey key;
+    int *path;                   // length row/column pairs in canonical coordinates
+    int length, unique_count;
+} ShapeEntry;
+
+struct ShapeCache {
+    ShapeEntry *entries;
+    int count, capacity;
+    int *index;                  // open addressing over entries, -1 = empty
+    int index_size;              // power of two, at least twice count
+    long hits, misses;
+};
+
+// Map (r, c) of a rows x cols grid through symmetry t: bit 2 transposes, then
+// bit 1 flips rows and bit 0 flips columns of the result
+static inline void shape_transform(int t, int rows, int cols, int r, int c, int *out_r, int *out_c) {
+    if (t & 4) {
+        int tmp = r; r = c; c = tmp;
+        tmp = rows; rows = cols; cols = tmp;
+    }
+    if (t & 2) r = rows - 1 - r;
+    if (t & 1) c = cols - 1 - c;
+    *out_r = r;
+    *out_c = c;
+}
+
+// Inverse of shape_transform; rows/cols are those of the original grid
+static inline void shape_untransform(int t, int rows, int cols, int r, int c, int *out_r, int *out_c) {
+    int tr = (t & 4) ? cols : rows, tc = (t & 4) ? rows : cols;
+    if (t & 2) r = tr - 1 - r;
+    if (t & 1) c = tc - 1 - c;
+    if (t & 4) {
+        int tmp = r; r = c; c = tmp;
+    }
+    *out_r = r;
+    *out_c = c;
+}
+
+static int shape_key_compare(const ShapeKey *a, const ShapeKey *b) {
+    if (a->rows != b->rows) return a->rows < b->rows ? -1 : 1;
+    if (a->cols != b->cols) return a->cols < b->cols ? -1 : 1;
+    for (int k = 0; k < SHAPE_WORDS; k++) {
+        if (a->bits[k] != b->bits[k]) return a->bits[k] < b->bits[k] ? -1 : 1;
+    }
+    return 0;
+}
+
+static bool shape_key_equal(const ShapeKey *a, const ShapeKey *b) {
+    return a->movement_points == b->movement_points && shape_key_compare(a, b) == 0;
+}
+
+// First free cell of the key's grid in row-major order, or -1, -1
+static void shape_key_start(const ShapeKey *k, int *start_r, int *start_c) {
+    *start_r = *start_c = -1;
+    for (int bit = 0; bit < k->rows * k->cols; bit++) {
+        if (!(k->bits[bit >> 6] >> (bit & 63) & 1)) {
+            *start_r = bit / k->cols;
+            *start_c = bit % k->cols;
+            return;
+        }
+    }
+}
+
+// Canonical key of g and the symmetry mapping g onto it; false if g is too large
+static bool shape_canonicalize(const Grid *g, int movement_points, ShapeKey *key, int *symmetry) {
+    // Shapes carry no weights, so weighted grids are never shared
+    if (g->rows > SMALL_GRID_MAX || g->cols > SMALL_GRID_MAX || g->weight) return false;
+    ShapeKey best;
+    int best_t = 0;
+    for (int t = 0; t < 8; t++) {
+        ShapeKey k;
+        memset(&k, 0, sizeof(k));
+        k.rows = (t & 4) ? g->cols : g->rows;
+        k.cols = (t & 4) ? g->rows : g->cols;
+        k.movement_points = movement_points;
+        for (int r = 0; r < g->rows; r++) {
+            for (int c = 0; c < g->cols; c++) {
+                if (!g->blocked[r][c]) continue;
+                int tr, tc;
+                shape_transform(t, g->rows, g->cols, r, c, &tr, &tc);
+                int bit = tr * k.cols + tc;
+                k.bits[bit >> 6] |= (uint64_t)1 << (bit & 63);
+            }
+        }
+        if (t == 0 || shape_key_compare(&k, &best) < 0) {
+            best = k;
+            best_t = t;
+        }
+    }
+    shape_key_start(&best, &best.start_r, &best.start_c);
+    *key = best;
+    *symmetry = best_t;
+    return true;
+}
+
+// The canonical grid of a key
+static Grid *shape_key_grid(const ShapeKey *k) {
+    Grid *g = allocate_grid(k->rows, k->cols);
+    for (int bit = 0; bit < k->rows * k->cols; bit++) {
+        g->blocked[bit / k->cols][bit % k->cols] = k->bits[bit >> 6] >> (bit & 63) & 1;
+    }
+    refresh_grid(g);
+    return g;
+}
+
+static uint64_t shape_key_hash(const ShapeKey *k) {
+    uint64_t h = cell_hash(((uint64_t)(uint32_t)k->rows << 32) | (uint32_t)k->cols);
+    h = cell_hash(h ^ (uint32_t)k->movement_points);
+    for (int i = 0; i < SHAPE_WORDS; i++) h = cell_hash(h ^ k->bits[i]);
+    return h;
+}
+
+ShapeCache *create_shape_cache(void) {
+    ShapeCache *cache = (ShapeCache*)calloc(1, sizeof(ShapeCache));
+    if (cache) {
+        cache->index_size = 64;
+        cache->index = (int*)malloc(cache->index_size * sizeof(int));
+    }
+    if (!cache || !cache->index) {
+        fprintf(stderr, "Memory allocation failed for ShapeCache\n");
+        exit(1);
+    }
+    for (int i = 0; i < cache->index_size; i++) cache->index[i] = -1;
+    return cache;
+}
+
+void free_shape_cache(ShapeCache *cache) {
+    if (!cache) return;
+    for (int i = 0; i < cache->count; i++) free(cache->entries[i].path);
+    free(cache->entries);
+    free(cache->index);
+    free(cache);
+}
+
+// Counters of the cache and the memory it holds; any output may be NULL
+void shape_cache_stats(const ShapeCache *cache, long *hits, long *misses, int *entries, size_t *bytes) {
+    if (hits) *hits = cache->hits;
+    if (misses) *misses = cache->misses;
+    if (entries) *entries = cache->count;
+    if (bytes) {
+        size_t n = sizeof(ShapeCache) + (size_t)cache->capacity * sizeof(ShapeEntry) +
+                   (size_t)cache->index_size * sizeof(int);
+        for (int i = 0; i < cache->count; i++) n += (size_t)cache->entries[i].length * 2 * sizeof(int);
+        *bytes = n;
+    }
+}
+
+// Slot of key in the index: either holding its entry or the empty slot to insert at
+static int shape_cache_slot(const ShapeCache *cache, const ShapeKey *key) {
+    int mask = cache->index_size - 1;
+    int slot = (int)(shape_key_hash(key) & (uint64_t)mask);
+    while (cache->index[slot] >= 0 && !shape_key_equal(&cache->entries[cache->index[slot]].key, key)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static void shape_cache_add(ShapeCache *cache, const ShapeKey *key, int *path, int length, int unique_count) {
+    if (cache->count == cache->capacity) {
+        cache->capacity = cache->capacity ? cache->capacity * 2 : 64;
+        cache->entries = (ShapeEntry*)realloc(cache->entries, cache->capacity * sizeof(ShapeEntry));
+        if (!cache->entries) {
+            fprintf(stderr, "Memory allocation failed for %d shape entries\n", cache->capacity);
+            exit(1);
+        }
+    }
+    if (2 * (cache->count + 1) > cache->index_size) {
+        free(cache->index);
+        cache->index_size *= 2;
+        cache->index = (int*)malloc(cache->index_size * sizeof(int));
+        if (!cache->index) {
+            fprintf(stderr, "Memory allocation failed for shape index\n");
+            exit(1);
+        }
+        for (int i = 0; i < cache->index_size; i++) cache->index[i] = -1;
+        for (int i = 0; i < cache->count; i++) cache->index[shape_cache_slot(cache, &cache->entries[i].key)] = i;
+    }
+    ShapeEntry *e = &cache->entries[cache->count];
+    e->key = *key;
+    e->path = path;
+    e->length = length;
+    e->unique_count = unique_count;
+    cache->index[shape_cache_slot(cache, key)] = cache->count++;
+}
+
+// Plan for g's shape class and budget, mapped into g's orientation
+bool shape_cache_lookup(ShapeCache *cache, const Grid *g, int movement_points, PathResult *res) {
+    ShapeKey key;
+    int t;
+    if (!shape_canonicalize(g, movement_points, &key, &t)) return false;
+    int i = cache->index[shape_cache_slot(cache, &key)];
+    if (i < 0) {
+        cache->misses++;
+        return false;
+    }
+    const ShapeEntry *e = &cache->entries[i];
+    path_result_reserve(res, e->length > 0 ? e->length : 1);
+    for (int p = 0; p < e->length; p++) {
+        shape_untransform(t, g->rows, g->cols, e->path[2 * p], e->path[2 * p + 1], &res->path_r[p], &res->path_c[p]);
+    }
+    res->length = e->length;
+    res->unique_count = e->unique_count;
+    res->weight = e->unique_count;  // shared shapes are unweighted
+    res->upper_bound = 0;
+    cache->hits++;
+    return true;
+}
+
+// Offer the plan res, in the coordinates of a rows x cols grid that symmetry t maps
+// onto key; it replaces the stored one only if it covers more cells (or the same
+// number in fewer moves). Plans that do not begin at the canonical start are ignored.
+static void shape_cache_offer(ShapeCache *cache, const ShapeKey *key, int t, int rows, int cols,
+                              const PathResult *res) {
+    if (res->length > 0) {
+        int r0, c0;
+        shape_transform(t, rows, cols, res->path_r[0], res->path_c[0], &r0, &c0);
+        if (r0 != key->start_r || c0 != key->start_c) return;
+    }
+    int i = cache->index[shape_cache_slot(cache, key)];
+    if (i >= 0) {
+        const ShapeEntry *e = &cache->entries[i];
+        if (res->unique_count < e->unique_count ||
+            (res->unique_count == e->unique_count && res->length >= e->length)) return;
+    }
+    int *path = (int*)malloc(((size_t)res->length * 2 + 1) * sizeof(int));
+    if (!path) {
+        fprintf(stderr, "Memory allocation failed for shape plan\n");
+        exit(1);
+    }
+    for (int p = 0; p < res->length; p++) {
+        shape_transform(t, rows, cols, res->path_r[p], res->path_c[p], &path[2 * p], &path[2 * p + 1]);
+    }
+    if (i >= 0) {
+        ShapeEntry *e = &cache->entries[i];
+        free(e->path);
+        e->path = path;
+        e->length = res->length;
+        e->unique_count = res->unique_count;
+    } else {
+        shape_cache_add(cache, key, path, res->length, res->unique_count);
+    }
+}
+
+// Offer a plan for g. Only a plan that begins at the image of the canonical start
+// (as the plans returned by lookups do) can be shared, so others are ignored.
+void shape_cache_store(ShapeCache *cache, const Grid *g, int movement_points, const PathResult *res) {
+    ShapeKey key;
+    int t;
+    if (!shape_canonicalize(g, movement_points, &key, &t)) return;
+    shape_cache_offer(cache, &key, t, g->rows, g->cols, res);
+}
+
+// Answer from the shape cache, or solve the canonical form of g's shape with
+// strategy, remember the plan and map it into g's orientation. Grids too large
+// (or weighted) for the cache are solved directly.
+void solve_path_shape_cached(ShapeCache *cache, const Grid *g, int movement_points, Strategy strategy,
+                             SolveContext *ctx, PathResult *res) {
+    if (movement_points < 0) movement_points = 0;
+    if (shape_cache_lookup(cache, g, movement_points, res)) {
+        if (ctx->compute_bound) res->upper_bound = coverage_upper_bound(g, movement_points).best;
+        return;
+    }
+    ShapeKey key;
+    int t;
+    if (!shape_canonicalize(g, movement_points, &key, &t)) {
+        solve_path_strategy(g, movement_points, strategy, ctx, res);
+        return;
+    }
+    Grid *canonical = shape_key_grid(&key);
+    solve_path_strategy(canonical, movement_points, strategy, ctx, res);
+    shape_cache_offer(cache, &key, 0, canonical->rows, canonical->cols, res);
+    for (int p = 0; p < res->length; p++) {
+        shape_untransform(t, g->rows, g->cols, res->path_r[p], res->path_c[p], &res->path_r[p], &res->path_c[p]);
+    }
+    free_grid(canonical);
+}
+
+bool save_shape_cache(const ShapeCache *cache, const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "Cannot open %s for writing\n", path);
+        return false;
+    }
+    int32_t count = cache->count;
+    bool ok = fwrite(SHAPE_CACHE_MAGIC, 8, 1, f) == 1 && fwrite(&count, sizeof(count), 1, f) == 1;
+    for (int i = 0; i < cache->count && ok; i++) {
+        const ShapeEntry *e = &cache->entries[i];
+        int32_t header[7] = {e->key.rows, e->key.cols, e->key.movement_points, e->key.start_r, e->key.start_c,
+                             e->length, e->unique_count};
+        ok = fwrite(header, sizeof(header), 1, f) == 1 &&
+             fwrite(e->key.bits, sizeof(e->key.bits), 1, f) == 1 &&
+             (e->length == 0 || fwrite(e->path, sizeof(int) * 2 * e->length, 1, f) == 1);
+    }
+    if (fclose(f) != 0) ok = false;
+    if (!ok) fprintf(stderr, "Failed writing shape cache %s\n", path);
+    return ok;
+}
+
+// Whether a loaded entry is one save_shape_cache could have written: a plan of at
+// most movement_points moves over free cells of the key's grid, from its start cell
+static bool shape_entry_valid(const ShapeKey *key, const int *plan, int length, int unique_count) {
+    int start_r, start_c;
+    if (key->rows < 1 || key->rows > SMALL_GRID_MAX || key->cols < 1 || key->cols > SMALL_GRID_MAX ||
+        key->movement_points < 0 || length < 0 || (long)length > (long)key->movement_points + 1 ||
+        unique_count < 0 || unique_count > length || (length > 0) != (unique_count > 0)) return false;
+    int cells = key->rows * key->cols;
+    for (int bit = cells; bit < SHAPE_WORDS * 64; bit++) {
+        if (key->bits[bit >> 6] >> (bit & 63) & 1) return false;
+    }
+    shape_key_start(key, &start_r, &start_c);
+    if (key->start_r != start_r || key->start_c != start_c) return false;
+    if (start_r < 0) return length == 0;
+    if (length > 0 && (plan[0] != key->start_r || plan[1] != key->start_c)) return false;
+    for (int p = 0; p < length; p++) {
+        int r = plan[2 * p], c = plan[2 * p + 1];
+        if (r < 0 || r >= key->rows || c < 0 || c >= key->cols) return false;
+        int bit = r * key->cols + c;
+        if (key->bits[bit >> 6] >> (bit & 63) & 1) return false;
+        if (p > 0 && abs(r - plan[2 * p - 2]) + abs(c - plan[2 * p - 1]) != 1) return false;
+    }
+    return true;
+}
+
+// Load a cache written by save_shape_cache; NULL if the file is missing or invalid.
+// Every entry is validated, so a corrupt or truncated file is rejected as a whole.
+ShapeCache *load_shape_cache(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    char magic[8];
+    int32_t count;
+    struct stat st;
+    if (fstat(fileno(f), &st) != 0 || fread(magic, 8, 1, f) != 1 || memcmp(magic, SHAPE_CACHE_MAGIC, 8) != 0 ||
+        fread(&count, sizeof(count), 1, f) != 1 || count < 0) {
+        fprintf(stderr, "%s is not a shape cache file\n", path);
+        fclose(f);
+        return NULL;
+    }
+    ShapeCache *cache = create_shape_cache();
+    for (int i = 0; i < count; i++) {
+        int32_t header[7];
+        ShapeKey key;
+        memset(&key, 0, sizeof(key));
+        if (fread(header, sizeof(header), 1, f) != 1 || fread(key.bits, sizeof(key.bits), 1, f) != 1) {
+            fprintf(stderr, "Shape cache %s is truncated at entry %d of %d\n", path, i, count);
+            break;
+        }
+        key.rows = header[0];
+        key.cols = header[1];
+        key.movement_points = header[2];
+        key.start_r = header[3];
+        key.start_c = header[4];
+        int length = header[5];
+        if (length < 0) {
+            fprintf(stderr, "Shape cache %s has an invalid entry %d\n", path, i);
+            break;
+        }
+        // Checked before allocating, so a corrupt length cannot request more than the file holds
+        long offset = ftell(f);
+        if (offset < 0 || (long long)length * 2 * (long long)sizeof(int) > (long long)(st.st_size - offset)) {
+            fprintf(stderr, "Shape cache %s is truncated at entry %d of %d\n", path, i, count);
+            break;
+        }
+        int *plan = (int*)malloc(((size_t)length * 2 + 1) * sizeof(int));
+        if (!plan) {
+            fprintf(stderr, "Memory allocation failed for shape plan\n");
+            exit(1);
+        }
+        if (length > 0 && fread(plan, sizeof(int) * 2 * length, 1, f) != 1) {
+            fprintf(stderr, "Shape cache %s is truncated at entry %d of %d\n", path, i, count);
+            free(plan);
+            break;
+        }
+        if (!shape_entry_valid(&key, plan, length, header[6])) {
+            fprintf(stderr, "Shape cache %s has an invalid entry %d\n", path, i);
+            free(plan);
+            break;
+        }
+        if (cache->index[shape_cache_slot(cache, &key)] >= 0) {
+            fprintf(stderr, "Shape cache %s repeats the key of entry %d\n", path, i);
+            free(plan);
+            break;
+        }
+        shape_cache_add(cache, &key, plan, length, header[6]);
+    }
+    fclose(f);
+    if (cache->count != count) {
+        free_shape_cache(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+// ---------------------------------------------------------------------------
+// Copy-on-write grid snapshots.
+//
+// A GridStore publishes immutable versions of a grid. Each version is a Grid
+// whose row pointers point into shared bands of SNAPSHOT_BAND rows; an update
+// copies only the bands it touches (and their neighbors when neighbor masks
+// change across a band edge), then swaps the new version in atomically. Readers
+// pin the current version with a hazard slot and can solve on it without locks
+// while writers keep publishing; retired versions are freed once no slot pins them.
+// ---------------------------------------------------------------------------
+
+#define SNAPSHOT_BAND 64
+#define SNAPSHOT_READER_SLOTS 64
+
+typedef struct {
+    int refs;                  // versions using this band (writer lock held)
+    bool *blocked;             // rows * cols
+    unsigned char *nbr_mask;   // rows * mask_stride(cols)
+} GridBand;
+
+typedef struct GridVersion {
+    Grid grid;                 // blocked/nbr_mask rows point into bands; no pyramid
+    GridBand **bands;
+    uint64_t version;
+    struct GridVersion *retired_next;
+} GridVersion;
+
+struct GridStore {
+    _Atomic(GridVersion*) current;
+    _Atomic(GridVersion*) hazard[SNAPSHOT_READER_SLOTS];
+    pthread_mutex_t writer_lock;
+    GridVersion *retired;      // replaced versions awaiting reclamation (writer lock held)
+    int band_count;
+    long published, reclaimed;
+};
+
+// Marks a reader slot that is taken but not yet pointing at a version
+#define HAZARD_RESERVED ((GridVersion*)1)
+
+static GridBand *create_grid_band(int rows, int cols) {
+    GridBand *b = (GridBand*)calloc(1, sizeof(GridBand));
+    if (b) {
+        b->blocked = (bool*)malloc((size_t)rows * cols * sizeof(bool) + 1);
+        b->nbr_mask = (unsigned char*)malloc((size_t)rows * mask_stride(cols) + 1);
+    }
+    if (!b || !b->blocked || !b->nbr_mask) {
+        fprintf(stderr, "Memory allocation failed for grid band\n");
+        exit(1);
+    }
+    return b;
+}
+
+static void band_release(GridBand *b) {
+    if (--b->refs > 0) return;
+    free(b->blocked);
+    free(b->nbr_mask);
+    free(b);
+}
+
+// Number of rows in band of g
+static int band_rows(const Grid *g, int band) {
+    int n = g->rows - band * SNAPSHOT_BAND;
+    return n < SNAPSHOT_BAND ? n : SNAPSHOT_BAND;
+}
+
+// Point the rows of band at its storage in version v
+static void version_map_band(GridVersion *v, int band) {
+    Grid *g = &v->grid;
+    int n = band_rows(g, band);
+    for (int i = 0; i < n; i++) {
+        int r = band * SNAPSHOT_BAND + i;
+        g->blocked[r] = v->bands[band]->blocked + (size_t)i * g->cols;
+        g->nbr_mask[r] = v->bands[band]->nbr_mask + (size_t)i * mask_stride(g->cols);
+    }
+}
+
+static GridVersion *create_grid_version(int rows, int cols, int band_count) {
+    GridVersion *v = (GridVersion*)calloc(1, sizeof(GridVersion));
+    if (v) {
+        v->grid.rows = rows;
+        v->grid.cols = cols;
+        v->grid.blocked = (bool**)malloc((rows + 1) * sizeof(bool*));
+        v->grid.nbr_mask = (unsigned char**)malloc((rows + 1) * sizeof(unsigned char*));
+        v->bands = (GridBand**)malloc((band_count + 1) * sizeof(GridBand*));
+    }
+    if (!v || !v->grid.blocked || !v->grid.nbr_mask || !v->bands) {
+        fprintf(stderr, "Memory allocation failed for grid version\n");
+        exit(1);
+    }
+    return v;
+}
+
+static void free_grid_version(GridVersion *v, int band_count) {
+    for (int b = 0; b < band_count; b++) band_release(v->bands[b]);
+    free(v->bands);
+    free(v->grid.blocked);
+    free(v->grid.nbr_mask);
+    free_grid_analysis(v->grid.analysis);  // built by a dead-ends solve on the snapshot
+    free_interval_grid(v->grid.intervals);  // built by a sweep solve on the snapshot
+    free(v);
+}
+
+// Create a store whose first version is a copy of g
+GridStore *create_grid_store(const Grid *g) {
+    GridStore *store = (GridStore*)calloc(1, sizeof(GridStore));
+    if (!store) {
+        fprintf(stderr, "Memory allocation failed for GridStore\n");
+        exit(1);
+    }
+    store->band_count = (g->rows + SNAPSHOT_BAND - 1) / SNAPSHOT_BAND;
+    GridVersion *v = create_grid_version(g->rows, g->cols, store->band_count);
+    int stride = mask_stride(g->cols);
+    for (int b = 0; b < store->band_count; b++) {
+        int n = band_rows(g, b);
+        v->bands[b] = create_grid_band(n, g->cols);
+        v->bands[b]->refs = 1;
+        for (int i = 0; i < n; i++) {
+            memcpy(v->bands[b]->blocked + (size_t)i * g->cols, g->blocked[b * SNAPSHOT_BAND + i], g->cols * sizeof(bool));
+            memcpy(v->bands[b]->nbr_mask + (size_t)i * stride, g->nbr_mask[b * SNAPSHOT_BAND + i], stride);
+        }
+        version_map_band(v, b);
+    }
+    v->grid.hash = g->hash;
+    pthread_mutex_init(&store->writer_lock, NULL);
+    atomic_init(&store->current, v);
+    for (int i = 0; i < SNAPSHOT_READER_SLOTS; i++) atomic_init(&store->hazard[i], NULL);
+    store->published = 1;
+    return store;
+}
+
+// Free retired versions that no reader slot pins; writer lock must be held
+static void grid_store_reclaim_locked(GridStore *store) {
+    GridVersion **link = &store->retired;
+    while (*link) {
+        GridVersion *v = *link;
+        bool pinned = false;
+        for (int i = 0; i < SNAPSHOT_READER_SLOTS && !pinned; i++) {
+            pinned = atomic_load(&store->hazard[i]) == v;
+        }
+        if (pinned) {
+            link = &v->retired_next;
+            continue;
+        }
+        *link = v->retired_next;
+        free_grid_version(v, store->band_count);
+        store->reclaimed++;
+    }
+}
+
+void free_grid_store(GridStore *store) {
+    if (!store) return;
+    pthread_mutex_lock(&store->writer_lock);
+    for (GridVersion *v = store->retired; v;) {
+        GridVersion *next = v->retired_next;
+        free_grid_version(v, store->band_count);
+        v = next;
+    }
+    free_grid_version(atomic_load(&store->current), store->band_count);
+    pthread_mutex_unlock(&store->writer_lock);
+    pthread_mutex_destroy(&store->writer_lock);
+    free(store);
+}
+
+// Pin the current version for reading. Returns the reader slot to pass to
+// grid_store_unpin (or -1 if all slots are busy) and the pinned grid in *grid.
+// The grid stays valid and unchanged until it is unpinned.
+int grid_store_pin(GridStore *store, const Grid **grid) {
+    int slot = -1;
+    for (int i = 0; i < SNAPSHOT_READER_SLOTS && slot < 0; i++) {
+        GridVersion *expected = NULL;
+        if (atomic_compare_exchange_strong(&store->hazard[i], &expected, HAZARD_RESERVED)) slot = i;
+    }
+    if (slot < 0) return -1;
+    GridVersion *v;
+    do {
+        v = atomic_load(&store->current);
+        atomic_store(&store->hazard[slot], v);
+    } while (atomic_load(&store->current) != v);
+    *grid = &v->grid;
+    return slot;
+}
+
+// Version number of the grid pinned in slot
+uint64_t grid_store_pinned_version(GridStore *store, int slot) {
+    return atomic_load(&store->hazard[slot])->version;
+}
+
+void grid_store_unpin(GridStore *store, int slot) {
+    if (slot < 0) return;
+    atomic_store(&store->hazard[slot], NULL);
+    // Reclaim opportunistically; a busy writer will do it on its next publish
+    if (pthread_mutex_trylock(&store->writer_lock) == 0) {
+        grid_store_reclaim_locked(store);
+        pthread_mutex_unlock(&store->writer_lock);
+    }
+}
+
+// Give the new version a private copy of band b before it is modified
+static void version_own_band(GridVersion *v, bool *owned, int band) {
+    if (owned[band]) return;
+    Grid *g = &v->grid;
+    GridBand *old = v->bands[band];
+    int n = band_rows(g, band);
+    GridBand *copy = create_grid_band(n, g->cols);
+    copy->refs = 1;
+    memcpy(copy->blocked, old->blocked, (size_t)n * g->cols * sizeof(bool));
+    memcpy(copy->nbr_mask, old->nbr_mask, (size_t)n * mask_stride(g->cols));
+    old->refs--;  // still referenced by the version being replaced
+    v->bands[band] = copy;
+    version_map_band(v, band);
+    owned[band] = true;
+}
+
+// Apply count cell updates (cells[i] becomes blocked[i]) as one new version and
+// publish it. Only the touched bands are copied. Returns the new version number.
+uint64_t grid_store_update(GridStore *store, const int cells[][2], const bool blocked[], int count) {
+    pthread_mutex_lock(&store->writer_lock);
+    GridVersion *old = atomic_load(&store->current);
+    const Grid *og = &old->grid;
+    GridVersion *v = create_grid_version(og->rows, og->cols, store->band_count);
+    memcpy(v->bands, old->bands, store->band_count * sizeof(GridBand*));
+    memcpy(v->grid.blocked, og->blocked, og->rows * sizeof(bool*));
+    memcpy(v->grid.nbr_mask, og->nbr_mask, og->rows * sizeof(unsigned char*));
+    for (int b = 0; b < store->band_count; b++) v->bands[b]->refs++;
+    v->grid.hash = og->hash;
+    v->version = old->version + 1;
+
+    bool *owned = (bool*)calloc(store->band_count + 1, sizeof(bool));
+    if (!owned) {
+        fprintf(stderr, "Memory allocation failed for band ownership\n");
+        exit(1);
+    }
+    for (int i = 0; i < count; i++) {
+        int r = cells[i][0], c = cells[i][1];
+        if (r < 0 || r >= og->rows || c < 0 || c >= og->cols) continue;
+        if (v->grid.blocked[r][c] == blocked[i]) continue;
+        // set_blocked writes the cell's row and the neighbor masks of rows r - 1 .. r + 1
+        for (int rr = r - 1; rr <= r + 1; rr++) {
+            if (rr >= 0 && rr < og->rows) version_own_band(v, owned, rr / SNAPSHOT_BAND);
+        }
+        set_blocked(&v->grid, r, c, blocked[i]);
+    }
+    free(owned);
+
+    atomic_store(&store->current, v);
+    old->retired_next = store->retired;
+    store->retired = old;
+    store->published++;
+    grid_store_reclaim_locked(store);
+    uint64_t version = v->version;
+    pthread_mutex_unlock(&store->writer_lock);
+    return version;
+}
+
+// ---------------------------------------------------------------------------
+// Binary grid images and shared-memory hosting.
+//
+// A grid image is one contiguous block: a GridImageHeader followed by the
+// blocked cells (one byte per cell), the neighbor masks and the blocked pyramid,
+// each 8-byte aligned. Images can be saved to files or published into POSIX
+// shared memory, where other processes map them read-only and get a Grid whose
+// rows point straight into the segment.
+//
+// Publishing under a name creates a data segment "<name>.<version>" and bumps
+// the version in a small control segment "<name>"; attached processes can wait
+// on that version (a futex on Linux) and re-attach to the new data segment.
+// ---------------------------------------------------------------------------
+
+#define GRID_IMAGE_MAGIC "GTGRID01"
+#define SHARED_GRID_MAGIC "GTSHMCT1"
+
+typedef struct {
+    char magic[8];
+    int32_t rows, cols;
+    uint64_t hash;
+    uint64_t blocked_offset, mask_offset, leaf_offset, count_offset;
+    uint64_t size;  // bytes in the whole image
+} GridImageHeader;
+
+typedef struct {
+    char magic[8];
+    _Atomic uint32_t version;  // futex word, 0 until the first publish
+} SharedGridControl;
+
+// A grid viewed in place over an image; the Grid must not be passed to free_grid
+struct GridImageView {
+    Grid grid;
+    BitPyramid pyramid;         // levels point into the image
+    void *base;
+    size_t size;
+    bool mapped;                // base is an mmap to release
+    char name[200];             // shared segment name, "" for other images
+    uint32_t version;
+    SharedGridControl *control; // mapped control segment, NULL for other images
+};
+
+static uint64_t align8(uint64_t n) {
+    return (n + 7) & ~(uint64_t)7;
+}
+
+// Fill in the header (offsets and size) of the image of g with blocked pyramid p
+static void grid_image_layout(const Grid *g, const BitPyramid *p, GridImageHeader *h) {
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, GRID_IMAGE_MAGIC, 8);
+    h->rows = g->rows;
+    h->cols = g->cols;
+    h->hash = g->hash;
+    uint64_t cells = (uint64_t)g->rows * g->cols;
+    h->blocked_offset = align8(sizeof(GridImageHeader));
+    h->mask_offset = align8(h->blocked_offset + cells);
+    h->leaf_offset = align8(h->mask_offset + (uint64_t)g->rows * mask_stride(g->cols));
+    uint64_t leaf_words = (uint64_t)p->level_rows[0] * p->level_cols[0] + 1;  // with the sentinel word
+    h->count_offset = h->leaf_offset + leaf_words * sizeof(uint64_t);
+    uint64_t counts = 0;
+    for (int k = 1; k < p->levels; k++) counts += (uint64_t)p->level_rows[k] * p->level_cols[k];
+    h->size = align8(h->count_offset + counts * sizeof(uint32_t));
+}
+
+// Write the image of g into dst of grid_image_layout size
+static void write_grid_image(const Grid *g, const BitPyramid *p, const GridImageHeader *h, unsigned char *dst) {
+    memcpy(dst, h, sizeof(*h));
+    int stride = mask_stride(g->cols);
+    for (int r = 0; r < g->rows; r++) {
+        memcpy(dst + h->blocked_offset + (uint64_t)r * g->cols, g->blocked[r], g->cols * sizeof(bool));
+        memcpy(dst + h->mask_offset + (uint64_t)r * stride, g->nbr_mask[r], stride);
+    }
+    memcpy(dst + h->leaf_offset, p->leaf, ((size_t)p->level_rows[0] * p->level_cols[0] + 1) * sizeof(uint64_t));
+    unsigned char *out = dst + h->count_offset;
+    for (int k = 1; k < p->levels; k++) {
+        size_t n = (size_t)p->level_rows[k] * p->level_cols[k] * sizeof(uint32_t);
+        memcpy(out, p->count[k], n);
+        out += n;
+    }
+}
+
+// The blocked pyramid to store for g, built on the side for grids without one
+static BitPyramid *grid_image_pyramid(const Grid *g) {
+    return g->blocked_pyramid ? g->blocked_pyramid : build_blocked_pyramid(g->blocked, g->rows, g->cols);
+}
+
+// Set up view->grid over an image at base; false if the image is malformed. The
+// layout is recomputed from rows and cols and must match the header exactly, so
+// no offset read from the image can point outside it.
+static bool grid_image_view_init(GridImageView *view, void *base, size_t size) {
+    const GridImageHeader *h = (const GridImageHeader*)base;
+    // The blocked bytes alone take rows * cols, which bounds the pyramid built below
+    if (size < sizeof(GridImageHeader) || memcmp(h->magic, GRID_IMAGE_MAGIC, 8) != 0 ||
+        h->rows <= 0 || h->cols <= 0 || (uint64_t)h->rows * h->cols > size) {
+        return false;
+    }
+    BitPyramid *shape = create_bit_pyramid(h->rows, h->cols);
+    Grid dims = {0};
+    dims.rows = h->rows;
+    dims.cols = h->cols;
+    dims.hash = h->hash;
+    GridImageHeader expect;
+    grid_image_layout(&dims, shape, &expect);
+    unsigned char *bytes = (unsigned char*)base;
+    bool valid = h->blocked_offset == expect.blocked_offset && h->mask_offset == expect.mask_offset &&
+                 h->leaf_offset == expect.leaf_offset && h->count_offset == expect.count_offset &&
+                 h->size == expect.size && expect.size <= size;
+    // Blocked cells are read as bool, so anything but 0 or 1 is corrupt
+    for (uint64_t i = 0; valid && i < (uint64_t)h->rows * h->cols; i++) valid = bytes[expect.blocked_offset + i] <= 1;
+    if (!valid) {
+        free_bit_pyramid(shape);
+        return false;
+    }
+    Grid *g = &view->grid;
+    g->rows = h->rows;
+    g->cols = h->cols;
+    g->hash = h->hash;
+    g->blocked = (bool**)malloc((g->rows + 1) * sizeof(bool*));
+    g->nbr_mask = (unsigned char**)malloc((g->rows + 1) * sizeof(unsigned char*));
+    if (!g->blocked || !g->nbr_mask) {
+        fprintf(stderr, "Memory allocation failed for grid image rows\n");
+        exit(1);
+    }
+    int stride = mask_stride(g->cols);
+    for (int r = 0; r < g->rows; r++) {
+        g->blocked[r] = (bool*)(bytes + h->blocked_offset + (uint64_t)r * g->cols);
+        g->nbr_mask[r] = bytes + h->mask_offset + (uint64_t)r * stride;
+    }
+    // Borrow the level geometry of the fresh pyramid and point its data into the image
+    BitPyramid *p = &view->pyramid;
+    *p = *shape;
+    free(shape->leaf);
+    for (int k = 1; k < shape->levels; k++) free(shape->count[k]);
+    free(shape);
+    p->leaf = (uint64_t*)(bytes + h->leaf_offset);
+    unsigned char *counts = bytes + h->count_offset;
+    for (int k = 1; k < p->levels; k++) {
+        p->count[k] = (uint32_t*)counts;
+        counts += (size_t)p->level_rows[k] * p->level_cols[k] * sizeof(uint32_t);
+    }
+    p->total = 0;
+    for (size_t i = 0; i < (size_t)p->level_rows[0] * p->level_cols[0]; i++) p->total += __builtin_popcountll(p->leaf[i]);
+    g->blocked_pyramid = p;
+    view->base = base;
+    view->size = size;
+    return true;
+}
+
+static void grid_image_view_release(GridImageView *view) {
+    free_grid_analysis(view->grid.analysis);
+    free_interval_grid(view->grid.intervals);
+    free(view->grid.blocked);
+    free(view->grid.nbr_mask);
+    free(view->pyramid.count);
+    free(view->pyramid.level_rows);
+    free(view->pyramid.level_cols);
+    if (view->mapped) munmap(view->base, view->size);
+    view->grid.analysis = NULL;
+    view->grid.intervals = NULL;
+    view->grid.blocked = NULL;
+    view->grid.nbr_mask = NULL;
+    view->pyramid.count = NULL;
+    view->pyramid.level_rows = view->pyramid.level_cols = NULL;
+    view->mapped = false;
+}
+
+// Save g as a binary grid image
+bool save_grid_binary(const Grid *g, const char *path) {
+    BitPyramid *p = grid_image_pyramid(g);
+    GridImageHeader h;
+    grid_image_layout(g, p, &h);
+    unsigned char *image = (unsigned char*)calloc(1, h.size);
+    if (!image) {
+        fprintf(stderr, "Memory allocation failed for grid image\n");
+        exit(1);
+    }
+    write_grid_image(g, p, &h, image);
+    if (p != g->blocked_pyramid) free_bit_pyramid(p);
+    FILE *f = fopen(path, "wb");
+    bool ok = f && fwrite(image, h.size, 1, f) == 1;
+    if (f && fclose(f) != 0) ok = false;
+    if (!ok) fprintf(stderr, "Failed writing grid image %s\n", path);
+    free(image);
+    return ok;
+}
+
+// Map a binary grid image file read-only; the rows point into the mapping
+GridImageView *map_grid_binary(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open grid image %s\n", path);
+        return NULL;
+    }
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Cannot map grid image %s\n", path);
+        return NULL;
+    }
+    GridImageView *view = (GridImageView*)calloc(1, sizeof(GridImageView));
+    if (!view) {
+        fprintf(stderr, "Memory allocation failed for GridImageView\n");
+        exit(1);
+    }
+    if (!grid_image_view_init(view, base, st.st_size)) {
+        fprintf(stderr, "%s is not a grid image\n", path);
+        munmap(base, st.st_size);
+        free(view);
+        return NULL;
+    }
+    view->mapped = true;
+    return view;
+}
+
+// The read-only grid of a mapped or attached view. It stays valid until the view
+// is reattached or detached.
+const Grid *grid_image_view_grid(const GridImageView *view) {
+    return &view->grid;
+}
+
+// Load a binary grid image file into a regular, mutable grid
+Grid *load_grid_binary(const char *path) {
+    GridImageView *view = map_grid_binary(path);
+    if (!view) return NULL;
+    Grid *g = allocate_grid(view->grid.rows, view->grid.cols);
+    for (int r = 0; r < g->rows; r++) memcpy(g->blocked[r], view->grid.blocked[r], g->cols * sizeof(bool));
+    refresh_grid(g);
+    grid_image_view_release(view);
+    free(view);
+    return g;
+}
+
+static void shared_data_name(char *out, size_t n, const char *name, uint32_t version) {
+    snprintf(out, n, "%s.%u", name, version);
+}
+
+static SharedGridControl *map_shared_control(const char *name, bool create) {
+    int fd = shm_open(name, create ? O_RDWR | O_CREAT : O_RDWR, 0644);
+    if (fd < 0) return NULL;
+    if (create && ftruncate(fd, sizeof(SharedGridControl)) != 0) {
+        close(fd);
+        return NULL;
+    }
+    void *p = mmap(NULL, sizeof(SharedGridControl), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return NULL;
+    SharedGridControl *control = (SharedGridControl*)p;
+    if (create && memcmp(control->magic, SHARED_GRID_MAGIC, 8) != 0) {
+        memcpy(control->magic, SHARED_GRID_MAGIC, 8);
+        atomic_store(&control->version, 0);
+    }
+    return control;
+}
+
+static void futex_wake_all(_Atomic uint32_t *word) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+#else
+    (void)word;
+#endif
+}
+
+// Publish g under a shared-memory name (e.g. "/site-map"). Processes attached to the
+// name are woken and can move to the new version. Returns the new version, 0 on error.
+uint32_t publish_shared_grid(const char *name, const Grid *g) {
+    SharedGridControl *control = map_shared_control(name, true);
+    if (!control) {
+        fprintf(stderr, "Cannot create shared grid control segment %s\n", name);
+        return 0;
+    }
+    uint32_t old_version = atomic_load(&control->version);
+    uint32_t version = old_version + 1;
+    char data_name[256];
+    shared_data_name(data_name, sizeof(data_name), name, version);
+    BitPyramid *p = grid_image_pyramid(g);
+    GridImageHeader h;
+    grid_image_layout(g, p, &h);
+    int fd = shm_open(data_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    void *base = MAP_FAILED;
+    if (fd >= 0 && ftruncate(fd, h.size) == 0) base = mmap(NULL, h.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (fd >= 0) close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Cannot create shared grid segment %s\n", data_name);
+        shm_unlink(data_name);
+        munmap(control, sizeof(SharedGridControl));
+        if (p != g->blocked_pyramid) free_bit_pyramid(p);
+        return 0;
+    }
+    write_grid_image(g, p, &h, (unsigned char*)base);
+    if (p != g->blocked_pyramid) free_bit_pyramid(p);
+    munmap(base, h.size);
+    atomic_store(&control->version, version);
+    futex_wake_all(&control->version);
+    // Attached processes keep their mapping of the old segment; new ones see only the latest
+    if (old_version > 0) {
+        shared_data_name(data_name, sizeof(data_name), name, old_version);
+        shm_unlink(data_name);
+    }
+    munmap(control, sizeof(SharedGridControl));
+    return version;
+}
+
+// Map the latest version of a shared grid into view; false if none is published
+static bool shared_grid_map_latest(GridImageView *view) {
+    for (;;) {
+        uint32_t version = atomic_load(&view->control->version);
+        if (version == 0) return false;
+        char data_name[256];
+        shared_data_name(data_name, sizeof(data_name), view->name, version);
+        int fd = shm_open(data_name, O_RDONLY, 0);
+        if (fd < 0) {
+            // Replaced between reading the version and opening it: retry with the newer one
+            if (atomic_load(&view->control->version) != version) continue;
+            return false;
+        }
+        struct stat st;
+        void *base = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) return false;
+        if (!grid_image_view_init(view, base, st.st_size)) {
+            munmap(base, st.st_size);
+            return false;
+        }
+        view->mapped = true;
+        view->version = version;
+        return true;
+    }
+}
+
+// Attach read-only to a grid published under name. The grid's cells are not copied.
+GridImageView *attach_shared_grid(const char *name) {
+    GridImageView *view = (GridImageView*)calloc(1, sizeof(GridImageView));
+    if (!view) {
+        fprintf(stderr, "Memory allocation failed for GridImageView\n");
+        exit(1);
+    }
+    snprintf(view->name, sizeof(view->name), "%s", name);
+    view->control = map_shared_control(name, false);
+    if (!view->control || !shared_grid_map_latest(view)) {
+        if (view->control) munmap(view->control, sizeof(SharedGridControl));
+        free(view);
+        return NULL;
+    }
+    return view;
+}
+
+// Wait up to timeout_ms for a version newer than the attached one; true if there is one
+bool shared_grid_wait(GridImageView *view, int timeout_ms) {
+    uint32_t seen = view->version;
+    if (atomic_load(&view->control->version) != seen) return true;
+#ifdef __linux__
+    struct timespec ts = {timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L};
+    syscall(SYS_futex, (uint32_t*)&view->control->version, FUTEX_WAIT, seen, &ts, NULL, 0);
+#else
+    usleep((useconds_t)timeout_ms * 1000);
+#endif
+    return atomic_load(&view->control->version) != seen;
+}
+
+// Move an attached view to the latest published version. Grids obtained from the
+// view before the call must no longer be used. The new version is mapped before the
+// old one is released, so on failure the view stays attached to the old version.
+bool shared_grid_reattach(GridImageView *view) {
+    if (atomic_load(&view->control->version) == view->version) return true;
+    GridImageView next;
+    memset(&next, 0, sizeof(next));
+    memcpy(next.name, view->name, sizeof(next.name));
+    next.control = view->control;
+    if (!shared_grid_map_latest(&next)) return false;
+    grid_image_view_release(view);
+    *view = next;
+    view->grid.blocked_pyramid = &view->pyramid;
+    return true;
+}
+
+void detach_grid_view(GridImageView *view) {
+    if (!view) return;
+    grid_image_view_release(view);
+    if (view->control) munmap(view->control, sizeof(SharedGridControl));
+    free(view);
+}
+
+// Remove a published grid's name; attached processes keep their mappings
+void unlink_shared_grid(const char *name) {
+    SharedGridControl *control = map_shared_control(name, false);
+    if (control) {
+        char data_name[256];
+        shared_data_name(data_name, sizeof(data_name), name, atomic_load(&control->version));
+        shm_unlink(data_name);
+        munmap(control, sizeof(SharedGridControl));
+    }
+    shm_unlink(name);
+}
+
+// ---------------------------------------------------------------------------
+// Out-of-core solving for grids larger than RAM.
+//
+// A tiled grid file stores a TiledGridHeader followed by the obstacle map in
+// tile_size x tile_size tiles (row-major tile order, one bit per cell, 1 = blocked,
+// cells past the grid edge blocked). The solver pages tiles through an LRU cache
+// with a fixed memory cap; the visited bits are tiled the same way and spilled to
+// a temporary file. A read-ahead thread loads the tiles ahead of the direction of
+// travel, and finished loads are installed by the solver thread, so the caches
+// themselves are only ever touched by one thread.
+//
+// Resident tiles are found through a hash table sized to the cache, so the only
+// state kept for every tile of the file is the visited cache's spilled bit, and
+// the cap covers the cache metadata as well as the tile data.
+// ---------------------------------------------------------------------------
+
+#define TILED_GRID_MAGIC "GTTILES1"
+#define TILE_MIN_SIZE 32            // 128 bytes per tile, against a spilled bit
+#define READAHEAD_QUEUE 64
+#define READAHEAD_INFLIGHT (2 * READAHEAD_QUEUE)  // pending plus finished loads
+
+typedef struct {
+    char magic[8];
+    int32_t rows, cols;
+    int32_t tile_size;  // multiple of 8
+    int32_t reserved;
+} TiledGridHeader;
+
+typedef struct {
+    int fd;
+    off_t data_offset;          // file offset of tile 0
+    size_t tile_bytes;
+    long tile_count;
+    bool spill;                 // dirty tiles are written back; unspilled tiles read as zeros
+    int capacity;               // resident tiles
+    int used;
+    unsigned char *slot_data;   // capacity * tile_bytes
+    long *slot_tile;
+    bool *slot_dirty;
+    int *lru_prev, *lru_next;   // doubly linked, head = most recently used
+    int lru_head, lru_tail;
+    int *bucket;                // resident slots by tile hash, chained through slot_chain; -1 ends
+    int *slot_chain;
+    int bucket_bits;
+    uint64_t *spilled;          // bit per tile: the backing file holds its data (spill caches only)
+    long inflight[READAHEAD_INFLIGHT];  // tiles with a read-ahead load queued or finished
+    bool inflight_stale[READAHEAD_INFLIGHT];  // spilled since, so the load is out of date
+    int inflight_count;
+    long last_tile;             // one-entry lookup cache
+    int last_slot;
+    unsigned char *last_data;
+    long hits, misses, reads, writes, prefetched;
+} TileCache;
+
+typedef struct {
+    TileCache *cache;
+    long tile;
+    unsigned char *data;        // filled in by the read-ahead thread
+} TileRequest;
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    TileRequest pending[READAHEAD_QUEUE];
+    int pending_head, pending_count;
+    TileRequest done[READAHEAD_QUEUE];
+    int done_count;
+    atomic_int done_hint;       // done_count, readable without the lock
+    bool stop;
+} ReadAhead;
+
+// Read or write exactly len bytes at offset; false on I/O error
+static bool pread_full(int fd, void *buf, size_t len, off_t offset) {
+    unsigned char *p = (unsigned char*)buf;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return true;
+}
+
+static bool pwrite_full(int fd, const void *buf, size_t len, off_t offset) {
+    const unsigned char *p = (const unsigned char*)buf;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return true;
+}
+
+// Write the obstacle map of g as a tiled grid file
+bool save_tiled_grid(const Grid *g, const char *path, int tile_size) {
+    if (!g || tile_size < TILE_MIN_SIZE || tile_size % 8) return false;
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "Cannot open %s for writing\n", path);
+        return false;
+    }
+    TiledGridHeader h;
+    memcpy(h.magic, TILED_GRID_MAGIC, 8);
+    h.rows = g->rows;
+    h.cols = g->cols;
+    h.tile_size = tile_size;
+    h.reserved = 0;
+    size_t tile_bytes = (size_t)tile_size * tile_size / 8;
+    unsigned char *tile = (unsigned char*)malloc(tile_bytes);
+    if (!tile) {
+        fprintf(stderr, "Memory allocation failed for tile buffer\n");
+        exit(1);
+    }
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    int tiles_r = (g->rows + tile_size - 1) / tile_size;
+    int tiles_c = (g->cols + tile_size - 1) / tile_size;
+    for (int tr = 0; tr < tiles_r && ok; tr++) {
+        for (int tc = 0; tc < tiles_c && ok; tc++) {
+            memset(tile, 0, tile_bytes);
+            for (int lr = 0; lr < tile_size; lr++) {
+                for (int lc = 0; lc < tile_size; lc++) {
+                    int r = tr * tile_size + lr, c = tc * tile_size + lc;
+                    if (r >= g->rows || c >= g->cols || g->blocked[r][c]) {
+                        int bit = lr * tile_size + lc;
+                        tile[bit >> 3] |= (unsigned char)(1u << (bit & 7));
+                    }
+                }
+            }
+            ok = fwrite(tile, tile_bytes, 1, f) == 1;
+        }
+    }
+    free(tile);
+    if (fclose(f) != 0) ok = false;
+    if (!ok) fprintf(stderr, "Failed writing tiled grid %s\n", path);
+    return ok;
+}
+
+// Write a random tiled grid file without materializing the grid: each cell is
+// blocked with probability density. Uses rand(), so srand() makes it reproducible.
+bool generate_tiled_grid(const char *path, int rows, int cols, int tile_size, double density) {
+    if (rows <= 0 || cols <= 0 || tile_size < TILE_MIN_SIZE || tile_size % 8) return false;
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "Cannot open %s for writing\n", path);
+        return false;
+    }
+    TiledGridHeader h;
+    memcpy(h.magic, TILED_GRID_MAGIC, 8);
+    h.rows = rows;
+    h.cols = cols;
+    h.tile_size = tile_size;
+    h.reserved = 0;
+    size_t tile_bytes = (size_t)tile_size * tile_size / 8;
+    unsigned char *tile = (unsigned char*)malloc(tile_bytes);
+    if (!tile) {
+        fprintf(stderr, "Memory allocation failed for tile buffer\n");
+        exit(1);
+    }
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    // Clamped so a density of 1 blocks every cell; NaN blocks none
+    if (!(density > 0)) density = 0;
+    if (density > 1) density = 1;
+    double threshold = density * ((double)RAND_MAX + 1.0);
+    long tiles_r = (rows + tile_size - 1) / tile_size;
+    long tiles_c = (cols + tile_size - 1) / tile_size;
+    for (long tr = 0; tr < tiles_r && ok; tr++) {
+        for (long tc = 0; tc < tiles_c && ok; tc++) {
+            memset(tile, 0, tile_bytes);
+            for (int lr = 0; lr < tile_size; lr++) {
+                for (int lc = 0; lc < tile_size; lc++) {
+                    long r = tr * tile_size + lr, c = tc * tile_size + lc;
+                    if (r >= rows || c >= cols || rand() < threshold) {
+                        int bit = lr * tile_size + lc;
+                        tile[bit >> 3] |= (unsigned char)(1u << (bit & 7));
+                    }
+                }
+            }
+            ok = fwrite(tile, tile_bytes, 1, f) == 1;
+        }
+    }
+    free(tile);
+    if (fclose(f) != 0) ok = false;
+    if (!ok) fprintf(stderr, "Failed writing tiled grid %s\n", path);
+    return ok;
+}
+
+// Buckets for a cache of capacity tiles: a power of two, at least capacity
+static int tile_bucket_bits(long capacity) {
+    int bits = 0;
+    while (((long)1 << bits) < capacity) bits++;
+    return bits;
+}
+
+// Bytes a cache of capacity tiles takes, tile data and metadata together
+static size_t tile_cache_footprint(long capacity, size_t tile_bytes, long tile_count, bool spill) {
+    size_t per_slot = tile_bytes + sizeof(long) + sizeof(bool) + 3 * sizeof(int);
+    size_t bytes = sizeof(TileCache) + (size_t)capacity * per_slot + ((size_t)1 << tile_bucket_bits(capacity)) * sizeof(int);
+    if (spill) bytes += (size_t)((tile_count >> 6) + 1) * sizeof(uint64_t);
+    return bytes;
+}
+
+static void tile_cache_init(TileCache *tc, int fd, off_t data_offset, size_t tile_bytes,
+                            long tile_count, int capacity, bool spill) {
+    memset(tc, 0, sizeof(*tc));
+    tc->fd = fd;
+    tc->data_offset = data_offset;
+    tc->tile_bytes = tile_bytes;
+    tc->tile_count = tile_count;
+    tc->spill = spill;
+    tc->capacity = capacity;
+    tc->bucket_bits = tile_bucket_bits(capacity);
+    size_t buckets = (size_t)1 << tc->bucket_bits;
+    tc->slot_data = (unsigned char*)malloc((size_t)capacity * tile_bytes);
+    tc->slot_tile = (long*)malloc(capacity * sizeof(long));
+    tc->slot_dirty = (bool*)calloc(capacity, sizeof(bool));
+    tc->lru_prev = (int*)malloc(capacity * sizeof(int));
+    tc->lru_next = (int*)malloc(capacity * sizeof(int));
+    tc->slot_chain = (int*)malloc(capacity * sizeof(int));
+    tc->bucket = (int*)malloc(buckets * sizeof(int));
+    if (spill) tc->spilled = (uint64_t*)calloc((tile_count >> 6) + 1, sizeof(uint64_t));
+    if (!tc->slot_data || !tc->slot_tile || !tc->slot_dirty || !tc->lru_prev || !tc->lru_next ||
+        !tc->slot_chain || !tc->bucket || (spill && !tc->spilled)) {
+        fprintf(stderr, "Memory allocation failed for tile cache\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < buckets; i++) tc->bucket[i] = -1;
+    tc->lru_head = tc->lru_tail = -1;
+    tc->last_tile = -1;
+}
+
+static void tile_cache_release(TileCache *tc) {
+    free(tc->slot_data);
+    free(tc->slot_tile);
+    free(tc->slot_dirty);
+    free(tc->lru_prev);
+    free(tc->lru_next);
+    free(tc->slot_chain);
+    free(tc->bucket);
+    free(tc->spilled);
+}
+
+static inline size_t tile_bucket(const TileCache *tc, long tile) {
+    if (tc->bucket_bits == 0) return 0;
+    return (size_t)(((uint64_t)tile * 0x9E3779B97F4A7C15ULL) >> (64 - tc->bucket_bits));
+}
+
+// Resident slot of tile, -1 if it is not resident
+static inline int tile_cache_find(const TileCache *tc, long tile) {
+    for (int s = tc->bucket[tile_bucket(tc, tile)]; s >= 0; s = tc->slot_chain[s]) {
+        if (tc->slot_tile[s] == tile) return s;
+    }
+    return -1;
+}
+
+static void tile_cache_unindex(TileCache *tc, int s) {
+    int *link = &tc->bucket[tile_bucket(tc, tc->slot_tile[s])];
+    while (*link != s) link = &tc->slot_chain[*link];
+    *link = tc->slot_chain[s];
+}
+
+static inline bool tile_spilled(const TileCache *tc, long tile) {
+    return tc->spilled[tile >> 6] >> (tile & 63) & 1;
+}
+
+// Index of tile among the in-flight read-ahead loads, -1 if none
+static int tile_inflight_find(const TileCache *tc, long tile) {
+    for (int i = 0; i < tc->inflight_count; i++) {
+        if (tc->inflight[i] == tile) return i;
+    }
+    return -1;
+}
+
+static void lru_unlink(TileCache *tc, int s) {
+    if (tc->lru_prev[s] >= 0) tc->lru_next[tc->lru_prev[s]] = tc->lru_next[s];
+    else tc->lru_head = tc->lru_next[s];
+    if (tc->lru_next[s] >= 0) tc->lru_prev[tc->lru_next[s]] = tc->lru_prev[s];
+    else tc->lru_tail = tc->lru_prev[s];
+}
+
+static void lru_push_front(TileCache *tc, int s) {
+    tc->lru_prev[s] = -1;
+    tc->lru_next[s] = tc->lru_head;
+    if (tc->lru_head >= 0) tc->lru_prev[tc->lru_head] = s;
+    tc->lru_head = s;
+    if (tc->lru_tail < 0) tc->lru_tail = s;
+}
+
+// Get a slot for tile, evicting (and spilling) the least recently used tile if full
+static int tile_cache_claim(TileCache *tc, long tile) {
+    int s;
+    if (tc->used < tc->capacity) {
+        s = tc->used++;
+    } else {
+        s = tc->lru_tail;
+        lru_unlink(tc, s);
+        long old = tc->slot_tile[s];
+        if (tc->slot_dirty[s]) {
+            if (!pwrite_full(tc->fd, tc->slot_data + (size_t)s * tc->tile_bytes, tc->tile_bytes,
+                             tc->data_offset + (off_t)old * (off_t)tc->tile_bytes)) {
+                fprintf(stderr, "Failed spilling tile %ld\n", old);
+                exit(1);
+            }
+            tc->spilled[old >> 6] |= (uint64_t)1 << (old & 63);
+            int i = tile_inflight_find(tc, old);
+            if (i >= 0) tc->inflight_stale[i] = true;
+            tc->writes++;
+            tc->slot_dirty[s] = false;
+        }
+        tile_cache_unindex(tc, s);
+        if (tc->last_tile == old) tc->last_tile = -1;
+    }
+    tc->slot_tile[s] = tile;
+    size_t b = tile_bucket(tc, tile);
+    tc->slot_chain[s] = tc->bucket[b];
+    tc->bucket[b] = s;
+    lru_push_front(tc, s);
+    return s;
+}
+
+// Data of tile, loading it synchronously on a miss
+static unsigned char *tile_cache_get(TileCache *tc, long tile) {
+    if (tile == tc->last_tile) return tc->last_data;
+    int s = tile_cache_find(tc, tile);
+    if (s >= 0) {
+        tc->hits++;
+        if (tc->lru_head != s) {
+            lru_unlink(tc, s);
+            lru_push_front(tc, s);
+        }
+    } else {
+        tc->misses++;
+        s = tile_cache_claim(tc, tile);
+        unsigned char *data = tc->slot_data + (size_t)s * tc->tile_bytes;
+        if (tc->spill && !tile_spilled(tc, tile)) {
+            memset(data, 0, tc->tile_bytes);
+        } else {
+            if (!pread_full(tc->fd, data, tc->tile_bytes,
+                            tc->data_offset + (off_t)tile * (off_t)tc->tile_bytes)) {
+                fprintf(stderr, "Failed reading tile %ld\n", tile);
+                exit(1);
+            }
+            tc->reads++;
+        }
+    }
+    tc->last_tile = tile;
+    tc->last_slot = s;
+    tc->last_data = tc->slot_data + (size_t)s * tc->tile_bytes;
+    return tc->last_data;
+}
+
+static void *readahead_main(void *arg) {
+    ReadAhead *ra = (ReadAhead*)arg;
+    pthread_mutex_lock(&ra->lock);
+    for (;;) {
+        while (!ra->stop && (ra->pending_count == 0 || ra->done_count == READAHEAD_QUEUE)) {
+            pthread_cond_wait(&ra->wake, &ra->lock);
+        }
+        if (ra->stop) break;
+        TileRequest req = ra->pending[ra->pending_head];
+        ra->pending_head = (ra->pending_head + 1) % READAHEAD_QUEUE;
+        ra->pending_count--;
+        pthread_mutex_unlock(&ra->lock);
+
+        TileCache *tc = req.cache;
+        req.data = (unsigned char*)malloc(tc->tile_bytes);
+        if (req.data && !pread_full(tc->fd, req.data, tc->tile_bytes,
+                                    tc->data_offset + (off_t)req.tile * (off_t)tc->tile_bytes)) {
+            free(req.data);
+            req.data = NULL;
+        }
+
+        pthread_mutex_lock(&ra->lock);
+        ra->done[ra->done_count++] = req;
+        atomic_store_explicit(&ra->done_hint, ra->done_count, memory_order_release);
+    }
+    pthread_mutex_unlock(&ra->lock);
+    return NULL;
+}
+
+// Queue a read-ahead load of tile unless it is resident, queued, or has nothing on disk
+static void readahead_request(ReadAhead *ra, TileCache *tc, long tile) {
+    if (tile < 0 || tile >= tc->tile_count || tc->inflight_count == READAHEAD_INFLIGHT) return;
+    if (tile_cache_find(tc, tile) >= 0 || tile_inflight_find(tc, tile) >= 0) return;
+    if (tc->spill && !tile_spilled(tc, tile)) return;
+    pthread_mutex_lock(&ra->lock);
+    if (ra->pending_count < READAHEAD_QUEUE) {
+        TileRequest *req = &ra->pending[(ra->pending_head + ra->pending_count) % READAHEAD_QUEUE];
+        req->cache = tc;
+        req->tile = tile;
+        req->data = NULL;
+        ra->pending_count++;
+        tc->inflight[tc->inflight_count] = tile;
+        tc->inflight_stale[tc->inflight_count++] = false;
+        pthread_cond_signal(&ra->wake);
+    }
+    pthread_mutex_unlock(&ra->lock);
+}
+
+// Install finished read-ahead loads into their caches (solver thread only)
+static void readahead_collect(ReadAhead *ra) {
+    if (atomic_load_explicit(&ra->done_hint, memory_order_acquire) == 0) return;
+    TileRequest done[READAHEAD_QUEUE];
+    pthread_mutex_lock(&ra->lock);
+    int n = ra->done_count;
+    memcpy(done, ra->done, n * sizeof(TileRequest));
+    ra->done_count = 0;
+    atomic_store_explicit(&ra->done_hint, 0, memory_order_release);
+    pthread_cond_signal(&ra->wake);
+    pthread_mutex_unlock(&ra->lock);
+    for (int i = 0; i < n; i++) {
+        TileCache *tc = done[i].cache;
+        long tile = done[i].tile;
+        int k = tile_inflight_find(tc, tile);
+        bool stale = tc->inflight_stale[k];
+        tc->inflight_count--;
+        tc->inflight[k] = tc->inflight[tc->inflight_count];
+        tc->inflight_stale[k] = tc->inflight_stale[tc->inflight_count];
+        // Drop loads that failed, raced a synchronous load, or predate a later spill
+        if (done[i].data && !stale && tile_cache_find(tc, tile) < 0) {
+            int s = tile_cache_claim(tc, tile);
+            memcpy(tc->slot_data + (size_t)s * tc->tile_bytes, done[i].data, tc->tile_bytes);
+            tc->prefetched++;
+        }
+        free(done[i].data);
+    }
+}
+
+typedef struct {
+    long rows, cols;
+    int tile_size, tiles_c;
+    TileCache obstacles, visited;
+    ReadAhead *ra;
+} OutOfCoreGrid;
+
+static inline bool ooc_bit(TileCache *tc, const OutOfCoreGrid *o, long r, long c) {
+    long tile = (r / o->tile_size) * o->tiles_c + c / o->tile_size;
+    int bit = (int)(r % o->tile_size) * o->tile_size + (int)(c % o->tile_size);
+    return (tile_cache_get(tc, tile)[bit >> 3] >> (bit & 7)) & 1;
+}
+
+static inline void ooc_mark_visited(OutOfCoreGrid *o, long r, long c) {
+    long tile = (r / o->tile_size) * o->tiles_c + c / o->tile_size;
+    int bit = (int)(r % o->tile_size) * o->tile_size + (int)(c % o->tile_size);
+    tile_cache_get(&o->visited, tile)[bit >> 3] |= (unsigned char)(1u << (bit & 7));
+    o->visited.slot_dirty[o->visited.last_slot] = true;
+}
+
+static inline bool ooc_free(OutOfCoreGrid *o, long r, long c) {
+    return r >= 0 && r < o->rows && c >= 0 && c < o->cols && !ooc_bit(&o->obstacles, o, r, c);
+}
+
+static inline bool ooc_unvisited_free(OutOfCoreGrid *o, long r, long c) {
+    return ooc_free(o, r, c) && !ooc_bit(&o->visited, o, r, c);
+}
+
+// Request the tiles ahead of (r, c) when it is within a quarter tile of the border
+// it is moving towards
+static void ooc_read_ahead(OutOfCoreGrid *o, long r, long c, int d) {
+    if (!o->ra) return;
+    long local = DIR_DR[d] ? r % o->tile_size : c % o->tile_size;
+    long to_edge = (DIR_DR[d] + DIR_DC[d] > 0) ? o->tile_size - 1 - local : local;
+    if (to_edge >= o->tile_size / 4) return;
+    long nr = r + (long)DIR_DR[d] * (to_edge + 1);
+    long nc = c + (long)DIR_DC[d] * (to_edge + 1);
+    if (nr < 0 || nr >= o->rows || nc < 0 || nc >= o->cols) return;
+    long tile = (nr / o->tile_size) * o->tiles_c + nc / o->tile_size;
+    readahead_request(o->ra, &o->obstacles, tile);
+    readahead_request(o->ra, &o->visited, tile);
+}
+
+// Run the greedy solver of solve_path on a tiled grid file, keeping at most about
+// memory_cap bytes of tiles resident. The path is streamed to path_out (in the
+// format of print_path_result) when it is not NULL. Returns false if the file
+// cannot be used.
+bool solve_path_out_of_core(const char *grid_path, long movement_points, size_t memory_cap,
+                            bool read_ahead, FILE *path_out, OutOfCoreStats *stats) {
+    int fd = open(grid_path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open tiled grid %s\n", grid_path);
+        return false;
+    }
+    TiledGridHeader h;
+    if (!pread_full(fd, &h, sizeof(h), 0) || memcmp(h.magic, TILED_GRID_MAGIC, 8) != 0 ||
+        h.rows < 0 || h.cols < 0 || h.tile_size < TILE_MIN_SIZE || h.tile_size % 8) {
+        fprintf(stderr, "%s is not a tiled grid file\n", grid_path);
+        close(fd);
+        return false;
+    }
+    FILE *spill = tmpfile();
+    if (!spill) {
+        fprintf(stderr, "Cannot create spill file for visited tiles\n");
+        close(fd);
+        return false;
+    }
+
+    OutOfCoreGrid o;
+    o.rows = h.rows;
+    o.cols = h.cols;
+    o.tile_size = h.tile_size;
+    o.tiles_c = (h.cols + h.tile_size - 1) / h.tile_size;
+    long tiles_r = (h.rows + h.tile_size - 1) / h.tile_size;
+    long tile_count = tiles_r * o.tiles_c;
+    size_t tile_bytes = (size_t)h.tile_size * h.tile_size / 8;
+    // Split the cap between obstacle and visited tiles after the fixed costs: the
+    // spilled bits and the buffers of the loads the read-ahead thread can hold.
+    // A 3x3 neighborhood must fit whatever the cap.
+    size_t fixed = tile_cache_footprint(0, tile_bytes, tile_count, false) +
+                   tile_cache_footprint(0, tile_bytes, tile_count, true) +
+                   (read_ahead ? (size_t)(READAHEAD_QUEUE + 1) * tile_bytes : 0);
+    size_t per_slot = tile_bytes + sizeof(long) + sizeof(bool) + 5 * sizeof(int);  // up to 2 buckets a slot
+    size_t slots = memory_cap > fixed ? (memory_cap - fixed) / 2 / per_slot : 0;
+    long per_cache = slots > INT_MAX ? INT_MAX : (long)slots;
+    if (per_cache < 9) per_cache = 9;
+    if (per_cache > tile_count) per_cache = tile_count > 0 ? tile_count : 1;
+    tile_cache_init(&o.obstacles, fd, sizeof(TiledGridHeader), tile_bytes, tile_count, (int)per_cache, false);
+    tile_cache_init(&o.visited, fileno(spill), 0, tile_bytes, tile_count, (int)per_cache, true);
+
+    ReadAhead ra;
+    o.ra = NULL;
+    if (read_ahead) {
+        memset(&ra, 0, sizeof(ra));
+        pthread_mutex_init(&ra.lock, NULL);
+        pthread_cond_init(&ra.wake, NULL);
+        atomic_init(&ra.done_hint, 0);
+        if (pthread_create(&ra.thread, NULL, readahead_main, &ra) == 0) o.ra = &ra;
+    }
+
+    OutOfCoreStats st;
+    memset(&st, 0, sizeof(st));
+    // First unblocked cell in row-major order
+    long cr = -1, cc = -1;
+    for (long r = 0; r < o.rows && cr < 0; r++) {
+        for (long c = 0; c < o.cols; c++) {
+            if (!ooc_bit(&o.obstacles, &o, r, c)) {
+                cr = r;
+                cc = c;
+                break;
+            }
+        }
+    }
+    if (cr >= 0) {
+        ooc_mark_visited(&o, cr, cc);
+        st.unique_count = 1;
+        if (path_out) fprintf(path_out, "Path: (%ld,%ld)", cr, cc);
+        for (long step = 0; step < movement_points; step++) {
+            if (o.ra) readahead_collect(o.ra);
+            int move = -1;
+            bool forward = false;
+            // First try to find an unvisited neighboring cell
+            for (int d = 0; d < 4 && move < 0; d++) {
+                if (ooc_unvisited_free(&o, cr + DIR_DR[d], cc + DIR_DC[d])) {
+                    move = d;
+                    forward = true;
+                }
+            }
+            // Otherwise a free neighbor that has an unvisited neighbor
+            for (int d = 0; d < 4 && move < 0; d++) {
+                long nr = cr + DIR_DR[d], nc = cc + DIR_DC[d];
+                if (!ooc_free(&o, nr, nc)) continue;
+                for (int e = 0; e < 4; e++) {
+                    if (ooc_unvisited_free(&o, nr + DIR_DR[e], nc + DIR_DC[e])) {
+                        move = d;
+                        break;
+                    }
+                }
+            }
+            if (move < 0) break;  // no move possible that increases coverage
+            cr += DIR_DR[move];
+            cc += DIR_DC[move];
+            if (forward) {
+                ooc_mark_visited(&o, cr, cc);
+                st.unique_count++;
+            }
+            st.moves++;
+            if (path_out) fprintf(path_out, " (%ld,%ld)", cr, cc);
+            ooc_read_ahead(&o, cr, cc, move);
+        }
+        if (path_out) fprintf(path_out, "\n");
+    }
+    if (path_out) fprintf(path_out, "Unique squares visited: %ld\n", st.unique_count);
+
+    if (o.ra) {
+        pthread_mutex_lock(&ra.lock);
+        ra.stop = true;
+        pthread_cond_signal(&ra.wake);
+        pthread_mutex_unlock(&ra.lock);
+        pthread_join(ra.thread, NULL);
+        for (int i = 0; i < ra.done_count; i++) free(ra.done[i].data);
+    }
+    if (read_ahead) {
+        pthread_mutex_destroy(&ra.lock);
+        pthread_cond_destroy(&ra.wake);
+    }
+    st.tile_hits = o.obstacles.hits + o.visited.hits;
+    st.tile_misses = o.obstacles.misses + o.visited.misses;
+    st.tiles_read = o.obstacles.reads + o.visited.reads;
+    st.tiles_written = o.visited.writes;
+    st.tiles_prefetched = o.obstacles.prefetched + o.visited.prefetched;
+    if (stats) *stats = st;
+    tile_cache_release(&o.obstacles);
+    tile_cache_release(&o.visited);
+    fclose(spill);
+    close(fd);
+    return true;
+}
+
+// Generate num_blocked unique random blocked cells inside the grid.
+// If num_blocked > number of currently-free cells, it will block all free cells.
+void generate_blocked(Grid *g, int num_blocked) {
+    if (!g || num_blocked <= 0) return;
+
+    // Count already blocked cells
+    long already_blocked = 0;
+    if (g->blocked_pyramid) already_blocked = g->blocked_pyramid->total;
+    else for (int r = 0; r < g->rows; r++) {
+        for (int c = 0; c < g->cols; c++) {
+            if (g->blocked[r][c]) already_blocked++;
+        }
+    }
+
+    long total_cells = (long)g->rows * (long)g->cols;
+    long available = total_cells - already_blocked;
+    if (available <= 0) return;
+
+    if (num_blocked > available) num_blocked = (int)available;
+
+    int placed = 0;
+    // Simple random sampling with rejection; OK unless blocking nearly whole grid.
+    while (placed < num_blocked) {
+        int r = rand() % g->rows;
+        int c = rand() % g->cols;
+        if (g->blocked[r][c]) continue; // already blocked, try again
+        set_blocked(g, r, c, true);
+        placed++;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Job streams.
+//
+// solve_job_stream reads length-prefixed binary jobs, solves them on worker
+// threads and writes length-prefixed results in input order. A reader, the
+// workers and a writer form a pipeline connected by bounded lock-free queues;
+// job records come from a fixed pool that the writer recycles, so memory stays
+// bounded and the reader blocks when the workers fall behind. All integers
+// are in native byte order. A job with an unknown strategy, dimensions that
+// are not positive or exceed JOB_MAX_CELLS, or a budget outside
+// [0, JOB_MAX_BUDGET] is answered with JOB_INVALID and an empty path; the
+// reader checks this from the header and skips such a job's payload unread
+// into memory. Each worker keeps one grid and refills it in place while the
+// jobs' dimensions stay the same.
+//
+//   job:    uint32 size of the rest of the record
+//           uint64 tag, int32 rows, cols, budget,
+//           uint8 strategy (Strategy), uint8 flags (JOB_FLAG_*), uint16 reserved,
+//           rows * ((cols + 7) / 8) bytes of occupancy bitmap, 1 = blocked
+//   result: uint32 size of the rest of the record
+//           uint64 tag, int32 status (JOB_*), int32 unique_count,
+//           int64 upper_bound (0 unless JOB_FLAG_BOUND), int32 path cells,
+//           int32 start row and column when the path is not empty,
+//           uint8 direction per move (0 up, 1 right, 2 down, 3 left)
+// ---------------------------------------------------------------------------
+
+#define JOB_HEADER_BYTES 24
+#define JOB_FLAG_BOUND 1
+#define JOB_SOLVED 0
+#define JOB_INVALID 1
+#define JOB_QUEUE 256           // slots per queue, a power of two
+#define JOB_POOL JOB_QUEUE      // jobs in flight
+#define JOB_MAX_CELLS (1L << 28)
+#define JOB_MAX_BUDGET (1 << 28)  // bounds the path a job allocates
+
+typedef struct {
+    uint64_t tag;
+    uint64_t seq;               // position in the input stream
+    int rows, cols, budget;
+    int strategy, flags;
+    unsigned char *bitmap;
+    size_t bitmap_capacity;
+    int status;                 // JOB_INVALID once the reader rejects the header, else JOB_SOLVED
+    PathResult res;
+} StreamJob;
+
+// Bounded multi-producer multi-consumer ring (Vyukov). Each slot's sequence
+// number says whether it is ready for the producer or the consumer of a lap.
+typedef struct {
+    _Atomic size_t seq;
+    StreamJob *job;
+} JobSlot;
+
+typedef struct {
+    JobSlot slots[JOB_QUEUE];
+    _Alignas(64) _Atomic size_t head;  // next position to pop
+    _Alignas(64) _Atomic size_t tail;  // next position to push
+} JobQueue;
+
+static void job_queue_init(JobQueue *q) {
+    for (size_t i = 0; i < JOB_QUEUE; i++) atomic_init(&q->slots[i].seq, i);
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+}
+
+static bool job_queue_try_push(JobQueue *q, StreamJob *job) {
+    size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    for (;;) {
+        JobSlot *slot = &q->slots[pos & (JOB_QUEUE - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                slot->job = job;
+                atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;  // full
+        } else {
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        }
+    }
+}
+
+static bool job_queue_try_pop(JobQueue *q, StreamJob **job) {
+    size_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    for (;;) {
+        JobSlot *slot = &q->slots[pos & (JOB_QUEUE - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *job = slot->job;
+                atomic_store_explicit(&slot->seq, pos + JOB_QUEUE, memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;  // empty
+        } else {
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+        }
+    }
+}
+
+// Back off from a full or empty queue: spin briefly, then yield, then sleep
+static void job_queue_wait(int *spins) {
+    if (++*spins < 64) return;
+    if (*spins < 256) {
+        sched_yield();
+        return;
+    }
+    struct timespec pause = {0, 20000};
+    nanosleep(&pause, NULL);
+}
+
+static void job_queue_push(JobQueue *q, StreamJob *job) {
+    int spins = 0;
+    while (!job_queue_try_push(q, job)) job_queue_wait(&spins);
+}
+
+static StreamJob *job_queue_pop(JobQueue *q) {
+    StreamJob *job;
+    int spins = 0;
+    while (!job_queue_try_pop(q, &job)) job_queue_wait(&spins);
+    return job;
+}
+
+typedef struct {
+    FILE *in, *out;
+    int workers;
+    JobQueue free_jobs, pending, done;
+    bool read_error;
+    long jobs;
+} JobStream;
+
+static bool read_full(FILE *in, void *buf, size_t len) {
+    return fread(buf, 1, len, in) == len;
+}
+
+// Read and drop len bytes; works on pipes, unlike fseek
+static bool skip_full(FILE *in, size_t len) {
+    unsigned char buf[4096];
+    while (len > 0) {
+        size_t n = len < sizeof(buf) ? len : sizeof(buf);
+        if (fread(buf, 1, n, in) != n) return false;
+        len -= n;
+    }
+    return true;
+}
+
+static bool job_valid(const StreamJob *job) {
+    return job->strategy < STRATEGY_COUNT && job->rows > 0 && job->cols > 0 &&
+           (long)job->rows * job->cols <= JOB_MAX_CELLS && job->budget >= 0 && job->budget <= JOB_MAX_BUDGET;
+}
+
+// Reader: parse records into pooled jobs. NULL on pending ends the stream for one worker.
+static void *job_reader_main(void *arg) {
+    JobStream *js = (JobStream*)arg;
+    for (uint64_t seq = 0;; seq++) {
+        uint32_t size;
+        unsigned char header[JOB_HEADER_BYTES];
+        if (fread(&size, sizeof(size), 1, js->in) != 1) break;  // clean end of stream
+        if (size < JOB_HEADER_BYTES || !read_full(js->in, header, JOB_HEADER_BYTES)) {
+            js->read_error = true;
+            break;
+        }
+        StreamJob *job = job_queue_pop(&js->free_jobs);
+        int32_t dims[3];
+        memcpy(&job->tag, header, sizeof(uint64_t));
+        memcpy(dims, header + 8, sizeof(dims));
+        job->seq = seq;
+        job->rows = dims[0];
+        job->cols = dims[1];
+        job->budget = dims[2];
+        job->strategy = header[20];
+        job->flags = header[21];
+        size_t payload = size - JOB_HEADER_BYTES;
+        if (!job_valid(job)) {
+            // Answered without a grid, so the bitmap is never held in memory
+            job->status = JOB_INVALID;
+            if (!skip_full(js->in, payload)) {
+                job_queue_push(&js->free_jobs, job);
+                js->read_error = true;
+                break;
+            }
+            job_queue_push(&js->pending, job);
+            js->jobs++;
+            continue;
+        }
+        job->status = JOB_SOLVED;
+        if (payload != (size_t)job->rows * (((size_t)job->cols + 7) / 8)) {
+            job_queue_push(&js->free_jobs, job);
+            js->read_error = true;
+            break;
+        }
+        if (payload > job->bitmap_capacity) {
+            free(job->bitmap);
+            job->bitmap = (unsigned char*)malloc(payload);
+            if (!job->bitmap) {
+                fprintf(stderr, "Memory allocation failed for a %zu byte job\n", payload);
+                exit(1);
+            }
+            job->bitmap_capacity = payload;
+        }
+        if (!read_full(js->in, job->bitmap, payload)) {
+            job_queue_push(&js->free_jobs, job);
+            js->read_error = true;
+            break;
+        }
+        job_queue_push(&js->pending, job);
+        js->jobs++;
+    }
+    for (int i = 0; i < js->workers; i++) job_queue_push(&js->pending, NULL);
+    return NULL;
+}
+
+// Load a job's bitmap into the worker's grid g, which is reallocated only when
+// the dimensions change
+static Grid *job_load_grid(Grid *g, const StreamJob *job) {
+    if (!g || g->rows != job->rows || g->cols != job->cols) {
+        free_grid(g);
+        g = allocate_grid(job->rows, job->cols);
+    }
+    GridView v = make_grid_view(job->bitmap, job->rows, job->cols, ((size_t)job->cols + 7) / 8,
+                                OCCUPANCY_BITMAP, 1, true);
+    for (int r = 0; r < g->rows; r++) view_convert_row(&v, r, g->blocked[r]);
+    refresh_grid(g);
+    return g;
+}
+
+// Worker: load the grid and solve. Passes the end marker on to the writer.
+static void *job_worker_main(void *arg) {
+    JobStream *js = (JobStream*)arg;
+    SolveContext *ctx = create_solve_context();
+    ctx->threads = 1;  // the stream already keeps every core busy
+    Grid *g = NULL;
+    StreamJob *job;
+    while ((job = job_queue_pop(&js->pending)) != NULL) {
+        job->res.length = job->res.unique_count = 0;
+        job->res.weight = job->res.upper_bound = 0;
+        if (job->status == JOB_SOLVED) {
+            g = job_load_grid(g, job);
+            ctx->compute_bound = job->flags & JOB_FLAG_BOUND;
+            solve_path_strategy(g, job->budget, (Strategy)job->strategy, ctx, &job->res);
+        }
+        job_queue_push(&js->done, job);
+    }
+    job_queue_push(&js->done, NULL);
+    free_grid(g);
+    free_solve_context(ctx);
+    return NULL;
+}
+
+static void write_job_result(FILE *out, const StreamJob *job) {
+    const PathResult *res = &job->res;
+    int32_t moves = res->length > 0 ? res->length - 1 : 0;
+    uint32_t size = 8 + 4 + 4 + 8 + 4 + (res->length > 0 ? 8 : 0) + (uint32_t)moves;
+    int32_t fields[2] = {job->status, res->unique_count};
+    int64_t bound = res->upper_bound;
+    int32_t length = res->length;
+    fwrite(&size, sizeof(size), 1, out);
+    fwrite(&job->tag, sizeof(job->tag), 1, out);
+    fwrite(fields, sizeof(int32_t), 2, out);
+    fwrite(&bound, sizeof(bound), 1, out);
+    fwrite(&length, sizeof(length), 1, out);
+    if (res->length == 0) return;
+    int32_t start[2] = {res->path_r[0], res->path_c[0]};
+    fwrite(start, sizeof(int32_t), 2, out);
+    for (int i = 1; i < res->length; i++) {
+        int dr = res->path_r[i] - res->path_r[i - 1], dc = res->path_c[i] - res->path_c[i - 1];
+        putc(dr < 0 ? 0 : dc > 0 ? 1 : dr > 0 ? 2 : 3, out);
+    }
+}
+
+// Solve every job on in, writing results to out in input order with `workers`
+// solver threads (0 for one per online CPU). Returns the number of jobs
+// solved, or -1 if the stream ended in a truncated or malformed record.
+long solve_job_stream(FILE *in, FILE *out, int workers) {
+    if (workers <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? (int)cpus : 1;
+    }
+    JobStream *js = (JobStream*)calloc(1, sizeof(JobStream));
+    StreamJob *pool = (StreamJob*)calloc(JOB_POOL, sizeof(StreamJob));
+    StreamJob **reorder = (StreamJob**)calloc(JOB_POOL, sizeof(StreamJob*));
+    pthread_t *tids = (pthread_t*)malloc((workers + 1) * sizeof(pthread_t));
+    if (!js || !pool || !reorder || !tids) {
+        fprintf(stderr, "Memory allocation failed for job stream\n");
+        exit(1);
+    }
+    js->in = in;
+    js->out = out;
+    js->workers = workers;
+    job_queue_init(&js->free_jobs);
+    job_queue_init(&js->pending);
+    job_queue_init(&js->done);
+    for (int i = 0; i < JOB_POOL; i++) job_queue_push(&js->free_jobs, &pool[i]);
+    if (pthread_create(&tids[0], NULL, job_reader_main, js) != 0) {
+        fprintf(stderr, "Could not start the job reader\n");
+        exit(1);
+    }
+    for (int i = 0; i < workers; i++) {
+        if (pthread_create(&tids[i + 1], NULL, job_worker_main, js) != 0) {
+            fprintf(stderr, "Could not start job worker %d\n", i);
+            exit(1);
+        }
+    }
+    // Writer: at most JOB_POOL jobs are in flight, all at or after next, so
+    // slot seq % JOB_POOL holds job seq until it is written
+    uint64_t next = 0;
+    for (int finished = 0; finished < workers;) {
+        StreamJob *job = job_queue_pop(&js->done);
+        if (!job) {
+            finished++;
+            continue;
+        }
+        reorder[job->seq % JOB_POOL] = job;
+        while ((job = reorder[next % JOB_POOL]) != NULL && job->seq == next) {
+            reorder[next % JOB_POOL] = NULL;
+            write_job_result(out, job);
+            job_queue_push(&js->free_jobs, job);
+            next++;
+        }
+    }
+    for (int i = 0; i <= workers; i++) pthread_join(tids[i], NULL);
+    fflush(out);
+    long solved = js->read_error ? -1 : js->jobs;
+    for (int i = 0; i < JOB_POOL; i++) {
+        free(pool[i].bitmap);
+        free_path_result(&pool[i].res);
+    }
+    free(pool);
+    free(reorder);
+    free(tids);
+    free(js);
+    return solved;
+}
+
+// ---------------------------------------------------------------------------
+// All-starts coverage.
+//
+// create_coverage_heatmap runs the greedy from every free cell and records the
+// coverage each start reaches, e.g. to choose where to place a dock. Workers
+// claim HEATMAP_ROWS rows at a time from a shared counter, since solve times
+// vary a lot between open areas and cramped ones. Each keeps one path and one
+// visited-mask buffer for all of its solves and clears only the marks the last
+// path left, so a start costs O(movement_points) rather than O(cells). Grids
+// with a fixed-dimension solver use it instead; its stack bitset of at most
+// 8 KB is cleared per start.
+// ---------------------------------------------------------------------------
+
+#define HEATMAP_ROWS 4  // rows claimed per turn by a heatmap worker
+
+typedef struct {
+    const Grid *g;
+    int movement_points;
+    int *coverage;
+    _Atomic int *next_row;
+    int best_r, best_c, best_coverage;  // best start among this worker's rows
+} HeatmapWorker;
+
+static void *heatmap_worker_main(void *arg) {
+    HeatmapWorker *w = (HeatmapWorker*)arg;
+    const Grid *g = w->g;
+    int movement_points = w->movement_points < 0 ? 0 : w->movement_points;
+    FixedSolver fixed = fixed_solver(g);
+    size_t mask_bytes = (size_t)g->rows * mask_stride(g->cols);
+    unsigned char *vis_mask = fixed ? NULL : (unsigned char*)calloc(mask_bytes, 1);
+    if (!fixed && !vis_mask) {
+        fprintf(stderr, "Memory allocation failed for visited masks\n");
+        exit(1);
+    }
+    PathResult res = {0};
+    for (;;) {
+        int r0 = atomic_fetch_add(w->next_row, HEATMAP_ROWS);
+        if (r0 >= g->rows) break;
+        int r1 = r0 + HEATMAP_ROWS < g->rows ? r0 + HEATMAP_ROWS : g->rows;
+        for (int r = r0; r < r1; r++) {
+            for (int c = 0; c < g->cols; c++) {
+                int *cell = &w->coverage[(size_t)r * g->cols + c];
+                if (g->blocked[r][c]) {
+                    *cell = -1;
+                    continue;
+                }
+                if (fixed) fixed(g, r, c, movement_points, INT_MAX, &res);
+                else solve_path_on_masks(g, r, c, movement_points, vis_mask, mask_bytes, &res);
+                *cell = res.unique_count;
+                // Rows are claimed in increasing order, so ties keep the first start in row-major order
+                if (res.unique_count > w->best_coverage ||
+                    (res.unique_count == w->best_coverage && (long)r * g->cols + c < (long)w->best_r * g->cols + w->best_c)) {
+                    w->best_r = r;
+                    w->best_c = c;
+                    w->best_coverage = res.unique_count;
+                }
+            }
+        }
+    }
+    free_path_result(&res);
+    free(vis_mask);
+    return NULL;
+}
+
+// Greedy coverage with movement_points from every cell of g, using `threads`
+// workers (0 for one per online CPU).
+CoverageHeatmap *create_coverage_heatmap(const Grid *g, int movement_points, int threads) {
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    if (threads > g->rows) threads = g->rows;
+    CoverageHeatmap *h = (CoverageHeatmap*)malloc(sizeof(CoverageHeatmap));
+    HeatmapWorker *workers = (HeatmapWorker*)calloc(threads, sizeof(HeatmapWorker));
+    pthread_t *tids = (pthread_t*)malloc(threads * sizeof(pthread_t));
+    if (!h || !workers || !tids) {
+        fprintf(stderr, "Memory allocation failed for coverage heatmap\n");
+        exit(1);
+    }
+    h->rows = g->rows;
+    h->cols = g->cols;
+    h->movement_points = movement_points;
+    h->coverage = (int*)malloc((size_t)g->rows * g->cols * sizeof(int));
+    if (!h->coverage) {
+        fprintf(stderr, "Memory allocation failed for coverage heatmap\n");
+        exit(1);
+    }
+    _Atomic int next_row = 0;
+    for (int t = 0; t < threads; t++) {
+        HeatmapWorker *w = &workers[t];
+        w->g = g;
+        w->movement_points = movement_points;
+        w->coverage = h->coverage;
+        w->next_row = &next_row;
+        w->best_r = w->best_c = -1;
+        w->best_coverage = 0;
+        if (threads == 1 || pthread_create(&tids[t], NULL, heatmap_worker_main, w) != 0) {
+            heatmap_worker_main(w);
+            tids[t] = pthread_self();
+        }
+    }
+    h->best_r = h->best_c = -1;
+    h->best_coverage = 0;
+    for (int t = 0; t < threads; t++) {
+        HeatmapWorker *w = &workers[t];
+        if (!pthread_equal(tids[t], pthread_self())) pthread_join(tids[t], NULL);
+        if (w->best_coverage > h->best_coverage ||
+            (w->best_coverage == h->best_coverage && w->best_r >= 0 &&
+             (long)w->best_r * g->cols + w->best_c < (long)h->best_r * g->cols + h->best_c)) {
+            h->best_r = w->best_r;
+            h->best_c = w->best_c;
+            h->best_coverage = w->best_coverage;
+        }
+    }
+    free(workers);
+    free(tids);
+    return h;
+}
+
+void free_coverage_heatmap(CoverageHeatmap *h) {
+    if (!h) return;
+    free(h->coverage);
+    free(h);
+}
+
+// Write the heatmap as an 8-bit binary PGM: blocked cells are black and free
+// cells scale from 1 (coverage 1) to 255 (the best start's coverage)
+bool save_coverage_heatmap(const CoverageHeatmap *h, const char *path) {
+    unsigned char *pixels = (unsigned char*)malloc((size_t)h->rows * h->cols);
+    if (!pixels) {
+        fprintf(stderr, "Memory allocation failed for heatmap image\n");
+        exit(1);
+    }
+    long span = h->best_coverage > 1 ? h->best_coverage - 1 : 1;
+    for (size_t i = 0; i < (size_t)h->rows * h->cols; i++) {
+        int v = h->coverage[i];
+        pixels[i] = v < 0 ? 0 : (unsigned char)(1 + (long)(v - 1) * 254 / span);
+    }
+    FILE *f = fopen(path, "wb");
+    bool ok = f && fprintf(f, "P5\n%d %d\n255\n", h->cols, h->rows) > 0 &&
+              fwrite(pixels, 1, (size_t)h->rows * h->cols, f) == (size_t)h->rows * h->cols;
+    if (f && fclose(f) != 0) ok = false;
+    if (!ok) fprintf(stderr, "Failed writing heatmap image %s\n", path);
+    free(pixels);
+    return ok;
+}
+
+// The test driver; define GRID_TRAVERSAL_NO_MAIN to build the core as a library
+#ifndef GRID_TRAVERSAL_NO_MAIN
+
+// Reader for Test 13: solve on pinned snapshots and check each path against its snapshot
+typedef struct {
+    GridStore *store;
+    int solves, invalid;
+} SnapshotReader;
+
+static void *snapshot_reader_main(void *arg) {
+    SnapshotReader *reader = (SnapshotReader*)arg;
+    SolveContext *ctx = create_solve_context();
+    PathResult res = {0};
+    for (int i = 0; i < reader->solves; i++) {
+        const Grid *g;
+        int slot = grid_store_pin(reader->store, &g);
+        if (slot < 0) continue;
+        solve_path_into(g, 500, ctx, &res);
+        for (int p = 0; p < res.length; p++) {
+            if (g->blocked[res.path_r[p]][res.path_c[p]]) {
+                reader->invalid++;
+                break;
+            }
+        }
+        grid_store_unpin(reader->store, slot);
+    }
+    free_path_result(&res);
+    free_solve_context(ctx);
+    return NULL;
+}
+
+// Checks of run_tests that failed; it returns nonzero if any did
+static int test_failures;
+
+// Record the outcome of a check and pass it through, so it can be printed inline
+static bool check_at(bool ok, int line) {
+    if (!ok) {
+        test_failures++;
+        fprintf(stderr, "Check at line %d failed\n", line);
+    }
+    return ok;
+}
+#define check(ok) check_at((ok), __LINE__)
+
+// The built-in tests, run when the driver gets no arguments. Returns nonzero if a check failed.
+static int run_tests(void) {
+    // Test 1: Tiny grid 1x1, no blocked cells
+    {
+        const int N = 1, M = 1;
+        const int (*blocked_cells1)[2] = NULL;  // no blocked cells
+        Grid *g1 = create_grid(N, M, 0, blocked_cells1);
+        printf("Test 1 (%dx%d, no blocks):\n", N, M);
+        solve_path(g1, 1);
+        print_grid(g1);
+        free_grid(g1);
+        // A grid without rows still owns its (empty) mask block; leak checkers catch a miss
+        free_grid(create_grid(0, M, 0, NULL));
+        printf("\n");
+    }
+    // Test 2: Grid 2x2 where all cells are blocked
+    {
+        const int N = 2, M = 2;
+        const int blocked_cells2[][2] = {{0,0}, {0,1}, {1,0}, {1,1}};
+        Grid *g2 = create_grid(N, M, 4, blocked_cells2);
+        printf("Test 2 (%dx%d, all blocked):\n", N, M);
+        solve_path(g2, 10);
+        print_grid(g2);
+        free_grid(g2);
+        printf("\n");
+    }
+    // Test 3: Grid with a single possible path (3x3 with a blocked center row)
+    {
+        const int N = 3, M = 3;
+        const int blocked_cells3[][2] = {{1,0}, {1,1}, {1,2}};
+        Grid *g3 = create_grid(N, M, 3, blocked_cells3);
+        printf("Test 3 (%dx%d, one path):\n", N, M);
+        solve_path(g3, 5);
+        print_grid(g3);
+        free_grid(g3);
+        printf("\n");
+    }
+    // Test 4: Larger grid with many free cells (5x5 no blocks)
+    {
+        const int N = 5, M = 5;
+        const int (*blocked_cells4)[2] = NULL;  // no blocked cells
+        Grid *g4 = create_grid(N, M, 0, blocked_cells4);
+        printf("Test 4 (%dx%d, no blocks):\n", N, M);
+        solve_path(g4, 30);
+        print_grid(g4);
+        free_grid(g4);
+        printf("\n");
+    }
+    
+    srand((unsigned) time(NULL)); // Seed RNG once
+    // Test 5: Randomly generated grid (10x10 with 20 random blocked cells)
+    {
+        const int N = 100, M = 10;
+        Grid *g5 = create_grid(N, M, 0, NULL);
+        generate_blocked(g5, 200);
+        printf("Test 5 (%dx%d, random blocks):\n", N, M);
+        solve_path(g5, 50);
+        print_grid(g5);
+        free_grid(g5);
+        printf("\n");
+    }
+    // Test 6: Interleaved batch of independent solves must match one-at-a-time solves
+    {
+        enum { BATCH = 24 };
+        const Grid *grids[BATCH];
+        int budgets[BATCH];
+        PathResult batch[BATCH], single = {0};
+        memset(batch, 0, sizeof(batch));
+        for (int i = 0; i < BATCH; i++) {
+            Grid *g = create_grid(40 + i, 60, 0, NULL);
+            generate_blocked(g, 400 + 20 * i);
+            grids[i] = g;
+            budgets[i] = 100 * (i + 1);
+        }
+        solve_path_batch(grids, budgets, BATCH, batch);
+        SolveContext *ctx = create_solve_context();
+        int mismatches = 0;
+        long total_unique = 0;
+        for (int i = 0; i < BATCH; i++) {
+            solve_path_into(grids[i], budgets[i], ctx, &single);
+            if (single.length != batch[i].length || single.unique_count != batch[i].unique_count ||
+                memcmp(single.path_r, batch[i].path_r, single.length * sizeof(int)) ||
+                memcmp(single.path_c, batch[i].path_c, single.length * sizeof(int))) {
+                mismatches++;
+            }
+            total_unique += batch[i].unique_count;
+            free_path_result(&batch[i]);
+            free_grid((Grid*)grids[i]);
+        }
+        free_path_result(&single);
+        free_solve_context(ctx);
+        printf("Test 6 (%d interleaved solves):\n", BATCH);
+        check(mismatches == 0);
+        printf("Total unique squares visited: %ld, mismatches vs single solves: %d\n\n",
+               total_unique, mismatches);
+    }
+    // Test 7: Small grids solved in SIMD lanes must match one-at-a-time solves
+    {
+        enum { BATCH = 64 };
+        const Grid *grids[BATCH];
+        int budgets[BATCH];
+        PathResult batch[BATCH], single = {0};
+        memset(batch, 0, sizeof(batch));
+        for (int i = 0; i < BATCH; i++) {
+            int n = (i % 2) ? 8 : 16;
+            Grid *g = create_grid(n, n, 0, NULL);
+            generate_blocked(g, n * n / 5);
+            grids[i] = g;
+            budgets[i] = n * n;
+        }
+        solve_path_small_batch(grids, budgets, BATCH, batch);
+        SolveContext *ctx = create_solve_context();
+        int mismatches = 0;
+        long total_unique = 0;
+        for (int i = 0; i < BATCH; i++) {
+            solve_path_into(grids[i], budgets[i], ctx, &single);
+            if (single.length != batch[i].length || single.unique_count != batch[i].unique_count ||
+                memcmp(single.path_r, batch[i].path_r, single.length * sizeof(int)) ||
+                memcmp(single.path_c, batch[i].path_c, single.length * sizeof(int))) {
+                mismatches++;
+            }
+            total_unique += batch[i].unique_count;
+            free_path_result(&batch[i]);
+            free_grid((Grid*)grids[i]);
+        }
+        free_path_result(&single);
+        free_solve_context(ctx);
+        printf("Test 7 (%d small grids, SIMD lanes: %d):\n", BATCH, board_simd_lanes());
+        check(mismatches == 0);
+        printf("Total unique squares visited: %ld, mismatches vs single solves: %d\n\n",
+               total_unique, mismatches);
+    }
+    // Test 8: Out-of-core solve through a small tile cache must match the in-memory solve
+    {
+        const int N = 200, M = 150, MP = 20000;
+        Grid *g8 = create_grid(N, M, 0, NULL);
+        generate_blocked(g8, 600);
+        char path[] = "/tmp/grid_traversal_XXXXXX";
+        int fd = mkstemp(path);
+        if (fd >= 0) {
+            close(fd);
+            save_tiled_grid(g8, path, TILE_MIN_SIZE);
+            SolveContext *ctx = create_solve_context();
+            PathResult res = {0};
+            solve_path_into(g8, MP, ctx, &res);
+            OutOfCoreStats st;
+            // A 4 KB cap leaves each cache its minimum of 9 of the 35 tiles, so visited
+            // tiles get spilled and reloaded
+            solve_path_out_of_core(path, MP, 4096, true, NULL, &st);
+            check(st.unique_count == res.unique_count && st.moves == res.length - 1);
+            printf("Test 8 (%dx%d out-of-core, %dx%d tiles, 9 resident tiles):\n", N, M, TILE_MIN_SIZE, TILE_MIN_SIZE);
+            printf("Unique squares visited: %ld (in-memory: %d), moves: %ld (in-memory: %d)\n",
+                   st.unique_count, res.unique_count, st.moves, res.length - 1);
+            printf("Tile misses: %ld, tiles spilled: %ld\n\n", st.tile_misses, st.tiles_written);
+            free_path_result(&res);
+            free_solve_context(ctx);
+            unlink(path);
+        }
+        free_grid(g8);
+    }
+    // Test 9: Coverage rendering and frontier search over the visited pyramid
+    {
+        const int N = 12, M = 40;
+        Grid *g9 = create_grid(N, M, 0, NULL);
+        generate_blocked(g9, 90);
+        SolveContext *ctx = create_solve_context();
+        ctx->track_visited = true;
+        PathResult res = {0};
+        solve_path_into(g9, 120, ctx, &res);
+        printf("Test 9 (%dx%d coverage, 120 moves):\n", N, M);
+        print_coverage(g9, ctx->visited_pyramid);
+        if (res.length > 0) {
+            int er = res.path_r[res.length - 1], ec = res.path_c[res.length - 1], fr, fc;
+            if (pyramid_nearest_open(g9->blocked_pyramid, ctx->visited_pyramid, er, ec, &fr, &fc)) {
+                printf("Nearest unvisited free cell to (%d,%d): (%d,%d)\n", er, ec, fr, fc);
+            }
+        }
+        check(res.unique_count == ctx->visited_pyramid->total);
+        printf("Unique squares visited: %d (pyramid count: %ld)\n\n", res.unique_count, ctx->visited_pyramid->total);
+        free_path_result(&res);
+        free_solve_context(ctx);
+        free_grid(g9);
+    }
+    // Test 10: Interval representation of a corridor map
+    {
+        const int N = 9, M = 24;
+        const int blocked_cells10[][2] = {
+            {2,0}, {2,1}, {2,2}, {2,3}, {2,4}, {2,5}, {2,6}, {2,7}, {2,8}, {2,9}, {2,10}, {2,11},
+            {2,12}, {2,13}, {2,14}, {2,15}, {2,16}, {2,17}, {2,18}, {2,19}, {2,20},
+            {3,12}, {4,12}, {5,12}, {6,12}, {7,12}, {8,12},
+            {6,0}, {6,1}, {6,2}, {6,3}, {6,4}, {6,5}, {6,6}, {6,7}, {6,8}, {6,9}, {6,10}, {6,11}
+        };
+        Grid *g10 = create_grid(N, M, 39, blocked_cells10);
+        const IntervalGrid *ig = grid_intervals(g10);
+        int *labels = (int*)malloc(ig->count * sizeof(int));
+        int *cells = (int*)malloc(ig->count * sizeof(int));
+        long *sizes = (long*)malloc(ig->count * sizeof(long));
+        int components = interval_label_components(ig, labels, sizes);
+        int sweep_cells = interval_sweep_cells(ig, cells);
+        printf("Test 10 (%dx%d corridors as intervals):\n", N, M);
+        print_grid(g10);
+        printf("Intervals: %d, free cells: %ld, components: %d, sweep cells: %d\n",
+               ig->count, interval_free_count(ig), components, sweep_cells);
+        printf("Component sizes:");
+        for (int i = 0; i < components; i++) printf(" %ld", sizes[i]);
+        printf("\n");
+        // The sweep strategy covers the start component planned on these intervals
+        SolveContext *ctx = create_solve_context();
+        PathResult res = {0};
+        solve_path_strategy(g10, 2 * N * M, STRATEGY_SWEEP, ctx, &res);
+        bool valid = res.length > 0 && !g10->blocked[res.path_r[0]][res.path_c[0]];
+        for (int k = 1; k < res.length; k++) {
+            valid = valid && !g10->blocked[res.path_r[k]][res.path_c[k]] &&
+                    abs(res.path_r[k] - res.path_r[k - 1]) + abs(res.path_c[k] - res.path_c[k - 1]) == 1;
+        }
+        printf("Sweep strategy: %d of %ld cells in %d moves, path valid: %s\n",
+               res.unique_count, sizes[0], res.length - 1, check(valid) ? "yes" : "no");
+        // Intervals built through the pyramid, which skips the uniform blocks of the
+        // wall and the hall, match a plain row scan, also after a mutation dropped them
+        Grid *big = create_grid(300, 400, 0, NULL);
+        generate_blocked(big, 30000);
+        for (int r = 0; r < 300; r++) {
+            for (int c = 0; c < 400; c++) {
+                if (r < 128 && c < 256) big->blocked[r][c] = true;
+                else if (r >= 150 && c >= 100) big->blocked[r][c] = false;
+            }
+        }
+        refresh_grid(big);
+        set_blocked(big, 200, 200, true);
+        const IntervalGrid *cached = grid_intervals(big);
+        BitPyramid *pyramid = big->blocked_pyramid;
+        big->blocked_pyramid = NULL;
+        IntervalGrid *scan = create_interval_grid(big);
+        big->blocked_pyramid = pyramid;
+        bool same = cached->count == scan->count &&
+                    memcmp(cached->row_start, scan->row_start, (big->rows + 1) * sizeof(int)) == 0 &&
+                    memcmp(cached->start, scan->start, scan->count * sizeof(int)) == 0 &&
+                    memcmp(cached->end, scan->end, scan->count * sizeof(int)) == 0;
+        printf("300x400 map: %d intervals, pyramid build matches a row scan: %s\n\n", scan->count, check(same) ? "yes" : "no");
+        free_interval_grid(scan);
+        free_grid(big);
+        free_path_result(&res);
+        free_solve_context(ctx);
+        free(labels);
+        free(cells);
+        free(sizes);
+        free_grid(g10);
+    }
+    // Test 11: Repeated queries are answered from the result cache until the map changes
+    {
+        const int N = 30, M = 30;
+        Grid *g11 = create_grid(N, M, 0, NULL);
+        generate_blocked(g11, 150);
+        ResultCache *cache = create_result_cache(1 << 20);
+        SolveContext *ctx = create_solve_context();
+        PathResult res = {0};
+        for (int i = 0; i < 5; i++) solve_path_cached(cache, g11, 400, STRATEGY_GREEDY, ctx, &res);
+        int unique_before = res.unique_count;
+        uint64_t hash_before = g11->hash;
+        // Toggling a cell twice restores the original content and therefore the hash
+        set_blocked(g11, N - 1, M - 1, !g11->blocked[N - 1][M - 1]);
+        solve_path_cached(cache, g11, 400, STRATEGY_GREEDY, ctx, &res);
+        set_blocked(g11, N - 1, M - 1, !g11->blocked[N - 1][M - 1]);
+        solve_path_cached(cache, g11, 400, STRATEGY_GREEDY, ctx, &res);
+        // A second miss on a cached query, as from a racing thread, must not add an entry
+        size_t entries = cache->entries;
+        cache_insert(cache, &cache->lru_head->key, &res);
+        printf("Test 11 (%dx%d, 7 cached queries):\n", N, M);
+        printf("Unique squares visited: %d, hash restored: %s\n", unique_before,
+               check(g11->hash == hash_before) ? "yes" : "no");
+        long hits, misses;
+        result_cache_stats(cache, &hits, &misses, NULL, NULL);
+        check(hits == 5 && misses == 2 && entries == cache->entries);
+        printf("Cache hits: %ld, misses: %ld, entries: %zu (%zu after a repeated insert)\n",
+               hits, misses, entries, cache->entries);
+        // A cache smaller than the answers on an open grid evicts and stays within its budget
+        ResultCache *small = create_result_cache(8192);
+        Grid *open = create_grid(N, M, 0, NULL);
+        for (int mp = 300; mp < 320; mp++) solve_path_cached(small, open, mp, STRATEGY_GREEDY, ctx, &res);
+        free_grid(open);
+        long evictions;
+        size_t bytes;
+        result_cache_stats(small, NULL, &misses, &evictions, &bytes);
+        check(evictions > 0 && bytes <= 8192);
+        printf("8 KiB cache after %ld misses: %ld evictions, %zu bytes held\n\n", misses, evictions, bytes);
+        free_result_cache(small);
+        free_path_result(&res);
+        free_solve_context(ctx);
+        free_result_cache(cache);
+        free_grid(g11);
+    }
+    // Test 12: A rotated and a mirrored copy of a room share its cached plan
+    {
+        const int N = 4, M = 6;
+        const int room[][2] = {{1,0}, {2,0}, {3,0}, {0,3}, {2,4}};
+        int rotated[5][2], mirrored[5][2];
+        for (int i = 0; i < 5; i++) {
+            // (r, c) -> (c, N - 1 - r) and (r, c) -> (r, M - 1 - c)
+            rotated[i][0] = room[i][1];
+            rotated[i][1] = N - 1 - room[i][0];
+            mirrored[i][0] = room[i][0];
+            mirrored[i][1] = M - 1 - room[i][1];
+        }
+        Grid *rooms[3] = {create_grid(N, M, 5, room), create_grid(M, N, 5, (const int (*)[2])rotated),
+                          create_grid(N, M, 5, (const int (*)[2])mirrored)};
+        ShapeCache *cache = create_shape_cache();
+        SolveContext *ctx = create_solve_context();
+        PathResult res = {0};
+        bool valid = true;
+        int covered[3];
+        for (int k = 0; k < 3; k++) {
+            const Grid *g = rooms[k];
+            solve_path_shape_cached(cache, g, 30, STRATEGY_GREEDY, ctx, &res);
+            // Each plan must be a walk over free cells of its own grid, covering as much as the first
+            covered[k] = res.unique_count;
+            valid = valid && res.length > 0 && res.weight == res.unique_count && covered[k] == covered[0];
+            for (int i = 0; i < res.length && valid; i++) {
+                valid = !g->blocked[res.path_r[i]][res.path_c[i]];
+                if (i > 0) valid = valid && abs(res.path_r[i] - res.path_r[i - 1]) + abs(res.path_c[i] - res.path_c[i - 1]) == 1;
+            }
+            if (k == 1) {
+                printf("Test 12 (%dx%d room, its rotation and its mirror image):\n", N, M);
+                print_grid(g);
+                print_path_result(&res);
+            }
+        }
+        long hits, misses;
+        int classes;
+        shape_cache_stats(cache, &hits, &misses, &classes, NULL);
+        check(hits == 2 && misses == 1 && classes == 1);
+        printf("Shape cache hits: %ld, misses: %ld, classes: %d, plans valid: %s\n",
+               hits, misses, classes, check(valid) ? "yes" : "no");
+        // Round trip through a file, then reject a truncated copy, an out-of-range plan
+        // cell and a repeated entry
+        char path[] = "/tmp/grid_traversal_XXXXXX";
+        int fd = mkstemp(path);
+        if (fd >= 0) {
+            close(fd);
+            save_shape_cache(cache, path);
+            ShapeCache *loaded = load_shape_cache(path);
+            bool round_trip = loaded && loaded->count == cache->count &&
+                              shape_cache_lookup(loaded, rooms[1], 30, &res) && res.unique_count == covered[1];
+            free_shape_cache(loaded);
+            FILE *f = fopen(path, "rb");
+            unsigned char image[4096];
+            size_t size = f ? fread(image, 1, sizeof(image), f) : 0;
+            if (f) fclose(f);
+            // The first entry: 7 header words and the bit pattern, then its plan
+            const size_t first = 12, plan = first + 28 + SHAPE_WORDS * 8;
+            int32_t length;
+            memcpy(&length, image + first + 20, sizeof(length));
+            size_t entry_bytes = plan - first + (size_t)length * 8;
+            int rejected = 0;
+            for (int k = 0; k < 3; k++) {
+                unsigned char copy[4096 + 1024];
+                size_t n = size;
+                memcpy(copy, image, size);
+                if (k == 0) n -= 4;
+                if (k == 1) copy[plan] = 99;
+                if (k == 2) {
+                    int32_t count = cache->count + 1;
+                    memcpy(copy + 8, &count, sizeof(count));
+                    memcpy(copy + n, image + first, entry_bytes);
+                    n += entry_bytes;
+                }
+                f = fopen(path, "wb");
+                if (f) {
+                    fwrite(copy, 1, n, f);
+                    fclose(f);
+                }
+                ShapeCache *bad = load_shape_cache(path);
+                rejected += bad == NULL;
+                free_shape_cache(bad);
+            }
+            check(rejected == 3);
+            printf("Saved cache reloads: %s, corrupt files rejected: %d of 3\n", check(round_trip) ? "yes" : "no", rejected);
+            unlink(path);
+        }
+        printf("\n");
+        free_path_result(&res);
+        free_solve_context(ctx);
+        free_shape_cache(cache);
+        for (int k = 0; k < 3; k++) free_grid(rooms[k]);
+    }
+    // Test 13: Readers solve on pinned snapshots while a writer publishes updates
+    {
+        enum { READERS = 4, UPDATES = 200 };
+        const int N = 150, M = 40;
+        Grid *g13 = create_grid(N, M, 0, NULL);
+        generate_blocked(g13, 600);
+        GridStore *store = create_grid_store(g13);
+        SnapshotReader readers[READERS];
+        pthread_t threads[READERS];
+        for (int i = 0; i < READERS; i++) {
+            readers[i].store = store;
+            readers[i].solves = 300;
+            readers[i].invalid = 0;
+            pthread_create(&threads[i], NULL, snapshot_reader_main, &readers[i]);
+        }
+        for (int i = 0; i < UPDATES; i++) {
+            int cell[1][2] = {{rand() % N, rand() % M}};
+            bool value = rand() % 2;
+            grid_store_update(store, (const int (*)[2])cell, &value, 1);
+        }
+        int invalid = 0;
+        for (int i = 0; i < READERS; i++) {
+            pthread_join(threads[i], NULL);
+            invalid += readers[i].invalid;
+        }
+        printf("Test 13 (%dx%d, %d readers, %d snapshot updates):\n", N, M, READERS, UPDATES);
+        check(invalid == 0);
+        printf("Versions published: %ld, paths crossing blocked cells: %d\n\n", store->published, invalid);
+        free_grid_store(store);
+        free_grid(g13);
+    }
+    // Test 14: A child process attaches to a shared grid, solves it, and follows an update
+    {
+        const int N = 120, M = 90;
+        char name[64];
+        snprintf(name, sizeof(name), "/grid_traversal_test_%d", (int)getpid());
+        Grid *g14 = create_grid(N, M, 0, NULL);
+        generate_blocked(g14, 2000);
+        SolveContext *ctx = create_solve_context();
+        PathResult res = {0};
+        int expected[2] = {-1, -1};
+        solve_path_into(g14, 3000, ctx, &res);
+        expected[0] = res.unique_count;
+        publish_shared_grid(name, g14);
+        int fds[2];
+        if (pipe(fds) != 0) {
+            fprintf(stderr, "pipe failed\n");
+            exit(1);
+        }
+        pid_t child = fork();
+        if (child == 0) {
+            close(fds[0]);
+            GridImageView *view = attach_shared_grid(name);
+            int got[2] = {-1, -1};
+            if (view) {
+                solve_path_into(grid_image_view_grid(view), 3000, ctx, &res);
+                got[0] = res.unique_count;
+                if (write(fds[1], &got[0], sizeof(int)) != sizeof(int)) _exit(1);
+                if (shared_grid_wait(view, 5000) && shared_grid_reattach(view)) {
+                    solve_path_into(grid_image_view_grid(view), 3000, ctx, &res);
+                    got[1] = res.unique_count;
+                }
+                detach_grid_view(view);
+            } else if (write(fds[1], &got[0], sizeof(int)) != sizeof(int)) {
+                _exit(1);
+            }
+            _exit(write(fds[1], &got[1], sizeof(int)) == sizeof(int) ? 0 : 1);
+        }
+        close(fds[1]);
+        int got[2] = {-1, -1};
+        if (read(fds[0], &got[0], sizeof(int)) == sizeof(int)) {
+            generate_blocked(g14, 500);
+            solve_path_into(g14, 3000, ctx, &res);
+            expected[1] = res.unique_count;
+            uint32_t version = publish_shared_grid(name, g14);
+            if (read(fds[0], &got[1], sizeof(int)) != sizeof(int)) got[1] = -1;
+            printf("Test 14 (%dx%d, shared with a child process, version %u):\n", N, M, version);
+        }
+        close(fds[0]);
+        waitpid(child, NULL, 0);
+        check(got[0] == expected[0] && got[1] == expected[1]);
+        printf("Unique squares in child: %d and %d (expected %d and %d)\n", got[0], got[1], expected[0], expected[1]);
+        // A reattach whose new segment has vanished fails and keeps the old version attached
+        bool kept = false;
+        GridImageView *view = attach_shared_grid(name);
+        if (view) {
+            set_blocked(g14, 0, 0, !g14->blocked[0][0]);
+            uint32_t version = publish_shared_grid(name, g14);
+            char data_name[256];
+            shared_data_name(data_name, sizeof(data_name), name, version);
+            shm_unlink(data_name);
+            if (!shared_grid_reattach(view)) {
+                solve_path_into(grid_image_view_grid(view), 3000, ctx, &res);
+                kept = res.unique_count == expected[1];
+            }
+            detach_grid_view(view);
+        }
+        // A saved image maps back to the same grid; images whose header disagrees
+        // with their dimensions are rejected
+        int rejected = 0;
+        bool mapped = false;
+        char path[] = "/tmp/grid_traversal_XXXXXX";
+        int fd = mkstemp(path);
+        if (fd >= 0) {
+            close(fd);
+            save_grid_binary(g14, path);
+            GridImageView *image = map_grid_binary(path);
+            if (image) {
+                const Grid *mg = grid_image_view_grid(image);
+                solve_path_into(g14, 3000, ctx, &res);
+                int direct = res.unique_count;
+                solve_path_into(mg, 3000, ctx, &res);
+                mapped = mg->hash == g14->hash && res.unique_count == direct;
+                detach_grid_view(image);
+            }
+            for (int k = 0; k < 2; k++) {
+                FILE *f = fopen(path, "r+b");
+                if (!f) break;
+                GridImageHeader h;
+                if (fread(&h, sizeof(h), 1, f) == 1) {
+                    if (k == 0) h.rows = N * 100;
+                    else h.count_offset += 1 << 20;
+                    rewind(f);
+                    fwrite(&h, sizeof(h), 1, f);
+                }
+                fclose(f);
+                Grid *bad = load_grid_binary(path);
+                rejected += bad == NULL;
+                if (bad) free_grid(bad);
+            }
+            unlink(path);
+        }
+        check(rejected == 2);
+        printf("Failed reattach kept the old version: %s, mapped image matches: %s, corrupt images rejected: %d of 2\n\n",
+               check(kept) ? "yes" : "no", check(mapped) ? "yes" : "no", rejected);
+        unlink_shared_grid(name);
+        free_path_result(&res);
+        free_solve_context(ctx);
+        free_grid(g14);
+    }
+    // Test 15: Solve an int8 occupancy buffer in place and through a packed copy
+    {
+        const int N = 60, M = 100;
+        const size_t stride = 128;  // padded rows, as a perception stack would hand them over
+        signed char *occupancy = (signed char*)calloc((size_t)N * stride, 1);
+        for (int r = 0; r < N; r++) {
+            for (int c = 0; c < M; c++) {
+                int roll = rand() % 100;
+                occupancy[(size_t)r * stride + c] = roll < 15 ? 100 : roll < 18 ? -1 : (signed char)(roll % 40);
+            }
+        }
+        GridView view = make_grid_view(occupancy, N, M, stride, OCCUPANCY_I8, 65, true);
+        Grid *g15 = grid_from_view(&view);
+        SolveContext *ctx = create_solve_context();
+        PathResult in_place = {0}, packed = {0};
+        solve_path_view(&view, 2000, ctx, &in_place);
+        solve_path_into(g15, 2000, ctx, &packed);
+        bool same = in_place.length == packed.length &&
+                    memcmp(in_place.path_r, packed.path_r, packed.length * sizeof(int)) == 0 &&
+                    memcmp(in_place.path_c, packed.path_c, packed.length * sizeof(int)) == 0;
+        printf("Test 15 (%dx%d int8 view, stride %zu):\n", N, M, stride);
+        printf("Unique squares in place: %d, packed: %d, same path: %s\n\n",
+               in_place.unique_count, packed.unique_count, check(same) ? "yes" : "no");
+        free_path_result(&in_place);
+        free_path_result(&packed);
+        free_solve_context(ctx);
+        free_grid(g15);
+        free(occupancy);
+    }
+    // Test 16: Coverage bounds on a comb of dead-end teeth, and the greedy gap to them
+    {
+        const int N = 5, M = 11;
+        // Spine along row 0, teeth down the even columns, blocked odd columns below the spine
+        int blocked_cells16[N * M][2];
+        int blocked_count = 0;
+        for (int r = 1; r < N; r++) {
+            for (int c = 1; c < M; c += 2) {
+                blocked_cells16[blocked_count][0] = r;
+                blocked_cells16[blocked_count][1] = c;
+                blocked_count++;
+            }
+        }
+        Grid *g16 = create_grid(N, M, blocked_count, (const int (*)[2])blocked_cells16);
+        SolveContext *ctx = create_solve_context();
+        ctx->compute_bound = true;
+        PathResult res = {0};
+        const int budgets[] = {6, 20, 60};
+        printf("Test 16 (%dx%d comb):\n", N, M);
+        for (int i = 0; i < 3; i++) {
+            CoverageBound b = coverage_upper_bound(g16, budgets[i]);
+            solve_path_strategy(g16, budgets[i], STRATEGY_GREEDY, ctx, &res);
+            check(res.upper_bound == b.best && res.unique_count <= b.best);
+            printf("Budget %d: component %ld, parity %ld, dead ends %ld -> bound %ld; greedy %d in %d moves (gap %ld)\n",
+                   budgets[i], b.component, b.parity, b.dead_end, b.best, res.unique_count, res.length - 1,
+                   res.upper_bound - res.unique_count);
+        }
+        printf("\n");
+        free_path_result(&res);
+        free_solve_context(ctx);
+        free_grid(g16);
+    }
+    // Test 17: Articulation analysis of a cluttered map and the dead-ends-first walk
+    {
+        const int N = 40, M = 40;
+        Grid *g17 = create_grid(N, M, 0, NULL);
+        generate_blocked(g17, 560);
+        const GridAnalysis *a = grid_analysis(g17);
+        SolveContext *ctx = create_solve_context();
+        PathResult greedy = {0}, dead_ends = {0};
+        solve_path_strategy(g17, 1500, STRATEGY_GREEDY, ctx, &greedy);
+        solve_path_strategy(g17, 1500, STRATEGY_DEAD_ENDS, ctx, &dead_ends);
+        long branches = 0;
+        for (size_t i = 0; i < (size_t)N * M; i++) branches += a->branch_size[i] > 0;
+        printf("Test 17 (%dx%d, 560 random blocks):\n", N, M);
+        printf("Component %u cells, %ld articulation points, %ld biconnected components, %ld dead-end branches\n",
+               a->component_size, a->articulation_count, a->biconnected_count, branches);
+        printf("Unique squares, greedy: %d, dead ends first: %d\n\n", greedy.unique_count, dead_ends.unique_count);
+        free_path_result(&greedy);
+        free_path_result(&dead_ends);
+        free_solve_context(ctx);
+        free_grid(g17);
+    }
+    // Test 18: Tile tour against the single-level strategies on a large cluttered map
+    {
+        const int N = 300, M = 300, MP = 60000;
+        Grid *g18 = create_grid(N, M, 0, NULL);
+        generate_blocked(g18, N * M / 5);
+        SolveContext *ctx = create_solve_context();
+        PathResult res = {0};
+        const Strategy strategies[] = {STRATEGY_GREEDY, STRATEGY_DEAD_ENDS, STRATEGY_TILE_TOUR};
+        const char *names[] = {"greedy", "dead ends first", "tile tour"};
+        printf("Test 18 (%dx%d, 20%% blocked, %d moves):\n", N, M, MP);
+        for (int i = 0; i < 3; i++) {
+            solve_path_strategy(g18, MP, strategies[i], ctx, &res);
+            printf("%s: %d unique squares in %d moves\n", names[i], res.unique_count, res.length - 1);
+        }
+        // The dead-ends solve left its analysis on the grid, and a second one reuses it
+        const GridAnalysis *cached = g18->analysis;
+        solve_path_strategy(g18, MP, STRATEGY_DEAD_ENDS, ctx, &res);
+        printf("analysis cached on the grid and reused: %s\n\n", check(cached && g18->analysis == cached) ? "yes" : "no");
+        free_path_result(&res);
+        free_solve_context(ctx);
+        free_grid(g18);
+    }
+    // Test 19: Hilbert sweep over an open hall with scattered pillars
+    {
+        const int N = 128, M = 128, MP = N * M;
+        Grid *g19 = create_grid(N, M, 0, NULL);
+        for (int r = 8; r < N; r += 16) {
+            for (int c = 8; c < M; c += 16) set_blocked(g19, r, c, true);
+        }
+        SolveContext *ctx = create_solve_context();
+        ctx->compute_bound = true;
+        PathResult res = {0};
+        solve_path_strategy(g19, MP, STRATEGY_HILBERT, ctx, &res);
+        check(res.unique_count <= res.upper_bound);
+        printf("Test 19 (%dx%d hall with pillars, %d moves):\n", N, M, MP);
+        printf("Hilbert sweep: %d unique squares in %d moves (bound %ld)\n\n",
+               res.unique_count, res.length - 1, res.upper_bound);
+        free_path_result(&res);
+        free_solve_context(ctx);
+        free_grid(g19);
+    }
+    // Test 20: Local-search refinement of a tile tour
+    {
+        const int N = 50, M = 50, MP = 1500;
+        Grid *g20 = create_grid(N, M, 0, NULL);
+        generate_blocked(g20, 600);
+        SolveContext *ctx = create_solve_context();
+        ctx->compute_bound = true;
+        PathResult seed = {0}, refined = {0};
+        solve_path_strategy(g20, MP, STRATEGY_TILE_TOUR, ctx, &seed);
+        solve_path_strategy(g20, MP, STRATEGY_REFINE, ctx, &refined);
+        check(refined.unique_count <= refined.upper_bound);
+        printf("Test 20 (%dx%d, 600 blocked, %d moves, %d restarts):\n", N, M, MP, REFINE_THREADS);
+        printf("Tile tour: %d unique squares, refined: %d (bound %ld)\n",
+               seed.unique_count, refined.unique_count, refined.upper_bound);
+        // A seed longer than the budget is cut to it rather than overrunning the workers
+        Grid *open = create_grid(20, 20, 0, NULL);
+        solve_path_strategy(open, 399, STRATEGY_GREEDY, ctx, &seed);
+        int seed_moves = seed.length - 1;
+        RefineOptions opt = {2, 20000, 7};
+        refine_path(open, 50, LONG_MAX, &opt, &seed);
+        check(seed.length - 1 <= 50);
+        printf("Seed of %d moves refined within 50 moves: %d moves, %d unique squares\n\n",
+               seed_moves, seed.length - 1, seed.unique_count);
+        free_grid(open);
+        free_path_result(&seed);
+        free_path_result(&refined);
+        free_solve_context(ctx);
+        free_grid(g20);
+    }
+    // Test 21: Beam search against the tile tour on the same map
+    {
+        const int N = 80, M = 80, MP = 5000;
+        Grid *g21 = create_grid(N, M, 0, NULL);
+        generate_blocked(g21, 1300);
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++) set_blocked(g21, r, c, false);  // keep the start out of a pocket
+        }
+        SolveContext *ctx = create_solve_context();
+        ctx->compute_bound = true;
+        PathResult tour = {0}, beam = {0};
+        solve_path_strategy(g21, MP, STRATEGY_TILE_TOUR, ctx, &tour);
+        solve_path_strategy(g21, MP, STRATEGY_BEAM, ctx, &beam);
+        check(beam.unique_count <= beam.upper_bound);
+        printf("Test 21 (%dx%d, 1300 blocked, %d moves, beam width %d):\n", N, M, MP, BEAM_WIDTH);
+        printf("Tile tour: %d unique squares, beam: %d (bound %ld)\n\n",
+               tour.unique_count, beam.unique_count, beam.upper_bound);
+        free_path_result(&tour);
+        free_path_result(&beam);
+        free_solve_context(ctx);
+        free_grid(g21);
+    }
+    // Test 22: Prize collecting on a weighted grid with a few heavy cells
+    {
+        const int N = 40, M = 40, MP = 300;
+        Grid *g22 = create_grid(N, M, 0, NULL);
+        generate_blocked(g22, 200);
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++) set_blocked(g22, r, c, false);
+        }
+        for (int r = 0; r < N; r++) {
+            for (int c = 0; c < M; c++) {
+                set_cell_weight(g22, r, c, (r * 7 + c * 13) % 10 == 0 ? 20 : (r + c) % 3 == 0 ? 0 : 1);
+            }
+        }
+        SolveContext *ctx = create_solve_context();
+        ctx->compute_bound = true;
+        PathResult beam = {0}, refined = {0};
+        solve_path_strategy(g22, MP, STRATEGY_BEAM, ctx, &beam);
+        solve_path_strategy(g22, MP, STRATEGY_REFINE, ctx, &refined);
+        check(beam.weight <= refined.upper_bound && refined.weight <= refined.upper_bound);
+        printf("Test 22 (%dx%d weighted, 200 blocked, %d moves):\n", N, M, MP);
+        printf("Beam: weight %ld, refined: weight %ld (bound %ld)\n\n",
+               beam.weight, refined.weight, refined.upper_bound);
+        free_path_result(&beam);
+        free_path_result(&refined);
+        free_solve_context(ctx);
+        free_grid(g22);
+    }
+    // Test 23: A door that opens at time 30, and a schedule-free solve matching the greedy
+    {
+        const int N = 3, M = 11, MP = 60;
+        int wall[2][2] = {{0, 5}, {2, 5}};
+        Grid *g23 = create_grid(N, M, 2, (const int (*)[2])wall);
+        ScheduledBlock door[2] = {{1, 5, 0, 20}, {1, 5, 15, 30}};
+        ObstacleSchedule *sched = create_obstacle_schedule(N, M, door, 2);
+        SolveContext *ctx = create_solve_context();
+        PathResult res = {0}, plain = {0}, greedy = {0};
+        solve_path_scheduled(g23, sched, MP, ctx, &res);
+        int entered = -1;
+        for (int k = 0; k < res.length && entered < 0; k++) {
+            if (res.path_r[k] == 1 && res.path_c[k] == 5) entered = k;
+        }
+        solve_path_scheduled(g23, NULL, MP, ctx, &plain);
+        solve_path_into(g23, MP, ctx, &greedy);
+        bool same = plain.length == greedy.length &&
+                    memcmp(plain.path_r, greedy.path_r, plain.length * sizeof(int)) == 0 &&
+                    memcmp(plain.path_c, greedy.path_c, plain.length * sizeof(int)) == 0;
+        printf("Test 23 (%dx%d, door closed until %d, %d moves):\n", N, M, sched->horizon, MP);
+        printf("Scheduled: %d unique squares, door entered at time %d; static path %s greedy\n",
+               res.unique_count, entered, check(same) ? "matches" : "DIFFERS FROM");
+        // A second solve reuses the context's search state and repeats the first;
+        // a schedule of other dimensions, or one blocking the start at time 0, is refused
+        int first_length = res.length;
+        bool repeated = solve_path_scheduled(g23, sched, MP, ctx, &res) && res.length == first_length;
+        ScheduledBlock guard = {0, 0, 0, 5};
+        ObstacleSchedule *wrong = create_obstacle_schedule(N + 1, M, door, 2);
+        ObstacleSchedule *start = create_obstacle_schedule(N, M, &guard, 1);
+        int refused = !solve_path_scheduled(g23, wrong, MP, ctx, &res) && res.length == 0;
+        refused += !solve_path_scheduled(g23, start, MP, ctx, &res) && res.length == 0;
+        check(refused == 2);
+        printf("Repeated solve matches: %s, bad schedules refused: %d of 2\n\n", check(repeated) ? "yes" : "no", refused);
+        free_obstacle_schedule(wrong);
+        free_obstacle_schedule(start);
+        free_path_result(&res);
+        free_path_result(&plain);
+        free_path_result(&greedy);
+        free_solve_context(ctx);
+        free_obstacle_schedule(sched);
+        free_grid(g23);
+    }
+    // Test 24: Prepared grid queries, patched across mutations and checked against a rebuild
+    {
+        const int N = 60, M = 60;
+        // Rows of walls with two gaps each, so every free cell is reachable from the start
+        Grid *g24 = create_grid(N, M, 0, NULL);
+        for (int r = 3; r < N; r += 6) {
+            for (int c = 0; c < M; c++) {
+                if (c % 30 != (r / 6) % 30) set_blocked(g24, r, c, true);
+            }
+        }
+        PreparedGrid *pg = create_prepared_grid(g24);
+        SolveContext *ctx = create_solve_context();
+        ctx->compute_bound = true;
+        PathResult res = {0};
+        int components;
+        prepared_components(pg, &components, NULL);
+        prepared_free_count(pg);
+        int sr, sc;
+        prepared_start_cell(pg, &sr, &sc);
+        // Coverage of the fixed map at budgets 100, 200, ..., 1600; past 775 cells the
+        // greedy stalls in a room whose gaps it has already passed
+        const int expected[5] = {101, 200, 399, 775, 775};
+        long covered = 0;
+        int mismatches = 0;
+        PathResult direct = {0};
+        for (int q = 0, mp = 100; q < 5; q++, mp *= 2) {
+            prepared_solve(pg, mp, STRATEGY_DEAD_ENDS, ctx, &res);
+            solve_path_strategy(g24, mp, STRATEGY_DEAD_ENDS, ctx, &direct);
+            if (res.unique_count != direct.unique_count || res.unique_count != expected[q]) mismatches++;
+            covered += res.unique_count;
+        }
+        // Fixed mutations that block and reopen cells on walls and in rooms alike
+        for (int k = 0; k < 200; k++) prepared_set_blocked(pg, (k * 7) % N, (k * 13 + k / N) % M, k % 3 != 0);
+        long free_count = prepared_free_count(pg);
+        const int *labels = prepared_components(pg, &components, NULL);
+        PreparedGrid *fresh = create_prepared_grid(g24);
+        int fresh_components;
+        const int *fresh_labels = prepared_components(fresh, &fresh_components, NULL);
+        // Labels may be numbered differently; compare the partitions
+        bool same = free_count == prepared_free_count(fresh);
+        for (int i = 0; i < N * M && same; i++) {
+            int j = i + 1 < N * M ? i + 1 : i, k = i + M < N * M ? i + M : i;
+            same = (labels[i] < 0) == (fresh_labels[i] < 0) &&
+                   (labels[i] == labels[j]) == (fresh_labels[i] == fresh_labels[j]) &&
+                   (labels[i] == labels[k]) == (fresh_labels[i] == fresh_labels[k]);
+        }
+        int fr, fc;
+        same = same && prepared_start_cell(pg, &sr, &sc) == prepared_start_cell(fresh, &fr, &fc) && sr == fr && sc == fc;
+        same = same && prepared_coverage_bound(pg, 500).best == coverage_upper_bound(g24, 500).best;
+        prepared_solve(pg, 800, STRATEGY_DEAD_ENDS, ctx, &res);
+        solve_path_strategy(g24, 800, STRATEGY_DEAD_ENDS, ctx, &direct);
+        if (res.unique_count != direct.unique_count) mismatches++;
+        printf("Test 24 (%dx%d prepared grid, 5 queries, 200 mutations):\n", N, M);
+        check(mismatches == 0);
+        printf("%ld squares covered over the queries; %d mismatches against expected and direct solves\n",
+               covered, mismatches);
+        printf("%ld free cells after mutation; artifacts %s a rebuild\n\n", free_count, check(same) ? "match" : "DIFFER FROM");
+        free_prepared_grid(fresh);
+        free_path_result(&res);
+        free_path_result(&direct);
+        free_solve_context(ctx);
+        free_prepared_grid(pg);
+        free_grid(g24);
+    }
+    // Test 25: Fixed-dimension solvers against the generic greedy (forced by tracking visited cells)
+    {
+        SolveContext *fixed = create_solve_context(), *generic = create_solve_context();
+        generic->track_visited = true;
+        PathResult a = {0}, b = {0};
+        int mismatches = 0;
+        for (size_t i = 0; i < sizeof(FIXED_SOLVERS) / sizeof(FIXED_SOLVERS[0]); i++) {
+            int N = FIXED_SOLVERS[i].rows, M = FIXED_SOLVERS[i].cols;
+            Grid *g25 = create_grid(N, M, 0, NULL);
+            generate_blocked(g25, N * M / 20);
+            solve_path_into(g25, N * M, fixed, &a);
+            solve_path_into(g25, N * M, generic, &b);
+            if (a.length != b.length || memcmp(a.path_r, b.path_r, a.length * sizeof(int)) != 0 ||
+                memcmp(a.path_c, b.path_c, a.length * sizeof(int)) != 0) mismatches++;
+            free_grid(g25);
+        }
+        printf("Test 25 (fixed-dimension solvers, %zu sizes):\n", sizeof(FIXED_SOLVERS) / sizeof(FIXED_SOLVERS[0]));
+        check(mismatches == 0);
+        printf("%d paths differ from the generic greedy\n\n", mismatches);
+        free_path_result(&a);
+        free_path_result(&b);
+        free_solve_context(fixed);
+        free_solve_context(generic);
+    }
+    // Test 26: Job stream through temporary files, checked against direct solves
+    {
+        const int JOBS = 300;
+        FILE *in = tmpfile(), *out = tmpfile();
+        Grid *grids[3];
+        for (int k = 0; k < 3; k++) {
+            grids[k] = create_grid(20 + 7 * k, 30 - 5 * k, 0, NULL);
+            generate_blocked(grids[k], 60 * (k + 1));
+        }
+        for (int j = 0; j < JOBS; j++) {
+            const Grid *g = grids[j % 3];
+            size_t stride = ((size_t)g->cols + 7) / 8;
+            uint64_t tag = 1000 + j;
+            // Of every 50 jobs, one names a strategy that does not exist, two have
+            // negative or zero dimensions and no bitmap, one asks for INT_MAX moves,
+            // and one claims 2^40 cells but carries only the bitmap of g, which the
+            // reader must skip rather than allocate for
+            int32_t dims[3] = {g->rows, g->cols, j % 50 == 30 ? INT_MAX : 50 + j};
+            if (j % 50 == 10) dims[0] = -g->rows;
+            if (j % 50 == 20) dims[1] = 0;
+            if (j % 50 == 45) dims[0] = dims[1] = 1 << 20;
+            int rows = dims[0] > 0 && dims[1] > 0 ? g->rows : 0;
+            uint32_t size = JOB_HEADER_BYTES + (uint32_t)(rows * stride);
+            unsigned char opts[4] = {(unsigned char)(j % 50 == 0 ? STRATEGY_COUNT : j % STRATEGY_COUNT),
+                                     j % 2 ? JOB_FLAG_BOUND : 0, 0, 0};
+            fwrite(&size, sizeof(size), 1, in);
+            fwrite(&tag, sizeof(tag), 1, in);
+            fwrite(dims, sizeof(int32_t), 3, in);
+            fwrite(opts, 1, 4, in);
+            for (int r = 0; r < rows; r++) {
+                unsigned char row[8] = {0};
+                for (int c = 0; c < g->cols; c++) row[c >> 3] |= (unsigned char)(g->blocked[r][c] << (c & 7));
+                fwrite(row, 1, stride, in);
+            }
+        }
+        rewind(in);
+        long solved = solve_job_stream(in, out, 3);
+        rewind(out);
+        SolveContext *ctx = create_solve_context();
+        ctx->threads = 1;
+        PathResult res = {0};
+        int mismatches = 0, invalid = 0;
+        for (int j = 0; j < JOBS; j++) {
+            uint32_t size;
+            uint64_t tag;
+            int32_t fields[2], length, start[2] = {0, 0};
+            int64_t bound;
+            unsigned char dirs[2048];
+            if (fread(&size, sizeof(size), 1, out) != 1 || fread(&tag, sizeof(tag), 1, out) != 1 ||
+                fread(fields, sizeof(int32_t), 2, out) != 2 || fread(&bound, sizeof(bound), 1, out) != 1 ||
+                fread(&length, sizeof(length), 1, out) != 1) {
+                mismatches++;
+                break;
+            }
+            if (length > 0 && (fread(start, sizeof(int32_t), 2, out) != 2 ||
+                               fread(dirs, 1, length - 1, out) != (size_t)(length - 1))) {
+                mismatches++;
+                break;
+            }
+            if (fields[0] == JOB_INVALID) {
+                invalid++;
+                bool rejected = (j % 10 == 0 && j % 50 != 40) || j % 50 == 45;
+                mismatches += tag != (uint64_t)(1000 + j) || !rejected || length != 0;
+                continue;
+            }
+            ctx->compute_bound = j % 2;
+            solve_path_strategy(grids[j % 3], 50 + j, (Strategy)(j % STRATEGY_COUNT), ctx, &res);
+            bool same = tag == (uint64_t)(1000 + j) && length == res.length && fields[1] == res.unique_count &&
+                        bound == res.upper_bound && (length == 0 || (start[0] == res.path_r[0] && start[1] == res.path_c[0]));
+            for (int k = 1; k < length && same; k++) {
+                int d = dirs[k - 1];
+                same = res.path_r[k] == res.path_r[k - 1] + DIR_DR[d] && res.path_c[k] == res.path_c[k - 1] + DIR_DC[d];
+            }
+            mismatches += !same;
+        }
+        printf("Test 26 (%d streamed jobs, 3 workers):\n", JOBS);
+        check(mismatches == 0 && solved == JOBS && invalid == JOBS / 50 * 5);
+        printf("%ld jobs read, %d rejected, %d results differ from direct solves\n\n", solved, invalid, mismatches);
+        free_path_result(&res);
+        free_solve_context(ctx);
+        for (int k = 0; k < 3; k++) free_grid(grids[k]);
+        fclose(in);
+        fclose(out);
+    }
+    // Test 27: All-starts heatmap, checked against serial solves from each start
+    {
+        Grid *g27 = create_grid(32, 32, 0, NULL);  // a fixed-dimension size
+        Grid *g27b = create_grid(23, 41, 0, NULL);
+        Grid *g27c = create_grid(100, 101, 0, NULL);  // short paths, whose marks are cleared cell by cell
+        generate_blocked(g27, 200);
+        generate_blocked(g27b, 250);
+        generate_blocked(g27c, 2500);
+        SolveContext *ctx = create_solve_context();
+        PathResult a = {0}, b = {0};
+        int mismatches = 0;
+        // Starting from the first free cell reproduces solve_path_into
+        int first = 0;
+        while (g27->blocked[first / g27->cols][first % g27->cols]) first++;
+        solve_path_into(g27, 300, ctx, &a);
+        solve_path_from(g27, first / g27->cols, first % g27->cols, 300, ctx, &b);
+        mismatches += a.length != b.length || memcmp(a.path_r, b.path_r, a.length * sizeof(int)) != 0 ||
+                      memcmp(a.path_c, b.path_c, a.length * sizeof(int)) != 0;
+        // Blocked and out-of-range starts are rejected
+        int blocked = 0;
+        while (!g27->blocked[blocked / g27->cols][blocked % g27->cols]) blocked++;
+        mismatches += solve_path_from(g27, blocked / g27->cols, blocked % g27->cols, 300, ctx, &b) || b.length != 0;
+        mismatches += solve_path_from(g27, -1, 0, 300, ctx, &b) || solve_path_from(g27, 0, 32, 300, ctx, &b);
+        Grid *grids27[3] = {g27, g27b, g27c};
+        const int budgets27[3] = {120, 120, 30};
+        int best_total = 0;
+        for (int k = 0; k < 3; k++) {
+            const Grid *g = grids27[k];
+            CoverageHeatmap *h1 = create_coverage_heatmap(g, budgets27[k], 1);
+            CoverageHeatmap *h3 = create_coverage_heatmap(g, budgets27[k], 3);
+            mismatches += memcmp(h1->coverage, h3->coverage, (size_t)g->rows * g->cols * sizeof(int)) != 0 ||
+                          h1->best_r != h3->best_r || h1->best_c != h3->best_c;
+            int best = 0;
+            for (int r = 0; r < g->rows; r++) {
+                for (int c = 0; c < g->cols; c++) {
+                    int expect = solve_path_from(g, r, c, budgets27[k], ctx, &b) ? b.unique_count : -1;
+                    mismatches += h3->coverage[r * g->cols + c] != expect;
+                    if (expect > best) best = expect;
+                }
+            }
+            mismatches += h3->best_coverage != best || h3->coverage[h3->best_r * g->cols + h3->best_c] != best;
+            best_total += best;
+            free_coverage_heatmap(h1);
+            free_coverage_heatmap(h3);
+        }
+        printf("Test 27 (all-starts heatmap, 3 grids):\n");
+        check(mismatches == 0);
+        printf("best starts cover %d cells in total, %d mismatches against serial solves\n\n", best_total, mismatches);
+        free_path_result(&a);
+        free_path_result(&b);
+        free_solve_context(ctx);
+        free_grid(g27);
+        free_grid(g27b);
+        free_grid(g27c);
+    }
+    if (test_failures) printf("%d checks FAILED\n", test_failures);
+    return test_failures == 0 ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// Command-line driver. Without arguments the built-in tests run; with any,
+// the options below pick the grid, strategy, budget and output, and
+// --repeat/--stats time repeated solves for benchmarking.
+// ---------------------------------------------------------------------------
+
+#define PATH_FILE_MAGIC "GTPATH01"
+
+typedef enum {
+    FORMAT_TEXT,    // print_path_result's listing
+    FORMAT_BINARY,  // PATH_FILE_MAGIC, int32 length, then int32 (row, col) pairs
+    FORMAT_DIRS,    // "row col " of the start, then one of U R D L (W for a wait) per move
+    FORMAT_NONE
+} PathFormat;
+
+static const char *const PATH_FORMAT_NAMES[] = {"text", "binary", "dirs", "none"};
+
+typedef enum {
+    GENERATOR_RANDOM,   // density * cells blocked uniformly at random
+    GENERATOR_PILLARS,  // single blocked cells on a lattice spaced for the density
+    GENERATOR_OPEN      // no blocked cells
+} GridGenerator;
+
+static const char *const GENERATOR_NAMES[] = {"random", "pillars", "open"};
+
+static void print_usage(FILE *out) {
+    fprintf(out,
+            "Usage: grid-traversal [options]\n"
+            "Without options, runs the built-in tests.\n"
+            "\n"
+            "Grid:\n"
+            "  -r, --rows N          rows of a generated grid (default 100)\n"
+            "  -c, --cols N          columns of a generated grid (default 100)\n"
+            "  -d, --density F       fraction of cells blocked, 0 to 1 (default 0.2)\n"
+            "  -g, --generator NAME  random, pillars or open (default random)\n"
+            "  -s, --seed N          generator seed (default: current time)\n"
+            "  -l, --load FILE       load a grid image instead of generating one\n"
+            "      --save FILE       write the grid image before solving\n"
+            "Solve:\n"
+            "  -S, --strategy NAME   greedy, dead-ends, tile-tour, hilbert, refine, beam or sweep\n"
+            "                        (default greedy)\n"
+            "  -b, --budget N        movement points (default rows * cols)\n"
+            "  -t, --threads N       workers for parallel strategies (default: per strategy)\n"
+            "      --bound           compute the coverage bound and stop on reaching it\n"
+            "Output:\n"
+            "  -f, --format NAME     text, binary, dirs or none (default text)\n"
+            "  -o, --output FILE     write the path to FILE instead of stdout\n"
+            "Timing:\n"
+            "  -n, --repeat N        solve N times (default 1)\n"
+            "      --stats           print timing statistics to stderr\n"
+            "Job stream:\n"
+            "      --jobs            solve binary jobs from stdin, writing results to stdout\n"
+            "                        in order (see solve_job_stream); -t sets the workers\n"
+            "All-starts coverage:\n"
+            "      --heatmap FILE    run the greedy from every free cell, write the coverage\n"
+            "                        as a PGM image and print the best start; -t sets the workers\n"
+            "  -h, --help            show this help\n");
+}
+
+// Index of name in names, or -1
+static int lookup_name(const char *const names[], int count, const char *name) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+static bool parse_long_arg(const char *arg, long min, long max, long *out) {
+    char *end;
+    errno = 0;
+    long v = strtol(arg, &end, 10);
+    if (errno != 0 || end == arg || *end != '\0' || v < min || v > max) return false;
+    *out = v;
+    return true;
+}
+
+static void write_path(FILE *out, const PathResult *res, PathFormat format) {
+    switch (format) {
+    case FORMAT_TEXT:
+        fprint_path_result(out, res);
+        break;
+    case FORMAT_BINARY: {
+        int32_t length = res->length;
+        fwrite(PATH_FILE_MAGIC, 1, 8, out);
+        fwrite(&length, sizeof(length), 1, out);
+        for (int i = 0; i < res->length; i++) {
+            int32_t cell[2] = {res->path_r[i], res->path_c[i]};
+            fwrite(cell, sizeof(int32_t), 2, out);
+        }
+        break;
+    }
+    case FORMAT_DIRS:
+        if (res->length == 0) break;
+        fprintf(out, "%d %d ", res->path_r[0], res->path_c[0]);
+        for (int i = 1; i < res->length; i++) {
+            int dr = res->path_r[i] - res->path_r[i - 1], dc = res->path_c[i] - res->path_c[i - 1];
+            fputc(dr < 0 ? 'U' : dr > 0 ? 'D' : dc > 0 ? 'R' : dc < 0 ? 'L' : 'W', out);
+        }
+        fputc('\n', out);
+        break;
+    default:
+        break;
+    }
+}
+
+static Grid *generate_grid(int rows, int cols, double density, GridGenerator generator) {
+    Grid *g = create_grid(rows, cols, 0, NULL);
+    long cells = (long)rows * cols;
+    if (generator == GENERATOR_RANDOM) {
+        long count = (long)(density * cells + 0.5);
+        generate_blocked(g, count > INT_MAX ? INT_MAX : (int)count);
+    } else if (generator == GENERATOR_PILLARS && density > 0) {
+        // One pillar per spacing x spacing block blocks 1 / spacing^2 of the cells
+        int spacing = 2;
+        while ((double)(spacing + 1) * (spacing + 1) * density <= 1.0 && spacing <= rows + cols) spacing++;
+        for (int r = spacing / 2; r < rows; r += spacing) {
+            for (int c = spacing / 2; c < cols; c += spacing) set_blocked(g, r, c, true);
+        }
+    }
+    return g;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double elapsed_seconds(const struct timespec *t0, const struct timespec *t1) {
+    return (double)(t1->tv_sec - t0->tv_sec) + (double)(t1->tv_nsec - t0->tv_nsec) * 1e-9;
+}
+
+static int run_cli(int argc, char **argv) {
+    enum { OPT_SAVE = 256, OPT_BOUND, OPT_STATS, OPT_JOBS, OPT_HEATMAP };
+    static const struct option options[] = {
+        {"rows", required_argument, NULL, 'r'},
+        {"cols", required_argument, NULL, 'c'},
+        {"density", required_argument, NULL, 'd'},
+        {"generator", required_argument, NULL, 'g'},
+        {"seed", required_argument, NULL, 's'},
+        {"load", required_argument, NULL, 'l'},
+        {"save", required_argument, NULL, OPT_SAVE},
+        {"strategy", required_argument, NULL, 'S'},
+        {"budget", required_argument, NULL, 'b'},
+        {"threads", required_argument, NULL, 't'},
+        {"bound", no_argument, NULL, OPT_BOUND},
+        {"format", required_argument, NULL, 'f'},
+        {"output", required_argument, NULL, 'o'},
+        {"repeat", required_argument, NULL, 'n'},
+        {"stats", no_argument, NULL, OPT_STATS},
+        {"jobs", no_argument, NULL, OPT_JOBS},
+        {"heatmap", required_argument, NULL, OPT_HEATMAP},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    long rows = 100, cols = 100, budget = -1, threads = 0, repeat = 1, seed = (long)time(NULL);
+    double density = 0.2;
+    GridGenerator generator = GENERATOR_RANDOM;
+    Strategy strategy = STRATEGY_GREEDY;
+    PathFormat format = FORMAT_TEXT;
+    const char *load_path = NULL, *save_path = NULL, *output_path = NULL, *heatmap_path = NULL;
+    bool bound = false, stats = false, jobs = false;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "r:c:d:g:s:l:S:b:t:f:o:n:h", options, NULL)) != -1) {
+        bool ok = true;
+        int index;
+        char *end;
+        switch (opt) {
+        case 'r': ok = parse_long_arg(optarg, 1, INT_MAX, &rows); break;
+        case 'c': ok = parse_long_arg(optarg, 1, INT_MAX, &cols); break;
+        case 'd':
+            density = strtod(optarg, &end);
+            ok = end != optarg && *end == '\0' && density >= 0 && density <= 1;
+            break;
+        case 'g':
+            index = lookup_name(GENERATOR_NAMES, 3, optarg);
+            ok = index >= 0;
+            generator = (GridGenerator)index;
+            break;
+        case 's': ok = parse_long_arg(optarg, 0, UINT_MAX, &seed); break;
+        case 'l': load_path = optarg; break;
+        case OPT_SAVE: save_path = optarg; break;
+        case 'S':
+            index = lookup_name(STRATEGY_NAMES, STRATEGY_COUNT, optarg);
+            ok = index >= 0;
+            strategy = (Strategy)index;
+            break;
+        case 'b': ok = parse_long_arg(optarg, 0, INT_MAX - 1, &budget); break;
+        case 't': ok = parse_long_arg(optarg, 1, 1024, &threads); break;
+        case OPT_BOUND: bound = true; break;
+        case 'f':
+            index = lookup_name(PATH_FORMAT_NAMES, 4, optarg);
+            ok = index >= 0;
+            format = (PathFormat)index;
+            break;
+        case 'o': output_path = optarg; break;
+        case 'n': ok = parse_long_arg(optarg, 1, INT_MAX, &repeat); break;
+        case OPT_STATS: stats = true; break;
+        case OPT_JOBS: jobs = true; break;
+        case OPT_HEATMAP: heatmap_path = optarg; break;
+        case 'h':
+            print_usage(stdout);
+            return 0;
+        default:
+            print_usage(stderr);
+            return 2;
+        }
+        if (!ok) {
+            fprintf(stderr, "Invalid value for -%c: %s\n", opt, optarg);
+            return 2;
+        }
+    }
+    if (optind < argc) {
+        fprintf(stderr, "Unexpected argument: %s\n", argv[optind]);
+        print_usage(stderr);
+        return 2;
+    }
+
+    struct timespec t0, t1;
+    if (jobs) {
+        static char in_buf[1 << 20], out_buf[1 << 20];
+        setvbuf(stdin, in_buf, _IOFBF, sizeof(in_buf));
+        setvbuf(stdout, out_buf, _IOFBF, sizeof(out_buf));
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        long solved = solve_job_stream(stdin, stdout, (int)threads);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        if (solved < 0) {
+            fprintf(stderr, "Job stream ended in a truncated or malformed record\n");
+            return 1;
+        }
+        if (stats) {
+            double seconds = elapsed_seconds(&t0, &t1);
+            fprintf(stderr, "%ld jobs in %.3f s, %.0f jobs/s\n", solved, seconds, seconds > 0 ? solved / seconds : 0.0);
+        }
+        return 0;
+    }
+
+    Grid *g;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (load_path) {
+        g = load_grid_binary(load_path);
+        if (!g) {
+            fprintf(stderr, "Could not load grid image %s\n", load_path);
+            return 1;
+        }
+    } else {
+        if (rows * cols > (long)INT_MAX) {
+            fprintf(stderr, "Grid of %ldx%ld cells is too large\n", rows, cols);
+            return 1;
+        }
+        srand((unsigned)seed);
+        g = generate_grid((int)rows, (int)cols, density, generator);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double setup = elapsed_seconds(&t0, &t1);
+    if (save_path && !save_grid_binary(g, save_path)) {
+        fprintf(stderr, "Could not write grid image %s\n", save_path);
+        free_grid(g);
+        return 1;
+    }
+    if (budget < 0) budget = (long)g->rows * g->cols;
+
+    if (heatmap_path) {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        CoverageHeatmap *h = create_coverage_heatmap(g, (int)budget, (int)threads);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        int status = save_coverage_heatmap(h, heatmap_path) ? 0 : 1;
+        if (h->best_r >= 0) printf("best start %d %d covers %d cells\n", h->best_r, h->best_c, h->best_coverage);
+        else printf("no free cell\n");
+        if (stats) {
+            double seconds = elapsed_seconds(&t0, &t1);
+            long starts = 0;
+            for (long i = 0; i < (long)g->rows * g->cols; i++) starts += h->coverage[i] >= 0;
+            fprintf(stderr, "%ld starts in %.3f s, %.0f starts/s\n", starts, seconds, seconds > 0 ? starts / seconds : 0.0);
+        }
+        free_coverage_heatmap(h);
+        free_grid(g);
+        return status;
+    }
+
+    SolveContext *ctx = create_solve_context();
+    ctx->compute_bound = bound;
+    ctx->threads = (int)threads;
+    PathResult res = {0};
+    double *times = (double*)malloc(repeat * sizeof(double));
+    if (!times) {
+        fprintf(stderr, "Memory allocation failed for %ld timings\n", repeat);
+        exit(1);
+    }
+    for (long i = 0; i < repeat; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        solve_path_strategy(g, (int)budget, strategy, ctx, &res);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        times[i] = elapsed_seconds(&t0, &t1);
+    }
+
+    int status = 0;
+    if (format != FORMAT_NONE) {
+        FILE *out = output_path ? fopen(output_path, format == FORMAT_BINARY ? "wb" : "w") : stdout;
+        if (!out) {
+            fprintf(stderr, "Could not open %s: %s\n", output_path, strerror(errno));
+            status = 1;
+        } else {
+            write_path(out, &res, format);
+            if (out != stdout && fclose(out) != 0) status = 1;
+        }
+    }
+    if (stats) {
+        double total = 0;
+        for (long i = 0; i < repeat; i++) total += times[i];
+        qsort(times, repeat, sizeof(double), compare_doubles);
+        fprintf(stderr, "grid %dx%d (%s in %.3f ms), strategy %s, budget %ld, %ld run%s\n",
+                g->rows, g->cols, load_path ? "loaded" : GENERATOR_NAMES[generator], setup * 1e3,
+                STRATEGY_NAMES[strategy], budget, repeat, repeat == 1 ? "" : "s");
+        fprintf(stderr, "covered %d cells in %d moves", res.unique_count, res.length > 0 ? res.length - 1 : 0);
+        if (res.upper_bound > 0) fprintf(stderr, " (bound %ld)", res.upper_bound);
+        fprintf(stderr, "\nsolve ms: min %.3f, median %.3f, mean %.3f, max %.3f; %.1f M moves/s\n",
+                times[0] * 1e3, times[repeat / 2] * 1e3, total / repeat * 1e3, times[repeat - 1] * 1e3,
+                total > 0 ? (double)(res.length > 0 ? res.length - 1 : 0) * repeat / total * 1e-6 : 0.0);
+    }
+    free(times);
+    free_path_result(&res);
+    free_solve_context(ctx);
+    free_grid(g);
+    return status;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) return run_cli(argc, argv);
+    return run_tests();
+}
+
+#endif
@@ -0,0 +1,268 @@
+// Public interface of the grid traversal core (grid_traversal.c).
+//
+// Grids, paths, solve contexts and the option structs are plain structs owned
+// by the caller through the create_X/free_X pairs; the remaining types are
+// opaque. Build grid_traversal.c with GRID_TRAVERSAL_NO_MAIN to link the core
+// into another program.
+
+#ifndef GRID_TRAVERSAL_H
+#define GRID_TRAVERSAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct BitPyramid BitPyramid;
+typedef struct GridAnalysis GridAnalysis;
+typedef struct IntervalGrid IntervalGrid;
+typedef struct ObstacleSchedule ObstacleSchedule;
+typedef struct PreparedGrid PreparedGrid;
+typedef struct ResultCache ResultCache;
+typedef struct ScheduleSearch ScheduleSearch;
+typedef struct ShapeCache ShapeCache;
+typedef struct GridStore GridStore;
+typedef struct GridImageView GridImageView;
+
+// Struct to represent the grid with blocked/unblocked cells
+typedef struct {
+    int rows, cols;
+    bool **blocked;  // 2D array: true = blocked, false = free
+    unsigned char **nbr_mask;  // 4-bit free-neighbor mask per cell, two cells per byte
+    unsigned char *mask_block;  // storage behind nbr_mask when the grid owns it, else NULL
+    BitPyramid *blocked_pyramid;  // count pyramid over blocked, NULL if not maintained
+    uint64_t hash;  // content hash of the blocked cells, maintained on mutation
+    GridAnalysis *analysis;  // cached by grid_analysis and dead-ends solves, dropped on mutation
+    IntervalGrid *intervals;  // free row intervals, built by refresh_grid, dropped on mutation (see grid_intervals)
+    uint16_t *weight;  // per-cell weights, row-major; NULL when every cell weighs 1
+    uint64_t weight_hash;  // content hash of the weights, 0 when unweighted
+} Grid;
+
+// Path produced by a solve. The arrays are owned by the result and reused across solves.
+typedef struct {
+    int *path_r, *path_c;
+    int length;        // number of cells on the path (moves made + 1), 0 if there is no free cell
+    int capacity;      // allocated length of path_r/path_c
+    int unique_count;  // distinct cells visited
+    long weight;       // weight of the distinct cells visited, filled in by solve_path_strategy
+    long upper_bound;  // bound on weight (on unique_count for unweighted grids) when computed, else 0
+} PathResult;
+
+// Scratch memory reused across solves so repeated queries do not allocate
+typedef struct {
+    unsigned char *vis_mask;
+    size_t vis_capacity;
+    bool track_visited;           // maintain visited_pyramid during solves
+    bool compute_bound;           // solve_path_strategy fills in PathResult.upper_bound
+    BitPyramid *visited_pyramid;  // visited cells of the last solve, if tracked
+    int threads;                  // workers for parallel strategies, 0 for their default
+    ScheduleSearch *schedule_search;  // search state of scheduled solves, NULL until the first one
+} SolveContext;
+
+// Bounds on the coverage of a walk; see coverage_upper_bound
+typedef struct {
+    long component;   // free cells reachable from the start
+    long budget;      // movement_points + 1
+    long parity;
+    long dead_end;
+    long best;        // minimum of the bounds above
+} CoverageBound;
+
+typedef struct {
+    int threads;             // parallel restarts, 0 for REFINE_THREADS
+    long iterations;         // local moves per restart
+    uint64_t seed;
+} RefineOptions;
+
+// Planning strategies selectable through solve_path_strategy; see STRATEGY_NAMES
+typedef enum {
+    STRATEGY_GREEDY,     // solve_path_into
+    STRATEGY_DEAD_ENDS,  // solve_dead_ends_first, caching the analysis on the grid (see grid_analysis)
+    STRATEGY_TILE_TOUR,  // solve_tile_tour
+    STRATEGY_HILBERT,    // solve_hilbert_sweep
+    STRATEGY_REFINE,     // solve_tile_tour (solve_beam on weighted grids) improved by refine_path
+    STRATEGY_BEAM,       // solve_beam with BEAM_WIDTH walks
+    STRATEGY_SWEEP,      // solve_interval_sweep over the grid's row intervals (see grid_intervals)
+    STRATEGY_COUNT
+} Strategy;
+
+// Command-line names of the strategies, indexed by Strategy
+extern const char *const STRATEGY_NAMES[STRATEGY_COUNT];
+
+typedef enum {
+    OCCUPANCY_U8,      // blocked when value >= threshold
+    OCCUPANCY_I8,      // blocked when value >= threshold, or negative (unknown) if unknown_blocked
+    OCCUPANCY_BITMAP   // one bit per cell, least significant bit first, 1 = blocked
+} OccupancyType;
+
+// Occupancy map in caller-owned memory; see make_grid_view
+typedef struct {
+    const unsigned char *data;
+    int rows, cols;
+    size_t stride;         // bytes between the starts of consecutive rows
+    OccupancyType type;
+    int threshold;
+    bool unknown_blocked;
+} GridView;
+
+// Cell (r, c) is blocked at times [start, end)
+typedef struct {
+    int r, c;
+    int start, end;
+} ScheduledBlock;
+
+typedef struct {
+    long unique_count;
+    long moves;
+    long tile_hits, tile_misses;   // lookups that found / did not find the tile resident
+    long tiles_read, tiles_written, tiles_prefetched;
+} OutOfCoreStats;
+
+// Greedy coverage reached from every start cell; see create_coverage_heatmap
+typedef struct {
+    int rows, cols;
+    int movement_points;
+    int *coverage;          // rows * cols, row-major; -1 for blocked cells
+    int best_r, best_c;     // first start in row-major order with the best coverage, -1 if none
+    int best_coverage;
+} CoverageHeatmap;
+
+// Count pyramids
+BitPyramid *create_bit_pyramid(int rows, int cols);
+void free_bit_pyramid(BitPyramid *p);
+void bit_pyramid_set(BitPyramid *p, int r, int c, bool value);
+void bit_pyramid_clear(BitPyramid *p);
+int pyramid_block_state(const BitPyramid *p, int k, int br, int bc);
+bool pyramid_nearest_open(const BitPyramid *blocked, const BitPyramid *visited, int r, int c,
+                          int *out_r, int *out_c);
+
+// Grids
+Grid *create_grid(int rows, int cols, int blocked_count, const int blocked_list[][2]);
+void free_grid(Grid *g);
+void set_blocked(Grid *g, int r, int c, bool blocked);
+void refresh_grid(Grid *g);
+void set_cell_weight(Grid *g, int r, int c, unsigned weight);
+void clear_cell_weights(Grid *g);
+void generate_blocked(Grid *g, int num_blocked);
+void print_grid(const Grid *g);
+void print_coverage(const Grid *g, const BitPyramid *visited);
+
+// Paths and solves
+void free_path_result(PathResult *res);
+void print_path_result(const PathResult *res);
+void fprint_path_result(FILE *out, const PathResult *res);
+SolveContext *create_solve_context(void);
+void free_solve_context(SolveContext *ctx);
+void solve_path_into(const Grid *g, int movement_points, SolveContext *ctx, PathResult *res);
+bool solve_path_from(const Grid *g, int start_r, int start_c, int movement_points,
+                     SolveContext *ctx, PathResult *res);
+void solve_path(Grid *g, int movement_points);
+void solve_path_strategy(const Grid *g, int movement_points, Strategy strategy,
+                         SolveContext *ctx, PathResult *res);
+void solve_path_batch(const Grid *const grids[], const int movement_points[], int count,
+                      PathResult results[]);
+void solve_path_small_batch(const Grid *const grids[], const int movement_points[], int count,
+                            PathResult results[]);
+void refine_path(const Grid *g, int movement_points, long target, const RefineOptions *opt, PathResult *res);
+long path_weight(const Grid *g, const PathResult *res, SolveContext *ctx);
+CoverageBound coverage_upper_bound(const Grid *g, int movement_points);
+
+// Connectivity analysis
+GridAnalysis *create_grid_analysis(const Grid *g);
+void free_grid_analysis(GridAnalysis *a);
+const GridAnalysis *grid_analysis(Grid *g);
+
+// Views over caller-owned occupancy buffers
+GridView make_grid_view(const void *data, int rows, int cols, size_t stride,
+                        OccupancyType type, int threshold, bool unknown_blocked);
+void solve_path_view(const GridView *v, int movement_points, SolveContext *ctx, PathResult *res);
+Grid *grid_from_view(const GridView *v);
+
+// Row intervals
+IntervalGrid *create_interval_grid(const Grid *g);
+const IntervalGrid *grid_intervals(Grid *g);
+void free_interval_grid(IntervalGrid *ig);
+long interval_free_count(const IntervalGrid *ig);
+int interval_at(const IntervalGrid *ig, int r, int c);
+int interval_label_components(const IntervalGrid *ig, int *labels, long *sizes);
+int interval_sweep_cells(const IntervalGrid *ig, int *cell_of);
+
+// Time-scheduled obstacles
+ObstacleSchedule *create_obstacle_schedule(int rows, int cols, const ScheduledBlock *blocks, int count);
+void free_obstacle_schedule(ObstacleSchedule *s);
+bool cell_blocked_at(const ObstacleSchedule *s, int r, int c, int t);
+bool solve_path_scheduled(const Grid *g, const ObstacleSchedule *sched, int movement_points,
+                          SolveContext *ctx, PathResult *res);
+
+// Prepared grids
+PreparedGrid *create_prepared_grid(Grid *g);
+void free_prepared_grid(PreparedGrid *pg);
+bool prepared_start_cell(PreparedGrid *pg, int *start_r, int *start_c);
+long prepared_free_count(PreparedGrid *pg);
+const int *prepared_components(PreparedGrid *pg, int *component_count, const long **component_sizes);
+const GridAnalysis *prepared_analysis(PreparedGrid *pg);
+CoverageBound prepared_coverage_bound(PreparedGrid *pg, int movement_points);
+const uint16_t *prepared_wall_distance(PreparedGrid *pg);
+const IntervalGrid *prepared_intervals(PreparedGrid *pg);
+void prepared_set_blocked(PreparedGrid *pg, int r, int c, bool blocked);
+void prepared_solve(PreparedGrid *pg, int movement_points, Strategy strategy, SolveContext *ctx, PathResult *res);
+
+// Result caches
+ResultCache *create_result_cache(size_t max_bytes);
+void free_result_cache(ResultCache *cache);
+void result_cache_stats(ResultCache *cache, long *hits, long *misses, long *evictions, size_t *bytes);
+void solve_path_cached(ResultCache *cache, const Grid *g, int movement_points, Strategy strategy,
+                       SolveContext *ctx, PathResult *res);
+ShapeCache *create_shape_cache(void);
+void free_shape_cache(ShapeCache *cache);
+void shape_cache_stats(const ShapeCache *cache, long *hits, long *misses, int *entries, size_t *bytes);
+bool shape_cache_lookup(ShapeCache *cache, const Grid *g, int movement_points, PathResult *res);
+void shape_cache_store(ShapeCache *cache, const Grid *g, int movement_points, const PathResult *res);
+void solve_path_shape_cached(ShapeCache *cache, const Grid *g, int movement_points, Strategy strategy,
+                             SolveContext *ctx, PathResult *res);
+bool save_shape_cache(const ShapeCache *cache, const char *path);
+ShapeCache *load_shape_cache(const char *path);
+
+// Versioned snapshots for concurrent readers
+GridStore *create_grid_store(const Grid *g);
+void free_grid_store(GridStore *store);
+int grid_store_pin(GridStore *store, const Grid **grid);
+uint64_t grid_store_pinned_version(GridStore *store, int slot);
+void grid_store_unpin(GridStore *store, int slot);
+uint64_t grid_store_update(GridStore *store, const int cells[][2], const bool blocked[], int count);
+
+// Grid images and shared-memory hosting
+bool save_grid_binary(const Grid *g, const char *path);
+GridImageView *map_grid_binary(const char *path);
+const Grid *grid_image_view_grid(const GridImageView *view);
+Grid *load_grid_binary(const char *path);
+uint32_t publish_shared_grid(const char *name, const Grid *g);
+GridImageView *attach_shared_grid(const char *name);
+bool shared_grid_wait(GridImageView *view, int timeout_ms);
+bool shared_grid_reattach(GridImageView *view);
+void detach_grid_view(GridImageView *view);
+void unlink_shared_grid(const char *name);
+
+// Tiled grids solved out of core
+bool save_tiled_grid(const Grid *g, const char *path, int tile_size);
+bool generate_tiled_grid(const char *path, int rows, int cols, int tile_size, double density);
+bool solve_path_out_of_core(const char *grid_path, long movement_points, size_t memory_cap,
+                            bool read_ahead, FILE *path_out, OutOfCoreStats *stats);
+
+// Binary job streams
+long solve_job_stream(FILE *in, FILE *out, int workers);
+
+// All-starts coverage
+CoverageHeatmap *create_coverage_heatmap(const Grid *g, int movement_points, int threads);
+void free_coverage_heatmap(CoverageHeatmap *h);
+bool save_coverage_heatmap(const CoverageHeatmap *h, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,365 @@
+// C++20 frontend over the grid traversal core (grid_traversal.h).
+//
+// RAII owners for core grids, solve contexts and paths; zero-copy occupancy
+// views over std::span (and std::mdspan where the standard library has it);
+// and a greedy solver whose move order, connectivity and cost model are
+// template policies, so each combination compiles to one inlined step loop
+// with no virtual calls. Solves reuse the context's and path's buffers and do
+// not allocate once those have grown to the largest query.
+
+#ifndef GRID_TRAVERSAL_HPP
+#define GRID_TRAVERSAL_HPP
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#if __has_include(<mdspan>)
+#include <mdspan>
+#endif
+
+#include "grid_traversal.h"
+
+namespace gt {
+
+// ---------------------------------------------------------------------------
+// Occupancy views.
+//
+// An OccupancyView reads a caller-owned map in place. The encoding is a policy,
+// so blocked() compiles to a single load and compare.
+// ---------------------------------------------------------------------------
+
+// One byte per cell, blocked when value >= threshold
+struct U8Occupancy {
+    static constexpr OccupancyType type = OCCUPANCY_U8;
+    static bool blocked(const unsigned char *row, int c, int threshold, bool) {
+        return row[c] >= threshold;
+    }
+};
+
+// One signed byte per cell; negative values are unknown
+struct I8Occupancy {
+    static constexpr OccupancyType type = OCCUPANCY_I8;
+    static bool blocked(const unsigned char *row, int c, int threshold, bool unknown_blocked) {
+        int value = static_cast<signed char>(row[c]);
+        return value < 0 ? unknown_blocked : value >= threshold;
+    }
+};
+
+// One bit per cell, least significant bit first, 1 = blocked
+struct BitmapOccupancy {
+    static constexpr OccupancyType type = OCCUPANCY_BITMAP;
+    static bool blocked(const unsigned char *row, int c, int, bool) {
+        return (row[c >> 3] >> (c & 7)) & 1;
+    }
+};
+
+template <class Encoding>
+class OccupancyView {
+public:
+    // rows x cols cells starting at data, rows stride bytes apart
+    OccupancyView(std::span<const std::uint8_t> data, int rows, int cols, std::size_t stride,
+                  int threshold = 1, bool unknown_blocked = true)
+        : view_(make_grid_view(data.data(), rows, cols, stride, Encoding::type, threshold, unknown_blocked)) {}
+
+#if defined(__cpp_lib_mdspan)
+    // A rows x cols byte mdspan whose cells are contiguous within a row
+    template <class Extents, class Layout, class Accessor>
+        requires(Extents::rank() == 2 && Encoding::type != OCCUPANCY_BITMAP)
+    OccupancyView(std::mdspan<const std::uint8_t, Extents, Layout, Accessor> map,
+                  int threshold = 1, bool unknown_blocked = true)
+        : view_(make_grid_view(map.data_handle(), static_cast<int>(map.extent(0)), static_cast<int>(map.extent(1)),
+                               static_cast<std::size_t>(map.stride(0)), Encoding::type, threshold, unknown_blocked)) {}
+#endif
+
+    int rows() const { return view_.rows; }
+    int cols() const { return view_.cols; }
+    bool blocked(int r, int c) const {
+        return Encoding::blocked(view_.data + static_cast<std::size_t>(r) * view_.stride, c,
+                                 view_.threshold, view_.unknown_blocked);
+    }
+    const GridView &c_view() const { return view_; }
+
+private:
+    GridView view_;
+};
+
+// Row-major byte maps with rows packed back to back
+inline OccupancyView<U8Occupancy> u8_view(std::span<const std::uint8_t> cells, int rows, int cols,
+                                          int threshold = 1) {
+    return {cells, rows, cols, static_cast<std::size_t>(cols), threshold};
+}
+
+inline OccupancyView<I8Occupancy> i8_view(std::span<const std::int8_t> cells, int rows, int cols,
+                                          int threshold, bool unknown_blocked = true) {
+    std::span<const std::uint8_t> bytes(reinterpret_cast<const std::uint8_t *>(cells.data()), cells.size());
+    return {bytes, rows, cols, static_cast<std::size_t>(cols), threshold, unknown_blocked};
+}
+
+inline OccupancyView<BitmapOccupancy> bitmap_view(std::span<const std::uint8_t> bits, int rows, int cols) {
+    return {bits, rows, cols, static_cast<std::size_t>((cols + 7) / 8)};
+}
+
+// ---------------------------------------------------------------------------
+// RAII owners.
+// ---------------------------------------------------------------------------
+
+class Grid {
+public:
+    Grid(int rows, int cols) : g_(create_grid(rows, cols, 0, nullptr)) {}
+
+    // Row-major map, true = blocked, written straight into the grid rows; throws
+    // std::invalid_argument if the map holds fewer than rows x cols cells
+    Grid(int rows, int cols, const std::vector<bool> &blocked)
+        : g_((check_map(rows, cols, blocked), create_grid(rows, cols, 0, nullptr))) {
+        for (int r = 0; r < rows; r++) {
+            for (int c = 0; c < cols; c++) g_->blocked[r][c] = blocked[static_cast<std::size_t>(r) * cols + c];
+        }
+        refresh_grid(g_.get());
+    }
+
+    // Packed copy of a view, for the strategies that need the core grid
+    template <class Encoding>
+    explicit Grid(const OccupancyView<Encoding> &view) : g_(grid_from_view(&view.c_view())) {}
+
+    int rows() const { return g_->rows; }
+    int cols() const { return g_->cols; }
+    bool blocked(int r, int c) const { return g_->blocked[r][c]; }
+    void set_blocked(int r, int c, bool blocked) { ::set_blocked(g_.get(), r, c, blocked); }
+    void set_weight(int r, int c, unsigned weight) { set_cell_weight(g_.get(), r, c, weight); }
+
+    ::Grid *get() { return g_.get(); }
+    const ::Grid *get() const { return g_.get(); }
+
+private:
+    static void check_map(int rows, int cols, const std::vector<bool> &blocked) {
+        if (rows < 0 || cols < 0 || blocked.size() < static_cast<std::size_t>(rows) * static_cast<std::size_t>(cols))
+            throw std::invalid_argument("gt::Grid: map smaller than rows x cols");
+    }
+
+    struct Deleter {
+        void operator()(::Grid *g) const noexcept { free_grid(g); }
+    };
+    std::unique_ptr<::Grid, Deleter> g_;
+};
+
+class Path {
+public:
+    Path() = default;
+    Path(const Path &) = delete;
+    Path &operator=(const Path &) = delete;
+    Path(Path &&other) noexcept : res_(std::exchange(other.res_, PathResult{})) {}
+    Path &operator=(Path &&other) noexcept {
+        std::swap(res_, other.res_);
+        return *this;
+    }
+    ~Path() { free_path_result(&res_); }
+
+    int length() const { return res_.length; }
+    int unique_count() const { return res_.unique_count; }
+    long weight() const { return res_.weight; }
+    long upper_bound() const { return res_.upper_bound; }
+    std::span<const int> rows() const { return {res_.path_r, static_cast<std::size_t>(res_.length)}; }
+    std::span<const int> cols() const { return {res_.path_c, static_cast<std::size_t>(res_.length)}; }
+
+    // Grow the arrays to hold length cells; they stay malloc-owned for free_path_result
+    void reserve(int length) {
+        if (length <= res_.capacity) return;
+        int *pr = static_cast<int *>(std::realloc(res_.path_r, length * sizeof(int)));
+        if (pr) res_.path_r = pr;
+        int *pc = static_cast<int *>(std::realloc(res_.path_c, length * sizeof(int)));
+        if (pc) res_.path_c = pc;
+        if (!pr || !pc) throw std::bad_alloc();
+        res_.capacity = length;
+    }
+
+    PathResult *get() { return &res_; }
+    const PathResult *get() const { return &res_; }
+
+private:
+    PathResult res_{};
+};
+
+class Context {
+public:
+    Context() : ctx_(create_solve_context()) {}
+
+    // Have solves compute the coverage bound, stop at it and report it
+    void compute_bound(bool on) { ctx_->compute_bound = on; }
+
+    SolveContext *get() { return ctx_.get(); }
+
+    // Zeroed visited bitset covering the given number of cells, reused across solves
+    std::span<std::uint64_t> visited(std::size_t cells) {
+        std::size_t words = (cells >> 6) + 1;
+        if (visited_.size() < words) visited_.resize(words);
+        std::fill_n(visited_.begin(), words, 0);
+        return {visited_.data(), words};
+    }
+
+private:
+    struct Deleter {
+        void operator()(SolveContext *ctx) const noexcept { free_solve_context(ctx); }
+    };
+    std::unique_ptr<SolveContext, Deleter> ctx_;
+    std::vector<std::uint64_t> visited_;
+};
+
+// Core strategies (see Strategy) on a core grid
+inline void solve(const Grid &g, int movement_points, Strategy strategy, Context &ctx, Path &out) {
+    solve_path_strategy(g.get(), movement_points, strategy, ctx.get(), out.get());
+}
+
+// The core greedy from an explicit start; false if the start is blocked or outside the grid
+inline bool solve_from(const Grid &g, int start_r, int start_c, int movement_points, Context &ctx, Path &out) {
+    return solve_path_from(g.get(), start_r, start_c, movement_points, ctx.get(), out.get());
+}
+
+// The core greedy, reading a view in place
+template <class Encoding>
+void solve(const OccupancyView<Encoding> &view, int movement_points, Context &ctx, Path &out) {
+    solve_path_view(&view.c_view(), movement_points, ctx.get(), out.get());
+}
+
+// ---------------------------------------------------------------------------
+// Policy-based greedy.
+//
+// greedy<Order, Connectivity, Cost>(map, ...) runs the rule of solve_path_into
+// (step to the first unvisited free neighbor, else to the first free neighbor
+// that has one, else stop) with the neighborhood, the order neighbors are
+// tried in and the movement points each move costs supplied as policies.
+// With the defaults the path is the core greedy's.
+// ---------------------------------------------------------------------------
+
+// Up, right, down, left
+struct FourConnected {
+    static constexpr int count = 4;
+    static constexpr std::array<int, 4> dr{-1, 0, 1, 0};
+    static constexpr std::array<int, 4> dc{0, 1, 0, -1};
+};
+
+// Up, up-right, right, ... clockwise
+struct EightConnected {
+    static constexpr int count = 8;
+    static constexpr std::array<int, 8> dr{-1, -1, 0, 1, 1, 1, 0, -1};
+    static constexpr std::array<int, 8> dc{0, 1, 1, 1, 0, -1, -1, -1};
+};
+
+// Neighbors tried clockwise from up, the core's order
+struct ClockwiseOrder {
+    template <class Connectivity>
+    static constexpr std::array<int, Connectivity::count> order() {
+        std::array<int, Connectivity::count> a{};
+        for (int i = 0; i < Connectivity::count; i++) a[i] = i;
+        return a;
+    }
+};
+
+// Neighbors tried counter-clockwise from up
+struct CounterClockwiseOrder {
+    template <class Connectivity>
+    static constexpr std::array<int, Connectivity::count> order() {
+        std::array<int, Connectivity::count> a{};
+        for (int i = 0; i < Connectivity::count; i++) a[i] = (Connectivity::count - i) % Connectivity::count;
+        return a;
+    }
+};
+
+// Every move costs one movement point
+struct UnitCost {
+    static constexpr int cost(int, int) { return 1; }
+};
+
+// A move costs its Manhattan length, so diagonal steps cost two
+struct ManhattanCost {
+    static constexpr int cost(int dr, int dc) { return (dr < 0 ? -dr : dr) + (dc < 0 ? -dc : dc); }
+};
+
+template <class M>
+concept OccupancyMap = requires(const M &m, int r, int c) {
+    { m.rows() } -> std::convertible_to<int>;
+    { m.cols() } -> std::convertible_to<int>;
+    { m.blocked(r, c) } -> std::convertible_to<bool>;
+};
+
+template <class Order = ClockwiseOrder, class Connectivity = FourConnected, class Cost = UnitCost,
+          OccupancyMap Map>
+void greedy(const Map &map, int movement_points, Context &ctx, Path &out) {
+    constexpr auto order = Order::template order<Connectivity>();
+    const int rows = map.rows(), cols = map.cols();
+    if (movement_points < 0) movement_points = 0;
+    out.reserve(movement_points + 1);
+    PathResult *res = out.get();
+    res->length = res->unique_count = 0;
+    res->weight = res->upper_bound = 0;
+    int cr = -1, cc = -1;
+    for (int r = 0; r < rows && cr < 0; r++) {
+        for (int c = 0; c < cols; c++) {
+            if (!map.blocked(r, c)) {
+                cr = r;
+                cc = c;
+                break;
+            }
+        }
+    }
+    if (cr < 0) return;
+    std::span<std::uint64_t> visited = ctx.visited(static_cast<std::size_t>(rows) * cols);
+    auto index = [cols](int r, int c) { return static_cast<std::size_t>(r) * cols + c; };
+    auto is_free = [&](int r, int c) { return r >= 0 && r < rows && c >= 0 && c < cols && !map.blocked(r, c); };
+    auto is_open = [&](int r, int c) {
+        return is_free(r, c) && !(visited[index(r, c) >> 6] >> (index(r, c) & 63) & 1);
+    };
+    auto visit = [&](int r, int c) { visited[index(r, c) >> 6] |= std::uint64_t{1} << (index(r, c) & 63); };
+    visit(cr, cc);
+    res->path_r[0] = cr;
+    res->path_c[0] = cc;
+    res->length = res->unique_count = 1;
+    int left = movement_points;
+    while (left > 0) {
+        int next = -1;
+        bool forward = false;
+        for (int d : order) {
+            if (Cost::cost(Connectivity::dr[d], Connectivity::dc[d]) <= left &&
+                is_open(cr + Connectivity::dr[d], cc + Connectivity::dc[d])) {
+                next = d;
+                forward = true;
+                break;
+            }
+        }
+        for (int i = 0; i < Connectivity::count && next < 0; i++) {
+            int d = order[i];
+            int nr = cr + Connectivity::dr[d], nc = cc + Connectivity::dc[d];
+            if (Cost::cost(Connectivity::dr[d], Connectivity::dc[d]) > left || !is_free(nr, nc)) continue;
+            for (int e : order) {
+                if (is_open(nr + Connectivity::dr[e], nc + Connectivity::dc[e])) {
+                    next = d;
+                    break;
+                }
+            }
+        }
+        if (next < 0) break;
+        left -= Cost::cost(Connectivity::dr[next], Connectivity::dc[next]);
+        cr += Connectivity::dr[next];
+        cc += Connectivity::dc[next];
+        if (forward) {
+            visit(cr, cc);
+            res->unique_count++;
+        }
+        res->path_r[res->length] = cr;
+        res->path_c[res->length] = cc;
+        res->length++;
+    }
+    res->weight = res->unique_count;
+}
+
+}  // namespace gt
+
+#endif
@@ -0,0 +1,79 @@
+// Checks of the C++20 layer (grid_traversal.hpp) against the core: the policy
+// greedy with default policies must reproduce the core greedy's path on the
+// same map, whether the core reads a view in place or a packed grid.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "grid_traversal.hpp"
+
+static bool same_path(const gt::Path &a, const gt::Path &b) {
+    return a.length() == b.length() && a.unique_count() == b.unique_count() &&
+           std::ranges::equal(a.rows(), b.rows()) && std::ranges::equal(a.cols(), b.cols());
+}
+
+int main() {
+    int failures = 0;
+
+    // Test 1: gt::greedy against gt::solve on random maps, read as a view and as a grid
+    {
+        std::mt19937 rng(7);
+        gt::Context ctx;
+        gt::Path policy, core;
+        int differ = 0;
+        const int trials = 100;
+        for (int t = 0; t < trials; t++) {
+            int rows = 4 + static_cast<int>(rng() % 40), cols = 4 + static_cast<int>(rng() % 40);
+            std::vector<std::uint8_t> cells(static_cast<std::size_t>(rows) * cols);
+            std::vector<bool> blocked(cells.size());
+            for (std::size_t i = 0; i < cells.size(); i++) {
+                cells[i] = rng() % 4 == 0 ? 255 : 0;
+                blocked[i] = cells[i] != 0;
+            }
+            auto view = gt::u8_view(cells, rows, cols);
+            gt::Grid grid(rows, cols, blocked);
+            int mp = static_cast<int>(rng() % (2 * cells.size()));
+            gt::greedy(view, mp, ctx, policy);
+            gt::solve(view, mp, ctx, core);
+            if (!same_path(policy, core)) differ++;
+            gt::solve(grid, mp, STRATEGY_GREEDY, ctx, core);
+            if (!same_path(policy, core)) differ++;
+        }
+        std::printf("Test 1 (%d random maps): %d paths differ from the core greedy\n", trials, differ);
+        failures += differ;
+    }
+
+    // Test 2: A map shorter than rows x cols is rejected
+    {
+        bool thrown = false;
+        try {
+            gt::Grid grid(3, 3, std::vector<bool>(8));
+        } catch (const std::invalid_argument &) {
+            thrown = true;
+        }
+        std::printf("Test 2 (8 cells for a 3x3 grid): %s\n", thrown ? "rejected" : "ACCEPTED");
+        failures += !thrown;
+    }
+
+#if defined(__cpp_lib_mdspan)
+    // Test 3: An mdspan view reads the same map as a span view
+    {
+        std::vector<std::uint8_t> cells{0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 1, 0};
+        std::mdspan<const std::uint8_t, std::dextents<int, 2>> map(cells.data(), 3, 4);
+        gt::OccupancyView<gt::U8Occupancy> view(map);
+        gt::Context ctx;
+        gt::Path from_mdspan, from_span;
+        gt::greedy(view, 20, ctx, from_mdspan);
+        gt::greedy(gt::u8_view(cells, 3, 4), 20, ctx, from_span);
+        bool same = same_path(from_mdspan, from_span);
+        std::printf("Test 3 (3x4 mdspan view): path %s the span view's\n", same ? "matches" : "DIFFERS FROM");
+        failures += !same;
+    }
+#endif
+
+    return failures == 0 ? 0 : 1;
+}